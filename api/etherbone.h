@@ -274,6 +274,82 @@ struct eb_handler {
   eb_status_t (*write)(eb_user_data_t, eb_address_t, eb_width_t, eb_data_t);
 };
 
+/* Operation flags of a submitted cycle */
+#define EB_SUBMIT_READ   0x00
+#define EB_SUBMIT_WRITE  0x01
+#define EB_SUBMIT_CONFIG 0x02
+
+/* One operation of a submitted cycle */
+struct eb_submit_op {
+  eb_address_t address;
+  eb_data_t    data;   /* value to write; a read result lands here */
+  eb_format_t  format;
+  uint8_t      flags;  /* EB_SUBMIT_{READ,WRITE} | EB_SUBMIT_CONFIG */
+};
+
+/* A cycle described in memory owned by the caller (see eb_queue_submit) */
+struct eb_submission {
+  eb_device_t          device;
+  eb_user_data_t       user_data;
+  eb_callback_t        callback; /* 0 to ignore the outcome; eb_block is not possible */
+  int                  silent;   /* 1 = as eb_cycle_close_silently */
+  int                  count;
+  struct eb_submit_op* ops;
+  
+  struct eb_submission* next; /* used by the library */
+};
+
+/* Submission queue of a socket */
+typedef struct eb_queue* eb_queue_t;
+
+/* Cycles to wait for together; pass with eb_group_done (see eb_group_wait) */
+struct eb_group {
+  eb_status_t status;  /* EB_OK, or the status of the first cycle which failed */
+  int         failed;  /* number of cycles which did not complete with EB_OK */
+  int         pending; /* cycles opened, but not yet complete */
+  void*       cond;    /* used by the library */
+};
+
+/* The outcome of a cycle whose callback was eb_complete.
+ * Times are nanoseconds since the epoch, 0 if unknown. received is the
+ * kernel receive time of the reply (udp and tcp), so received-sent is
+ * the round-trip time without the latency of the event loop.
+ */
+struct eb_completion {
+  eb_user_data_t user_data;
+  eb_device_t    device;
+  eb_operation_t operation; /* as a callback would have received it */
+  eb_status_t    status;
+  uint64_t       sent;      /* the request was flushed to the transport */
+  uint64_t       received;  /* the reply arrived at the host */
+  uint64_t       completed; /* the library finished the cycle */
+};
+
+/* Traffic counters of a socket or device; all count up from when it opened.
+ * The socket counts everything; a device counts what it sends, its
+ * cycles, and what arrives on its own link (streams like tcp). Replies
+ * over datagram links (udp) arrive on the socket, so only it counts them.
+ */
+struct eb_stats {
+  uint64_t packets_sent,    packets_received;    /* datagrams, or stream writes/reads */
+  uint64_t bytes_sent,      bytes_received;
+  uint64_t records_sent,    records_received;
+  uint64_t operations_sent, operations_received; /* reads and writes in those records */
+  uint64_t timeouts;        /* cycles which failed with EB_TIMEOUT */
+  uint64_t retransmits;     /* cycles sent again (eb_device_retransmit) */
+  uint64_t malformed;       /* packets dropped, or links closed, as invalid */
+  uint64_t handler_misses;  /* operations received which no handler accepted */
+};
+
+/* Latencies of a device in microseconds; see eb_device_histograms */
+#define EB_LATENCY_CYCLE 0 /* eb_cycle_close until the callback */
+#define EB_LATENCY_RTT   1 /* a cycle sent until its reply arrived */
+struct eb_latency {
+  uint64_t count; /* samples since enabled or reset */
+  uint32_t min, max, mean;
+  uint32_t p50, p90, p99, p999; /* within 3% */
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -382,6 +458,116 @@ void eb_socket_descriptors(eb_socket_t socket, eb_user_data_t user, eb_descripto
 EB_PUBLIC
 uint32_t eb_socket_timeout(eb_socket_t socket);
 
+/* Returns -1 if there are no timeouts pending, otherwise the microseconds
+ * until eb_socket_check should next be called. Event loops with sub-second
+ * timers should use this instead of eb_socket_timeout, which rounds up.
+ */
+EB_PUBLIC
+long eb_socket_timeout_us(eb_socket_t socket);
+
+/* Copy the counters of the socket into *stats.
+ * The counters are always kept; they cost a few additions per packet.
+ */
+EB_PUBLIC
+void eb_socket_stats(eb_socket_t socket, struct eb_stats* stats);
+
+/* Record every Etherbone packet the socket sends or receives, with its
+ * time, into a pcap file named filename; eb-replay can replay it.
+ * A new capture replaces the previous one, and filename=0 just stops.
+ *
+ * Returns:
+ *   OK    - the capture was started or stopped
+ *   FAIL  - the file could not be created, or the previous one not written
+ */
+EB_PUBLIC
+eb_status_t eb_socket_capture(eb_socket_t socket, const char* filename);
+
+/* Report the cells of the allocator shared by all sockets: those in use,
+ * the most ever in use, and the cells available before it must grow.
+ * Every object (cycle, operation, device, ...) takes one cell.
+ * With EB_USE_MALLOC there is no array, so size is 0.
+ */
+EB_PUBLIC
+void eb_memory_stats(uint32_t* used, uint32_t* peak, uint32_t* size);
+
+/* Record a marker carrying value in the trace ring of the process, to
+ * line up application events (a missed deadline, ...) with the traffic.
+ * Does nothing unless the library was built with EB_TRACE; see eb-trace.
+ */
+EB_PUBLIC
+void eb_trace_mark(uint32_t value);
+
+/* Access the submission queue of the socket, creating it on first use.
+ * Like every other call, this must come from the thread running the socket.
+ * The queue lives until the socket is closed; its descriptor is included
+ * in eb_socket_descriptors, so eb_socket_run wakes up for new submissions.
+ *
+ * Return codes:
+ *   OK         - the queue is ready
+ *   FAIL       - the operating system has no pipes for waking the socket
+ *   OOM        - out of memory
+ */
+EB_PUBLIC
+eb_status_t eb_socket_queue(eb_socket_t socket, eb_queue_t* result);
+
+/* Hand a cycle to the thread running the socket.
+ * This is the ONLY call which any thread may make at any time. It is
+ * lock-free and touches nothing but the queue and the submission itself
+ * (and, with eb_group_done, the pending count of the group).
+ * The socket's thread turns submissions into cycles, in order, during its
+ * next eb_socket_{run,check}. The callback then runs as for eb_cycle_open;
+ * it receives the operations and read results are also stored in ops[].data.
+ *
+ * The submission and its ops must remain valid until the callback runs.
+ * Submissions still queued when the socket closes receive EB_FAIL.
+ */
+EB_PUBLIC
+void eb_queue_submit(eb_queue_t queue, struct eb_submission* submission);
+
+/* Pass eb_complete as a cycle callback to record the outcome instead.
+ * eb_socket_{run,check} then only append to the completion ring of the
+ * socket; nothing of yours runs while the socket parses. Drain the ring
+ * with eb_socket_poll_completions whenever convenient.
+ */
+EB_PUBLIC
+void eb_complete(eb_user_data_t user, eb_device_t device, eb_operation_t operation, eb_status_t status);
+
+/* Move up to max completions, oldest first, into out[].
+ * The operations of the returned cycles stay readable until the next
+ * call, when the library reclaims them. The ring grows as needed.
+ *
+ * Returns the number of completions stored in out[].
+ */
+EB_PUBLIC
+int eb_socket_poll_completions(eb_socket_t socket, struct eb_completion* out, int max);
+
+/* Start a thread which runs the socket from now on.
+ * The thread plays the role of eb_socket_run; do not call eb_socket_check.
+ * If cpu >= 0, the thread is pinned to that processor (Linux only).
+ *
+ * Afterwards, any thread may use the library while holding eb_socket_lock.
+ * Callbacks are run by the socket thread, which holds the lock for them.
+ * A thread waiting on eb_block (or eb_socket_run) releases the lock until
+ * its own cycle completes, so threads do not hold each other up.
+ * eb_queue_submit remains lock-free. eb_socket_close stops the thread.
+ *
+ * Return codes:
+ *   OK         - the thread is running (or already was)
+ *   FAIL       - the operating system could not start the thread
+ *   OOM        - out of memory
+ */
+EB_PUBLIC
+eb_status_t eb_socket_thread(eb_socket_t socket, int cpu);
+
+/* Serialize access to the library between threads (see eb_socket_thread).
+ * There is one lock for the whole library; it is not recursive.
+ * Unlocking wakes the socket thread to send any newly closed cycles.
+ */
+EB_PUBLIC
+void eb_socket_lock(eb_socket_t socket);
+EB_PUBLIC
+void eb_socket_unlock(eb_socket_t socket);
+
 /* Add a device to the virtual bus.
  * This handler receives all reads and writes to the specified address.
  * The handler structure passed to eb_socket_attach need not be preserved.
@@ -425,6 +611,27 @@ eb_status_t eb_device_open(eb_socket_t  socket,
                            int          attempts,
                            eb_device_t* result);
 
+/* Open many devices at once, for example a whole fleet of boards.
+ * All addresses are resolved in parallel and all probes sent together,
+ * so the wait is bounded by the slowest device, not the sum of them.
+ * The callback runs once per address as soon as its outcome is known.
+ * It receives the index into addresses[], the device (EB_NULL unless
+ * status is OK), and the status eb_device_open would have returned.
+ *
+ * Return codes:
+ *   OK         - every address was reported to the callback
+ *   OOM        - out of memory; nothing was reported
+ */
+typedef void (*eb_device_open_callback_t)(eb_user_data_t user, int index, eb_device_t device, eb_status_t status);
+EB_PUBLIC
+eb_status_t eb_device_open_all(eb_socket_t               socket,
+                               int                       count,
+                               const char* const*        addresses,
+                               eb_width_t                proposed_widths,
+                               int                       attempts,
+                               eb_user_data_t            user_data,
+                               eb_device_open_callback_t callback);
+
 /* The same method using a non-blocking interface.
  * The callback receives the device and final status.
  */
@@ -486,6 +693,88 @@ eb_status_t eb_device_close(eb_device_t device);
 EB_PUBLIC
 eb_socket_t eb_device_socket(eb_device_t device);
 
+/* Retransmit idempotent cycles which the device has not answered.
+ * On datagram links (udp), a lost packet then costs one retransmission
+ * timeout instead of the whole cycle timeout. The retransmission timeout
+ * adapts to the round-trip times measured on the device. Each cycle is
+ * sent at most 1+retries times (retries <= 7; 0 disables, the default)
+ * and still fails with EB_TIMEOUT when its eb_cycle_timeout runs out.
+ *
+ * Cycles which only read are idempotent; see also eb_cycle_idempotent.
+ * Replies to superseded transmissions of a cycle are discarded.
+ *
+ * Return codes:
+ *   OK		- retransmission configured
+ *   OOM        - out of memory
+ */
+EB_PUBLIC
+eb_status_t eb_device_retransmit(eb_device_t device, int retries);
+
+/* Pace the packets sent to the device on datagram links (udp).
+ * A burst of cycles can otherwise overrun the receive buffer of a slave.
+ * Two token buckets limit the bytes and the packets sent per second;
+ * each holds at most its burst size, and starts out full. A rate of 0
+ * leaves that bucket unlimited; both 0 (the default) disables pacing.
+ *
+ * Cycles which must wait stay queued, in order, and the socket timeout
+ * (eb_socket_timeout) wakes the event loop when they may be sent.
+ * As with any queued cycle, its timeout only starts once it is sent.
+ *
+ * Return codes:
+ *   OK		- pacing configured
+ *   OOM        - out of memory
+ */
+EB_PUBLIC
+eb_status_t eb_device_pace(eb_device_t device, uint32_t bytes_per_second, uint32_t burst_bytes, uint32_t packets_per_second, uint32_t burst_packets);
+
+/* Limit the cycles awaiting a reply from the device on datagram links.
+ * The limit adapts to the link like TCP's congestion window: it grows
+ * while replies arrive, and halves when a cycle times out or must be
+ * retransmitted (see eb_device_retransmit). The same program then runs
+ * well over a local link and over a congested tunnel, without tuning.
+ * max_cycles bounds the window; 0 (the default) disables it.
+ *
+ * Return codes:
+ *   OK		- window configured
+ *   OOM        - out of memory
+ */
+EB_PUBLIC
+eb_status_t eb_device_window(eb_device_t device, int max_cycles);
+
+/* Copy the counters of the device into *stats; see struct eb_stats.
+ * Devices accepted by eb_socket_passive only count on the socket.
+ */
+EB_PUBLIC
+void eb_device_stats(eb_device_t device, struct eb_stats* stats);
+
+/* Keep histograms of the latencies of the device (or stop, if 0).
+ * EB_LATENCY_CYCLE covers each cycle from eb_cycle_close until its
+ * callback runs: queueing, pacing, the network, the slave and any
+ * retransmissions. Timeouts count with the time they took.
+ * EB_LATENCY_RTT covers each cycle's packet from sending until the
+ * reply, so it leaves out the time spent queued in this process.
+ * Recording costs a clock read per cycle; the histograms take 7kB.
+ *
+ * Return codes:
+ *   OK		- histograms enabled (empty if they were not before) or disabled
+ *   OOM        - out of memory
+ */
+EB_PUBLIC
+eb_status_t eb_device_histograms(eb_device_t device, int enable);
+
+/* Summarize a histogram (EB_LATENCY_{CYCLE,RTT}) of the device.
+ *
+ * Return codes:
+ *   OK		- *latency filled in
+ *   FAIL       - histograms are not enabled
+ */
+EB_PUBLIC
+eb_status_t eb_device_latency(eb_device_t device, int which, struct eb_latency* latency);
+
+/* Empty the histograms of the device, eg: after reading them */
+EB_PUBLIC
+void eb_device_latency_reset(eb_device_t device);
+
 /* Begin a wishbone cycle on the remote device.
  * Read/write operations within a cycle hold the device locked.
  * Read/write operations are executed in the order they are queued.
@@ -549,6 +838,49 @@ void eb_cycle_abort(eb_cycle_t cycle);
 EB_PUBLIC
 eb_device_t eb_cycle_device(eb_cycle_t cycle);
 
+/* Give up on the cycle if the device has not answered within timeout_us.
+ * The time is measured on a monotonic clock from when the cycle is sent,
+ * to a resolution of a few microseconds. Set it before closing the cycle.
+ * 0 selects the default of 5 seconds; the limit is about 17 minutes.
+ */
+EB_PUBLIC
+void eb_cycle_timeout(eb_cycle_t cycle, uint32_t timeout_us);
+
+/* Choose the send queue of the cycle; set it before closing the cycle.
+ * Whenever the device is flushed, all queued realtime cycles are packed
+ * into the packets before any bulk cycle. Within a class, cycles keep the
+ * order in which they were closed. Cycles already sent are not overtaken.
+ */
+#define EB_PRIORITY_BULK     0 /* the default */
+#define EB_PRIORITY_REALTIME 1
+EB_PUBLIC
+void eb_cycle_priority(eb_cycle_t cycle, int priority);
+
+/* Declare that executing the cycle twice is harmless, so it may be
+ * retransmitted even though it writes (see eb_device_retransmit).
+ */
+EB_PUBLIC
+void eb_cycle_idempotent(eb_cycle_t cycle);
+
+/* Empty the group; do this before first use and before reuse. */
+EB_PUBLIC
+void eb_group_init(struct eb_group* group);
+
+/* Pass the group as user_data and eb_group_done as the callback to any
+ * call which opens cycles (eb_cycle_open, eb_device_{read,write}, ...).
+ * Such cycles close without blocking and join the group. Submissions
+ * (eb_queue_submit) join it when submitted, before the cycle starts.
+ */
+EB_PUBLIC
+void eb_group_done(eb_user_data_t group, eb_device_t device, eb_operation_t operation, eb_status_t status);
+
+/* Block until every cycle in the group has completed.
+ * All the cycles share the round trips, unlike one eb_block per cycle.
+ * Returns EB_OK if all succeeded, else the status of the first failure.
+ */
+EB_PUBLIC
+eb_status_t eb_group_wait(eb_socket_t socket, struct eb_group* group);
+
 /* Prepare a wishbone read operation.
  * The given address is read from the remote device.
  * The result is written to the data address.
@@ -682,6 +1014,17 @@ EB_PUBLIC eb_status_t eb_sdb_find_by_identity_at(eb_device_t device, const struc
 #include <vector>
 #include <ostream>
 
+#if __cplusplus >= 201103L
+#include <future>
+#define EB_HAVE_FUTURE 1
+#endif
+
+#if __cplusplus >= 202002L && defined(__cpp_impl_coroutine)
+#include <coroutine>
+#include <exception>
+#define EB_HAVE_COROUTINE 1
+#endif
+
 /****************************************************************************/
 /*                                 C++ API                                  */
 /****************************************************************************/
@@ -695,6 +1038,8 @@ typedef eb_format_t format_t;
 typedef eb_status_t status_t;
 typedef eb_width_t width_t;
 typedef eb_descriptor_t descriptor_t;
+typedef struct eb_stats stats_t;
+typedef struct eb_latency latency_t;
 
 class Socket;
 class Device;
@@ -740,11 +1085,21 @@ class Socket {
     
     int run(int timeout_us = -1);
     
+    /* run the socket from its own thread; then lock around other calls */
+    EB_STATUS_OR_VOID_T thread(int cpu = -1);
+    void lock();
+    void unlock();
+    
     /* These can be used to implement your own 'block': */
     uint32_t timeout() const;
+    long timeout_us() const;
     void descriptors(eb_user_data_t user, eb_descriptor_callback_t list) const;
     int check(uint32_t now, eb_user_data_t user, eb_descriptor_callback_t ready);
     
+    /* traffic counters; see eb_socket_stats */
+    stats_t stats() const;
+    status_t capture(const char* filename);
+    
   protected:
     Socket(eb_socket_t sock);
     eb_socket_t socket;
@@ -769,6 +1124,19 @@ class Device {
     
     width_t width() const;
     
+    /* resend unanswered idempotent cycles; see eb_device_retransmit */
+    EB_STATUS_OR_VOID_T retransmit(int retries);
+    /* limit the packet rate; see eb_device_pace */
+    EB_STATUS_OR_VOID_T pace(uint32_t bytes_per_second, uint32_t burst_bytes, uint32_t packets_per_second = 0, uint32_t burst_packets = 1);
+    /* adapt the cycles in flight; see eb_device_window */
+    EB_STATUS_OR_VOID_T window(int max_cycles);
+    /* traffic counters; see eb_device_stats */
+    stats_t stats() const;
+    /* latency percentiles; see eb_device_histograms */
+    EB_STATUS_OR_VOID_T histograms(bool enable = true);
+    EB_STATUS_OR_VOID_T latency(int which, latency_t* latency) const;
+    void latency_reset();
+    
     EB_STATUS_OR_VOID_T enable_msi(eb_address_t* msi_first, eb_address_t* msi_last);
     
     template <typename T>
@@ -792,11 +1160,20 @@ class Device {
     EB_STATUS_OR_VOID_T write(eb_address_t address, eb_format_t format, eb_data_t data, T* user, eb_callback_t cb);
     EB_STATUS_OR_VOID_T write(eb_address_t address, eb_format_t format, eb_data_t data);
     
+#if EB_HAVE_FUTURE
+    /* The future becomes ready from eb_socket_run (or the socket thread) */
+    std::future<status_t> read_async (eb_address_t address, eb_format_t format, eb_data_t* data);
+    std::future<status_t> write_async(eb_address_t address, eb_format_t format, eb_data_t data);
+#endif
+    
   protected:
     Device(eb_device_t device);
     eb_device_t device;
   
   friend class Cycle;
+#if EB_HAVE_FUTURE
+  friend class AsyncCycle;
+#endif
   template <typename T, void (T::*cb)(Device, Operation, status_t)>
   friend void wrap_member_callback(eb_user_data_t object, eb_device_t dev, eb_operation_t op, eb_status_t status);
   template <typename T, void (*cb)(T*, Device, Operation, status_t)>
@@ -826,6 +1203,13 @@ class Cycle {
     void read_config (address_t address, format_t format = EB_DATAX, data_t* data = 0);
     void write_config(address_t address, format_t format, data_t  data);
     
+    /* give up after this many microseconds; 0 = default */
+    void timeout(uint32_t timeout_us);
+    /* EB_PRIORITY_REALTIME cycles overtake queued bulk cycles */
+    void priority(int priority);
+    /* may be retransmitted despite writes (see Device::retransmit) */
+    void idempotent();
+    
     const Device device() const;
     Device device();
     
@@ -834,6 +1218,75 @@ class Cycle {
     eb_cycle_t cycle;
 };
 
+#if EB_HAVE_FUTURE
+/* A cycle which reports its own outcome; no callback or user data needed.
+ * Once open, the object itself is the callback's user data. So it may only
+ * be moved while idle, and must outlive the cycle (see done()).
+ * With C++20, 'status_t s = co_await cycle;' suspends until it completes.
+ */
+class AsyncCycle {
+  public:
+    AsyncCycle();
+    ~AsyncCycle(); /* aborts the cycle if not yet closed */
+    
+    AsyncCycle(AsyncCycle&& x);
+    AsyncCycle& operator = (AsyncCycle&& x);
+    AsyncCycle(const AsyncCycle&) = delete;
+    AsyncCycle& operator = (const AsyncCycle&) = delete;
+    
+    EB_STATUS_OR_VOID_T open(Device device);
+    void abort();
+    /* Never blocks; the outcome arrives via eb_socket_run */
+    EB_STATUS_OR_VOID_T close();
+    EB_STATUS_OR_VOID_T close_silently();
+    
+    void read (address_t address, format_t format = EB_DATAX, data_t* data = 0);
+    void write(address_t address, format_t format, data_t  data);
+    
+    void read_config (address_t address, format_t format = EB_DATAX, data_t* data = 0);
+    void write_config(address_t address, format_t format, data_t  data);
+    
+    /* give up after this many microseconds; 0 = default */
+    void timeout(uint32_t timeout_us);
+    /* EB_PRIORITY_REALTIME cycles overtake queued bulk cycles */
+    void priority(int priority);
+    /* may be retransmitted despite writes (see Device::retransmit) */
+    void idempotent();
+    
+    bool done() const;       /* closed cycle has completed */
+    status_t status() const; /* its outcome, once done */
+    
+#if EB_HAVE_COROUTINE
+    bool await_ready() const noexcept;
+    void await_suspend(std::coroutine_handle<> waiter) noexcept;
+    status_t await_resume() const noexcept;
+#endif
+    
+  protected:
+    static void callback(eb_user_data_t user, eb_device_t dev, eb_operation_t op, eb_status_t status);
+    
+    eb_cycle_t cycle;
+    status_t result;
+    bool closed, finished;
+    void* waiter; /* coroutine to resume, if any */
+};
+#endif
+
+#if EB_HAVE_COROUTINE
+/* Return type of a coroutine which awaits cycles. It starts immediately,
+ * runs up to its first co_await, then continues from eb_socket_run.
+ */
+struct Task {
+  struct promise_type {
+    Task get_return_object() noexcept { return Task(); }
+    std::suspend_never initial_suspend() const noexcept { return std::suspend_never(); }
+    std::suspend_never final_suspend() const noexcept { return std::suspend_never(); }
+    void return_void() noexcept { }
+    void unhandled_exception() noexcept { std::terminate(); }
+  };
+};
+#endif
+
 class Operation {
   public:
     bool is_null  () const;
@@ -934,10 +1387,26 @@ inline int Socket::run(int timeout_us) {
   return eb_socket_run(socket, timeout_us);
 }
 
+inline EB_STATUS_OR_VOID_T Socket::thread(int cpu) {
+  EB_RETURN_OR_THROW("Socket::thread", eb_socket_thread(socket, cpu));
+}
+
+inline void Socket::lock() {
+  eb_socket_lock(socket);
+}
+
+inline void Socket::unlock() {
+  eb_socket_unlock(socket);
+}
+
 inline uint32_t Socket::timeout() const {
   return eb_socket_timeout(socket);
 }
 
+inline long Socket::timeout_us() const {
+  return eb_socket_timeout_us(socket);
+}
+
 inline void Socket::descriptors(eb_user_data_t user, eb_descriptor_callback_t list) const {
   return eb_socket_descriptors(socket, user, list);
 }
@@ -946,6 +1415,16 @@ inline int Socket::check(uint32_t now, eb_user_data_t user, eb_descriptor_callba
   return eb_socket_check(socket, now, user, ready);
 }
 
+inline stats_t Socket::stats() const {
+  stats_t out;
+  eb_socket_stats(socket, &out);
+  return out;
+}
+
+inline status_t Socket::capture(const char* filename) {
+  return eb_socket_capture(socket, filename);
+}
+
 inline Device::Device(eb_device_t dev)
  : device(dev) {
 }
@@ -976,6 +1455,36 @@ inline width_t Device::width() const {
   return eb_device_width(device);
 }
 
+inline EB_STATUS_OR_VOID_T Device::retransmit(int retries) {
+  EB_RETURN_OR_THROW("Device::retransmit", eb_device_retransmit(device, retries));
+}
+
+inline EB_STATUS_OR_VOID_T Device::pace(uint32_t bytes_per_second, uint32_t burst_bytes, uint32_t packets_per_second, uint32_t burst_packets) {
+  EB_RETURN_OR_THROW("Device::pace", eb_device_pace(device, bytes_per_second, burst_bytes, packets_per_second, burst_packets));
+}
+
+inline EB_STATUS_OR_VOID_T Device::window(int max_cycles) {
+  EB_RETURN_OR_THROW("Device::window", eb_device_window(device, max_cycles));
+}
+
+inline stats_t Device::stats() const {
+  stats_t out;
+  eb_device_stats(device, &out);
+  return out;
+}
+
+inline EB_STATUS_OR_VOID_T Device::histograms(bool enable) {
+  EB_RETURN_OR_THROW("Device::histograms", eb_device_histograms(device, enable));
+}
+
+inline EB_STATUS_OR_VOID_T Device::latency(int which, latency_t* latency) const {
+  EB_RETURN_OR_THROW("Device::latency", eb_device_latency(device, which, latency));
+}
+
+inline void Device::latency_reset() {
+  eb_device_latency_reset(device);
+}
+
 inline EB_STATUS_OR_VOID_T Device::enable_msi(eb_address_t* msi_first, eb_address_t* msi_last) {
   EB_RETURN_OR_THROW("Device::enable_msi", eb_device_enable_msi(device, msi_first, msi_last));
 }
@@ -1076,6 +1585,30 @@ inline EB_STATUS_OR_VOID_T Device::write(eb_address_t address, eb_format_t forma
   EB_RETURN_OR_THROW("Device::write", eb_device_write(device, address, format, data, 0, eb_block));
 }
 
+#if EB_HAVE_FUTURE
+inline void wrap_promise_callback(eb_user_data_t user, eb_device_t dev, eb_operation_t op, eb_status_t status) {
+  std::promise<status_t>* promise = reinterpret_cast<std::promise<status_t>*>(user);
+  promise->set_value(status);
+  delete promise;
+}
+
+inline std::future<status_t> Device::read_async(eb_address_t address, eb_format_t format, eb_data_t* data) {
+  std::promise<status_t>* promise = new std::promise<status_t>;
+  std::future<status_t> result = promise->get_future();
+  status_t status = eb_device_read(device, address, format, data, promise, &wrap_promise_callback);
+  if (status != EB_OK) wrap_promise_callback(promise, device, EB_NULL, status);
+  return result;
+}
+
+inline std::future<status_t> Device::write_async(eb_address_t address, eb_format_t format, eb_data_t data) {
+  std::promise<status_t>* promise = new std::promise<status_t>;
+  std::future<status_t> result = promise->get_future();
+  status_t status = eb_device_write(device, address, format, data, promise, &wrap_promise_callback);
+  if (status != EB_OK) wrap_promise_callback(promise, device, EB_NULL, status);
+  return result;
+}
+#endif
+
 inline Cycle::Cycle()
  : cycle(EB_NULL) {
 }
@@ -1124,6 +1657,18 @@ inline void Cycle::write_config(address_t address, format_t format, data_t data)
   eb_cycle_write_config(cycle, address, format, data);
 }
 
+inline void Cycle::timeout(uint32_t timeout_us) {
+  eb_cycle_timeout(cycle, timeout_us);
+}
+
+inline void Cycle::priority(int priority) {
+  eb_cycle_priority(cycle, priority);
+}
+
+inline void Cycle::idempotent() {
+  eb_cycle_idempotent(cycle);
+}
+
 inline const Device Cycle::device() const {
   return Device(eb_cycle_device(cycle));
 }
@@ -1132,6 +1677,118 @@ inline Device Cycle::device() {
   return Device(eb_cycle_device(cycle));
 }
 
+#if EB_HAVE_FUTURE
+inline AsyncCycle::AsyncCycle()
+ : cycle(EB_NULL), result(EB_OK), closed(false), finished(false), waiter(0) {
+}
+
+inline AsyncCycle::~AsyncCycle() {
+  if (cycle != EB_NULL && !closed) eb_cycle_abort(cycle);
+}
+
+/* Only idle cycles (never opened, or done) may move */
+inline AsyncCycle::AsyncCycle(AsyncCycle&& x)
+ : cycle(EB_NULL), result(x.result), closed(x.closed), finished(x.finished), waiter(0) {
+}
+
+inline AsyncCycle& AsyncCycle::operator = (AsyncCycle&& x) {
+  result = x.result;
+  closed = x.closed;
+  finished = x.finished;
+  return *this;
+}
+
+inline EB_STATUS_OR_VOID_T AsyncCycle::open(Device device) {
+  result = EB_OK;
+  closed = finished = false;
+  waiter = 0;
+  EB_RETURN_OR_THROW("AsyncCycle::open", eb_cycle_open(device.device, this, &AsyncCycle::callback, &cycle));
+}
+
+inline void AsyncCycle::abort() {
+  eb_cycle_abort(cycle);
+  cycle = EB_NULL;
+}
+
+inline EB_STATUS_OR_VOID_T AsyncCycle::close() {
+  closed = true;
+  EB_RETURN_OR_THROW("AsyncCycle::close", eb_cycle_close(cycle));
+}
+
+inline EB_STATUS_OR_VOID_T AsyncCycle::close_silently() {
+  closed = true;
+  EB_RETURN_OR_THROW("AsyncCycle::close_silently", eb_cycle_close_silently(cycle));
+}
+
+inline void AsyncCycle::read(address_t address, format_t format, data_t* data) {
+  eb_cycle_read(cycle, address, format, data);
+}
+
+inline void AsyncCycle::write(address_t address, format_t format, data_t data) {
+  eb_cycle_write(cycle, address, format, data);
+}
+
+inline void AsyncCycle::read_config(address_t address, format_t format, data_t* data) {
+  eb_cycle_read_config(cycle, address, format, data);
+}
+
+inline void AsyncCycle::write_config(address_t address, format_t format, data_t data) {
+  eb_cycle_write_config(cycle, address, format, data);
+}
+
+inline void AsyncCycle::timeout(uint32_t timeout_us) {
+  eb_cycle_timeout(cycle, timeout_us);
+}
+
+inline void AsyncCycle::priority(int priority) {
+  eb_cycle_priority(cycle, priority);
+}
+
+inline void AsyncCycle::idempotent() {
+  eb_cycle_idempotent(cycle);
+}
+
+inline bool AsyncCycle::done() const {
+  return finished;
+}
+
+inline status_t AsyncCycle::status() const {
+  return result;
+}
+
+inline void AsyncCycle::callback(eb_user_data_t user, eb_device_t dev, eb_operation_t op, eb_status_t status) {
+  AsyncCycle* self = reinterpret_cast<AsyncCycle*>(user);
+  void* waiter;
+  
+  self->result = status;
+  self->finished = true;
+  self->cycle = EB_NULL;
+  
+  waiter = self->waiter;
+  self->waiter = 0;
+#if EB_HAVE_COROUTINE
+  /* The coroutine may destroy self; touch nothing afterwards */
+  if (waiter) std::coroutine_handle<>::from_address(waiter).resume();
+#else
+  (void)waiter;
+#endif
+}
+
+#if EB_HAVE_COROUTINE
+inline bool AsyncCycle::await_ready() const noexcept {
+  return finished;
+}
+
+inline void AsyncCycle::await_suspend(std::coroutine_handle<> handle) noexcept {
+  waiter = handle.address();
+}
+
+inline status_t AsyncCycle::await_resume() const noexcept {
+  return result;
+}
+#endif
+#endif
+
 inline Operation::Operation(eb_operation_t op)
  : operation(op) {
 }
@@ -1172,6 +1829,16 @@ inline const Operation Operation::next() const {
   return Operation(eb_operation_next(operation));
 }
 
+/* cells of the shared allocator; see eb_memory_stats */
+inline void memory_stats(uint32_t* used, uint32_t* peak, uint32_t* size) {
+  eb_memory_stats(used, peak, size);
+}
+
+/* marker in the trace ring; see eb_trace_mark */
+inline void trace_mark(uint32_t value) {
+  eb_trace_mark(value);
+}
+
 }
 
 #endif
@@ -36,7 +36,10 @@
 #include "../glue/cycle.h"
 #include "../glue/device.h"
 #include "../glue/socket.h"
+#include "../glue/timer.h"
 #include "../glue/widths.h"
+#include "../glue/trace.h"
+#include "../glue/capture.h"
 #include "../transport/transport.h"
 #include "../memory/memory.h"
 #include "format.h"
@@ -63,7 +66,10 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
   struct eb_cycle* cycle;
   struct eb_response* response;
   struct eb_transport_ops* tops;
-  eb_cycle_t cyclep, nextp, prevp;
+  struct eb_device_flow* flow;
+  struct eb_stats* stats;
+  struct eb_socket_state* state;
+  eb_cycle_t cyclep, nextp, firstp;
   eb_response_t responsep;
   eb_width_t biggest, data, addr, width;
   eb_format_t format, size, endian;
@@ -71,13 +77,21 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
   uint8_t buffer[sizeof(eb_max_align_t)*(255+255+1+1)+8]; /* big enough for worst-case record */
   uint8_t * wptr, * cptr, * eob;
   int alignment, record_alignment, header_alignment, stride, mtu, readback, has_reads;
+  uint32_t clock, timeout, rto;
+  uint32_t packets, records, operations, cycle_records, cycle_operations;
+  uint64_t bytes;
   
   device = EB_DEVICE(devicep);
   transport = EB_TRANSPORT(device->transport);
   width = device->widths;
+  flow = device->flow;
+  state = EB_SOCKET(device->socket)->state; /* never moves */
   
   if (device->link == EB_NULL) return EB_FAIL;
   
+  /* Deadlines count from now */
+  clock = eb_socket_clock();
+  
   /*
   assert (device->un_link.passive != devicep);
   assert (eb_width_refined(width) != 0);
@@ -119,26 +133,36 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
     eob = &buffer[sizeof(buffer)];
   }
   
-  /* Invert the list of cycles */
-  prevp = EB_NULL;
-  for (cyclep = device->un_link.ready; cyclep != EB_NULL; cyclep = nextp) {
-    cycle = EB_CYCLE(cyclep);
-    nextp = cycle->un_link.next;
-    cycle->un_link.next = prevp;
-    prevp = cyclep;
-  }
+  /* Take the queued cycles; realtime ones are packed first.
+   * Cycles closed by callbacks during the flush wait for the next one.
+   */
+  firstp = eb_device_dequeue(devicep);
+  
+  /* Counted as sent, then added to the socket and device once */
+  packets = records = operations = 0;
+  bytes = 0;
   
   has_reads = 0;
-  for (cyclep = prevp; cyclep != EB_NULL; cyclep = nextp) {
+  for (cyclep = firstp; cyclep != EB_NULL; cyclep = nextp) {
     struct eb_operation* operation;
     struct eb_operation* scan;
     eb_operation_t operationp;
     eb_operation_t scanp;
     eb_data_t data_mask;
-    int needs_check, cycle_end;
+    int needs_check, cycle_end, writes, attempt;
     unsigned int ops, maxops;
     eb_status_t reason;
     
+    /* Paced links leave the rest queued until the buckets refill,
+     * or until replies open the congestion window.
+     */
+    if (flow != 0 && mtu != 0 &&
+        (!eb_device_window_open(flow) ||
+         eb_device_pace_wait(flow, clock, cptr - &buffer[header_alignment]) != 0)) {
+      eb_device_requeue(devicep, cyclep);
+      break;
+    }
+    
     cycle = EB_CYCLE(cyclep);
     nextp = cycle->un_link.next;
     
@@ -147,22 +171,21 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
     
     /* Deal with OOM cases */
     if (cycle->un_ops.dead == cyclep) {
-      (*cycle->callback)(cycle->user_data, cycle->un_link.device, EB_NULL, EB_OOM);
+      eb_cycle_finish(cyclep, EB_NULL, EB_OOM);
       ++*completed;
-      eb_free_cycle(cyclep);
       continue;
     }
     
     /* Was the cycle a no-op? */
     if (cycle->un_ops.first == EB_NULL) {
-      (*cycle->callback)(cycle->user_data, cycle->un_link.device, EB_NULL, EB_OK);
+      eb_cycle_finish(cyclep, EB_NULL, EB_OK);
       ++*completed;
-      eb_free_cycle(cyclep);
       continue;
     }
     
     /* Are there out of range widths? */
     reason = EB_OK; /* silence warning */
+    writes = 0;
     for (operationp = cycle->un_ops.first; operationp != EB_NULL; operationp = operation->next) {
       operation = EB_OPERATION(operationp);
       
@@ -205,6 +228,7 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
       
       /* Is the data too big for the port? */
       if ((operation->flags & EB_OP_MASK) == EB_OP_WRITE) {
+        writes = 1;
         data_mask = ~(eb_data_t)0;
         data_mask >>= (sizeof(eb_data_t) - size) << 3;
         if ((operation->un_value.write_value & data_mask) != operation->un_value.write_value) {
@@ -216,10 +240,8 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
     
     if (operationp != EB_NULL) {
       /* Report the bad operation to the user */
-      (*cycle->callback)(cycle->user_data, cycle->un_link.device, operationp, reason);
+      eb_cycle_finish(cyclep, operationp, reason);
       ++*completed;
-      eb_cycle_destroy(cyclep);
-      eb_free_cycle(cyclep);
       continue;
     }
     
@@ -227,10 +249,8 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
     responsep = eb_new_response(); /* invalidates: cycle device transport */
     if (responsep == EB_NULL) {
       cycle = EB_CYCLE(cyclep);
-      (*cycle->callback)(cycle->user_data, cycle->un_link.device, EB_NULL, EB_OOM);
+      eb_cycle_finish(cyclep, EB_NULL, EB_OOM);
       ++*completed;
-      eb_cycle_destroy(cyclep);
-      eb_free_cycle(cyclep);
       continue;
     }
 
@@ -255,6 +275,7 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
     ops = 0;
     readback = 0;
     cycle_end = 0;
+    cycle_records = cycle_operations = 0;
     while (!cycle_end) {
       int wcount, rcount, rxcount, total, length, fifo;
       eb_address_t bwa;
@@ -393,6 +414,10 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
         if (mtu == 0) {
           /* Overflow in a streaming device => flush and continue */
           (*tops->send)(transport, link, &buffer[0], wptr - &buffer[0]);
+          eb_trace(EB_TRACE_SEND, EB_TRACE_HANDLE(devicep), EB_TRACE_NONE, wptr - &buffer[0]);
+          if (state->capture != 0) eb_capture_packet(state->capture, EB_CAPTURE_SENT, transport, devicep, &buffer[0], wptr - &buffer[0]);
+          ++packets;
+          bytes += wptr - &buffer[0];
           wptr = &buffer[0];
         } else {
           /* Overflow in a packet-based device, send any previous cycles and keep current */
@@ -407,6 +432,11 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
             
             send = cptr - &buffer[0];
             (*tops->send)(transport, link, &buffer[0], send);
+            eb_trace(EB_TRACE_SEND, EB_TRACE_HANDLE(devicep), EB_TRACE_NONE, send);
+            if (state->capture != 0) eb_capture_packet(state->capture, EB_CAPTURE_SENT, transport, devicep, &buffer[0], send);
+            if (flow != 0) eb_device_pace_charge(flow, send);
+            ++packets;
+            bytes += send;
             
             /* Shift any existing records over */
             keep = wptr - cptr;
@@ -418,10 +448,8 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
           /* Test for cycle overflow of MTU */
           if (length > eob - wptr) {
             /* Blow up in the face of the user */
-            (*cycle->callback)(cycle->user_data, cycle->un_link.device, operationp, EB_OVERFLOW);
+            eb_cycle_finish(cyclep, operationp, EB_OVERFLOW);
             ++*completed;
-            eb_cycle_destroy(cyclep);
-            eb_free_cycle(cyclep);
             eb_free_response(responsep);
             
             /* Start next cycle at the head of buffer */
@@ -459,6 +487,9 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
       wptr[3] = rxcount;
       wptr += record_alignment;
       
+      ++cycle_records;
+      cycle_operations += wcount + rxcount;
+      
       /* Fill in the writes */
       if (wcount > 0) {
         operation = EB_OPERATION(operationp);
@@ -509,18 +540,37 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
     
     /* Did we finish the while loop? */
     if (cycle_end) {
+      records += cycle_records;
+      operations += cycle_operations;
+      eb_trace(EB_TRACE_PACK, EB_TRACE_HANDLE(devicep), EB_TRACE_HANDLE(cyclep), cycle_records);
+      
       if (readback == 0) {
         /* No response will arrive, so call callback now */
         /* Invalidates pointers, but jumps to top of loop afterwards */
-        (*cycle->callback)(cycle->user_data, cycle->un_link.device, cycle->un_ops.first, EB_OK); 
+        if (flow != 0 && flow->latency != 0)
+          eb_device_measure(flow, cycle->un_ops.first, 0, 0);
+        state->sent = eb_socket_realtime();
+        state->received = 0;
+        eb_cycle_finish(cyclep, cycle->un_ops.first, EB_OK); 
+        state->sent = 0;
         ++*completed;
-        eb_cycle_destroy(cyclep);
-        eb_free_cycle(cyclep);
         eb_free_response(responsep);
       } else {
         /* Setup a response */
-        response->deadline = aux->time_cache + 5;
+        timeout = cycle->timeout;
+        if (timeout == 0) timeout = EB_TIMER_DEFAULT;
+        
+        response->sent = clock;
+        response->deadline = clock + timeout;
         response->cycle = cyclep;
+        
+        /* Wake up early to retransmit idempotent cycles on datagram links */
+        if (flow != 0 && flow->retries != 0 && mtu != 0 && (!writes || cycle->idempotent)) {
+          attempt = (EB_OPERATION(cycle->un_ops.first)->flags & EB_OP_RETRIES) / EB_OP_RETRY;
+          if (attempt < flow->retries && (rto = eb_device_rto(flow, attempt)) < timeout)
+            response->deadline = clock + rto;
+        }
+        
         response->write_cursor = eb_find_read(cycle->un_ops.first);
         response->status_cursor = needs_check ? eb_find_bus(cycle->un_ops.first) : EB_NULL;
         
@@ -531,6 +581,8 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
         /* Chain it for response processing in FIFO order */
         response->next = socket->last_response;
         socket->last_response = responsep;
+        eb_timer_arm(socket->state->timers, responsep);
+        if (flow != 0 && mtu != 0) eb_device_sent(flow);
       }
       
       /* Update end pointer */
@@ -546,19 +598,40 @@ eb_status_t eb_device_flush(eb_device_t devicep, int *completed) {
   if (mtu == 0) {
     if (wptr != &buffer[0]) {
       (*tops->send)(transport, link, &buffer[0], wptr - &buffer[0]);
+      eb_trace(EB_TRACE_SEND, EB_TRACE_HANDLE(devicep), EB_TRACE_NONE, wptr - &buffer[0]);
+      if (state->capture != 0) eb_capture_packet(state->capture, EB_CAPTURE_SENT, transport, devicep, &buffer[0], wptr - &buffer[0]);
+      ++packets;
+      bytes += wptr - &buffer[0];
     }
   } else {
     if (wptr != &buffer[header_alignment]) {
       if (has_reads == 0) buffer[2] |= EB_HEADER_NR;
       (*tops->send)(transport, link, &buffer[0], wptr - &buffer[0]);
+      eb_trace(EB_TRACE_SEND, EB_TRACE_HANDLE(devicep), EB_TRACE_NONE, wptr - &buffer[0]);
+      if (state->capture != 0) eb_capture_packet(state->capture, EB_CAPTURE_SENT, transport, devicep, &buffer[0], wptr - &buffer[0]);
+      if (flow != 0) eb_device_pace_charge(flow, wptr - &buffer[0]);
+      ++packets;
+      bytes += wptr - &buffer[0];
     }
   }
   
+  socket = EB_SOCKET(device->socket);
+  stats = &socket->state->stats;
+  stats->packets_sent += packets;
+  stats->bytes_sent += bytes;
+  stats->records_sent += records;
+  stats->operations_sent += operations;
+  
+  if (flow != 0) {
+    stats = &flow->stats;
+    stats->packets_sent += packets;
+    stats->bytes_sent += bytes;
+    stats->records_sent += records;
+    stats->operations_sent += operations;
+  }
+  
   /* Done sending */
   tops->send_buffer(transport, link, 0);
   
-  /* Clear the queue */
-  device->un_link.ready = EB_NULL;
-  
   return EB_OK;
 }
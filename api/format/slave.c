@@ -36,6 +36,8 @@
 #include "../glue/socket.h"
 #include "../glue/device.h"
 #include "../glue/widths.h"
+#include "../glue/trace.h"
+#include "../glue/capture.h"
 #include "../memory/memory.h"
 #include "bigendian.h"
 #include "format.h"
@@ -61,6 +63,13 @@ static void EB_sWRITE(uint8_t* wptr, eb_data_t val, int alignment) {
 static uint8_t eb_log2_table[8] = { 0, 1, 2, 4, 7, 3, 6, 5 };
 static uint8_t eb_log2(uint8_t x) { return eb_log2_table[(uint8_t)(x * 0x17) >> 5]; }
 
+/* Count on the socket and, if it keeps counters, the device */
+#define EB_COUNT(field, n)                              \
+  do {                                                  \
+    stats->field += (n);                                \
+    if (device_stats != 0) device_stats->field += (n);  \
+  } while (0)
+
 int eb_device_slave(eb_socket_t socketp, eb_transport_t transportp, eb_device_t devicep, eb_user_data_t user_data, eb_descriptor_callback_t ready, int* completed) {
   struct eb_socket* socket;
   struct eb_transport* transport;
@@ -75,9 +84,13 @@ int eb_device_slave(eb_socket_t socketp, eb_transport_t transportp, eb_device_t
   eb_address_t address_filter_bits;
   int alignment, record_alignment, header_alignment, stride, cycle_end, cycle_open;
   int reply, header, passive, active;
+  struct eb_stats* stats, * device_stats;
+  struct eb_socket_state* state;
   
   transport = EB_TRANSPORT(transportp);
   socket = EB_SOCKET(socketp);
+  stats = &socket->state->stats;
+  state = socket->state; /* never moves */
   
   if (devicep != EB_NULL) {
     device = EB_DEVICE(devicep);
@@ -96,8 +109,11 @@ int eb_device_slave(eb_socket_t socketp, eb_transport_t transportp, eb_device_t
     
     passive = device->un_link.passive == devicep;
     active = !passive;
+    
+    device_stats = device->flow ? &device->flow->stats : 0;
   } else {
     device = 0; /* silence warning */
+    device_stats = 0;
     
     linkp = EB_NULL;
     link = 0;
@@ -121,6 +137,13 @@ int eb_device_slave(eb_socket_t socketp, eb_transport_t transportp, eb_device_t
   reply = 0;
   len = eb_transports[transport->link_type].poll(transport, link, user_data, ready, buffer, sizeof(buffer));
   if (len == 0) return 0; /* no data ready */
+  if (len > 0) {
+    EB_COUNT(packets_received, 1);
+    EB_COUNT(bytes_received, len);
+    eb_trace(EB_TRACE_RECV, EB_TRACE_HANDLE(devicep), EB_TRACE_NONE, len);
+    if (state->capture != 0) eb_capture_packet(state->capture, EB_CAPTURE_RECEIVED, transport, devicep, buffer, len);
+    state->rx_stamp = eb_transports[transport->link_type].stamp(transport, link);
+  }
   if (len < 2) goto kill; /* EB is always 2 byte aligned */
   
   /* Expect and require an EB header */
@@ -144,6 +167,9 @@ int eb_device_slave(eb_socket_t socketp, eb_transport_t transportp, eb_device_t
       
       /* Bytes 4-7 are echoed back */
       eb_transports[transport->link_type].send(transport, link, buffer, 8);
+      if (state->capture != 0) eb_capture_packet(state->capture, EB_CAPTURE_SENT, transport, devicep, buffer, 8);
+      EB_COUNT(packets_sent, 1);
+      EB_COUNT(bytes_sent, 8);
       
       /* Kill the link if negotiation is impossible */
       if (!eb_width_possible(widths)) goto kill;
@@ -172,7 +198,8 @@ int eb_device_slave(eb_socket_t socketp, eb_transport_t transportp, eb_device_t
       
       dev->widths = buffer[3];
       
-      return 0; /* don't poll again */
+      /* Packet transports may have more datagrams queued, streams stop here */
+      return devicep == EB_NULL;
     } 
     
     /* Not V1 ? */
@@ -235,6 +262,9 @@ resume_cycle:
     
     rptr += record_alignment;
     
+    EB_COUNT(records_received, 1);
+    EB_COUNT(operations_received, wcount + rcount);
+    
     /* Decode the intended width from the select lines */
     
     /* Step 1. How many bytes shifted are the operations? 
@@ -292,6 +322,9 @@ resume_cycle:
       
       if (reply) {
         eb_transports[transport->link_type].send(transport, link, buffer, wptr - &buffer[0]);
+        if (state->capture != 0) eb_capture_packet(state->capture, EB_CAPTURE_SENT, transport, devicep, buffer, wptr - &buffer[0]);
+        EB_COUNT(packets_sent, 1);
+        EB_COUNT(bytes_sent, wptr - &buffer[0]);
       }
       
       keep = eos-rptr;
@@ -299,6 +332,11 @@ resume_cycle:
       
       len = eb_transports[transport->link_type].recv(transport, link, buffer+keep, sizeof(buffer)-keep);
       if (len <= 0) goto kill;
+      EB_COUNT(packets_received, 1);
+      EB_COUNT(bytes_received, len);
+      eb_trace(EB_TRACE_RECV, EB_TRACE_HANDLE(devicep), EB_TRACE_NONE, len);
+      if (state->capture != 0) eb_capture_packet(state->capture, EB_CAPTURE_RECEIVED, transport, devicep, buffer+keep, len);
+      state->rx_stamp = eb_transports[transport->link_type].stamp(transport, link);
       len += keep;
       
       wptr = &buffer[0];
@@ -337,8 +375,10 @@ resume_cycle:
         } else {
           if (sel_ok)
             eb_socket_write(socketp, op_width, bwa_b, bwa_l, wv, &error);
-          else
+          else {
             error = (error<<1) | 1;
+            ++stats->handler_misses;
+          }
         }
         
         if (wfifo == 0) {
@@ -367,6 +407,8 @@ resume_cycle:
       wptr[3] = 0;
       
       wptr += record_alignment;
+      EB_COUNT(records_sent, 1);
+      EB_COUNT(operations_sent, rcount);
       
       /* Do we have an open cycle written to the line? */
       cycle_open = cycle_end == 0;
@@ -399,6 +441,7 @@ resume_cycle:
           } else {
             wv = 0;
             error = (error<<1) | 1;
+            ++stats->handler_misses;
           }
         }
         
@@ -415,24 +458,40 @@ resume_cycle:
       memset(wptr, 0, record_alignment);
       wptr[0] = cycle_end;
       wptr += record_alignment;
+      EB_COUNT(records_sent, 1);
     }
   }
   
+  /* Callbacks may have moved the transport and link */
+  transport = EB_TRANSPORT(transportp);
+  if (linkp != EB_NULL) link = EB_LINK(linkp);
+  
   /* Reply if needed */
   if (reply) {
     eb_transports[transport->link_type].send(transport, link, buffer, wptr - &buffer[0]);
+    if (state->capture != 0) eb_capture_packet(state->capture, EB_CAPTURE_SENT, transport, devicep, buffer, wptr - &buffer[0]);
+    EB_COUNT(packets_sent, 1);
+    EB_COUNT(bytes_sent, wptr - &buffer[0]);
   }
   
-  /* Is the cycle line still high? */
-  if (cycle_end == 0) {
-    /* Only streaming sockets may keep cycle line high */
+  /* Is the cycle line still high? Or did the stream split a record header? */
+  if (cycle_end == 0 || rptr != eos) {
+    /* Only streaming sockets may keep cycle line high or split records */
     if (eb_transports[transport->link_type].mtu != 0) goto kill;
     
+    /* Replies up to here were sent above */
+    reply = 0;
+    
     keep = eos-rptr;
     if (rptr != &buffer[0]) memmove(&buffer[0], rptr, keep);
     
     len = eb_transports[transport->link_type].recv(transport, link, buffer+keep, sizeof(buffer)-keep);
     if (len <= 0) goto kill;
+    EB_COUNT(packets_received, 1);
+    EB_COUNT(bytes_received, len);
+    eb_trace(EB_TRACE_RECV, EB_TRACE_HANDLE(devicep), EB_TRACE_NONE, len);
+    if (state->capture != 0) eb_capture_packet(state->capture, EB_CAPTURE_RECEIVED, transport, devicep, buffer+keep, len);
+    state->rx_stamp = eb_transports[transport->link_type].stamp(transport, link);
     len += keep;
     
     wptr = rptr = &buffer[0];
@@ -440,14 +499,16 @@ resume_cycle:
     goto resume_cycle;
   }
   
-  /* Improperly terminated message? */
-  if (rptr != eos) goto kill;
-  
   return 1;
   
 kill:
+  /* A closed link reads <= 0; anything else was invalid */
+  if (len > 0) EB_COUNT(malformed, 1);
+  
+  /* Drop a bad datagram, but keep draining any queued behind it */
+  if (devicep == EB_NULL) return len > 0;
+  
   /* Destroy the connection */
-  if (devicep == EB_NULL) return 0;
   
   if (passive) {
     eb_device_close(devicep);
@@ -0,0 +1,88 @@
+/** @file capture.c
+ *  @brief Recording the packets of a socket into a pcap file.
+ *
+ *  Copyright (C) 2026 GSI Helmholtz Centre for Heavy Ion Research GmbH
+ *
+ *  The packets are appended through stdio, so recording costs a copy into
+ *  the stdio buffer; the file is written out when that fills up.
+ *
+ *  @author Etherbone Core Developers <etherbone-core@ohwr.org>
+ *
+ *  @bug None!
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define ETHERBONE_IMPL
+
+#include "capture.h"
+
+#include <time.h>
+#include <sys/time.h>
+
+int eb_capture_open(FILE* file) {
+  struct eb_capture_file header;
+  
+  header.magic = EB_CAPTURE_MAGIC;
+  header.version_major = 2;
+  header.version_minor = 4;
+  header.thiszone = 0;
+  header.sigfigs = 0;
+  header.snaplen = EB_CAPTURE_SNAPLEN;
+  header.linktype = EB_CAPTURE_LINKTYPE;
+  
+  if (fwrite(&header, sizeof(header), 1, file) != 1) return -1;
+  return 0;
+}
+
+void eb_capture_packet(FILE* file, int direction, struct eb_transport* transport, eb_device_t devicep, const uint8_t* buf, int len) {
+  struct eb_capture_record record;
+  struct eb_capture_info info;
+  uint32_t device;
+#if !defined(__WIN32) && defined(CLOCK_REALTIME)
+  struct timespec now;
+  
+  clock_gettime(CLOCK_REALTIME, &now);
+  record.sec = now.tv_sec;
+  record.nsec = now.tv_nsec;
+#else
+  struct timeval now;
+  
+  gettimeofday(&now, 0);
+  record.sec = now.tv_sec;
+  record.nsec = now.tv_usec * 1000;
+#endif
+  
+  if (len <= 0) return;
+  if (len > EB_CAPTURE_SNAPLEN - (int)sizeof(info)) len = EB_CAPTURE_SNAPLEN - sizeof(info);
+  
+  record.caplen = record.len = sizeof(info) + len;
+  
+  device = (uint32_t)(uintptr_t)devicep;
+  info.direction = direction;
+  info.stream = eb_transports[transport->link_type].mtu == 0;
+  info.transport = transport->link_type;
+  info.pad = 0;
+  info.device[0] = device >> 24;
+  info.device[1] = device >> 16;
+  info.device[2] = device >>  8;
+  info.device[3] = device;
+  
+  /* Write errors are reported when the capture is stopped */
+  if (fwrite(&record, sizeof(record), 1, file) != 1) return;
+  if (fwrite(&info, sizeof(info), 1, file) != 1) return;
+  fwrite(buf, 1, len, file);
+}
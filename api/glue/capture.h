@@ -0,0 +1,81 @@
+/** @file capture.h
+ *  @brief Recording the packets of a socket into a pcap file.
+ *
+ *  Copyright (C) 2026 GSI Helmholtz Centre for Heavy Ion Research GmbH
+ *
+ *  The file is in the classic libpcap format with nanosecond timestamps.
+ *  Etherbone has no link type of its own, so packets are stored under
+ *  LINKTYPE_USER0, each preceded by a small header saying which way it
+ *  went and over which device. eb-replay reads these files back.
+ *
+ *  @author Etherbone Core Developers <etherbone-core@ohwr.org>
+ *
+ *  @bug None!
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#ifndef EB_CAPTURE_H
+#define EB_CAPTURE_H
+
+#include <stdio.h>
+
+#include "../etherbone.h"
+#include "../transport/transport.h"
+
+#define EB_CAPTURE_MAGIC     0xA1B23C4DUL /* nanosecond timestamps */
+#define EB_CAPTURE_MAGIC_US  0xA1B2C3D4UL /* microsecond timestamps */
+#define EB_CAPTURE_LINKTYPE  147          /* LINKTYPE_USER0 */
+#define EB_CAPTURE_SNAPLEN   65535
+
+#define EB_CAPTURE_SENT      0
+#define EB_CAPTURE_RECEIVED  1
+
+/* Start of the file; fields in the byte order of the writer */
+struct eb_capture_file {
+  uint32_t magic;
+  uint16_t version_major; /* 2 */
+  uint16_t version_minor; /* 4 */
+  int32_t  thiszone;
+  uint32_t sigfigs;
+  uint32_t snaplen;
+  uint32_t linktype;
+};
+
+/* Before each packet; fields in the byte order of the writer */
+struct eb_capture_record {
+  uint32_t sec;
+  uint32_t nsec;    /* usec for EB_CAPTURE_MAGIC_US */
+  uint32_t caplen;  /* bytes in the file: eb_capture_info + packet */
+  uint32_t len;
+};
+
+/* First bytes of each packet */
+struct eb_capture_info {
+  uint8_t  direction; /* EB_CAPTURE_SENT or EB_CAPTURE_RECEIVED */
+  uint8_t  stream;    /* 1 if a byte stream: the packet is an arbitrary chunk */
+  uint8_t  transport; /* which of eb_transports carried it */
+  uint8_t  pad;
+  uint8_t  device[4]; /* big-endian handle of the device; EB_NULL if none */
+};
+
+/* Write the file header; returns -1 on failure */
+EB_PRIVATE int eb_capture_open(FILE* file);
+
+/* Append one packet to the capture */
+EB_PRIVATE void eb_capture_packet(FILE* file, int direction, struct eb_transport* transport, eb_device_t device, const uint8_t* buf, int len);
+
+#endif
@@ -31,11 +31,69 @@
 #include "operation.h"
 #include "cycle.h"
 #include "device.h"
+#include "socket.h"
+#include "timer.h"
+#include "queue.h"
+#include "trace.h"
 #include "../memory/memory.h"
 
 static void eb_block_f(eb_user_data_t user, eb_device_t device, eb_operation_t operation, eb_status_t status) {
-  eb_status_t* ptr = (eb_status_t*)user;
-  *ptr = status;
+  struct eb_block_wait* wait = (struct eb_block_wait*)user;
+  wait->status = status;
+  eb_socket_unblock(wait->cond);
+}
+
+void eb_group_init(struct eb_group* group) {
+  group->status = EB_OK;
+  group->failed = 0;
+  group->pending = 0;
+  group->cond = 0;
+}
+
+void eb_group_done(eb_user_data_t user, eb_device_t device, eb_operation_t operation, eb_status_t status) {
+  struct eb_group* group = (struct eb_group*)user;
+  
+  if (status != EB_OK && group->failed++ == 0)
+    group->status = status;
+  
+  /* Atomic: eb_queue_submit may add to the group from another thread */
+  if (__atomic_sub_fetch(&group->pending, 1, __ATOMIC_RELEASE) == 0)
+    eb_socket_unblock(group->cond);
+}
+
+eb_status_t eb_group_wait(eb_socket_t socketp, struct eb_group* group) {
+  eb_socket_block(socketp, &group->pending, &group->cond);
+  return group->status;
+}
+
+void eb_cycle_finish(eb_cycle_t cyclep, eb_operation_t operationp, eb_status_t status) {
+  struct eb_cycle* cycle;
+  struct eb_completion done;
+  eb_operation_t first;
+  
+  cycle = EB_CYCLE(cyclep);
+  
+  eb_trace(EB_TRACE_CALLBACK, EB_TRACE_HANDLE(cycle->un_link.device), EB_TRACE_HANDLE(cyclep), status);
+  
+  if (cycle->callback == &eb_complete) {
+    /* Hand the operations over to the completion ring */
+    first = (cycle->un_ops.dead == cyclep) ? EB_NULL : cycle->un_ops.first;
+    
+    done.user_data = cycle->user_data;
+    done.device = cycle->un_link.device;
+    done.operation = operationp;
+    done.status = status;
+    
+    eb_free_cycle(cyclep);
+    eb_queue_complete(eb_device_socket(done.device), &done, first);
+  } else {
+    (*cycle->callback)(cycle->user_data, cycle->un_link.device, operationp, status);
+    
+    eb_cycle_destroy(cyclep);
+    eb_free_cycle(cyclep);
+  }
+  
+  eb_trace(EB_TRACE_RETURN, EB_TRACE_NONE, EB_TRACE_HANDLE(cyclep), status);
 }
 
 eb_device_t eb_cycle_device(eb_cycle_t cyclep) {
@@ -45,6 +103,29 @@ eb_device_t eb_cycle_device(eb_cycle_t cyclep) {
   return cycle->un_link.device;
 }
 
+void eb_cycle_timeout(eb_cycle_t cyclep, uint32_t timeout_us) {
+  struct eb_cycle* cycle;
+  
+  if (timeout_us > EB_TIMER_MAX) timeout_us = EB_TIMER_MAX;
+  
+  cycle = EB_CYCLE(cyclep);
+  cycle->timeout = timeout_us;
+}
+
+void eb_cycle_priority(eb_cycle_t cyclep, int priority) {
+  struct eb_cycle* cycle;
+  
+  cycle = EB_CYCLE(cyclep);
+  cycle->priority = (priority == EB_PRIORITY_REALTIME);
+}
+
+void eb_cycle_idempotent(eb_cycle_t cyclep) {
+  struct eb_cycle* cycle;
+  
+  cycle = EB_CYCLE(cyclep);
+  cycle->idempotent = 1;
+}
+
 eb_status_t eb_cycle_open(eb_device_t devicep, eb_user_data_t user, eb_callback_t cb, eb_cycle_t* result) {
   eb_cycle_t cyclep;
   struct eb_cycle* cycle;
@@ -69,6 +150,9 @@ eb_status_t eb_cycle_open(eb_device_t devicep, eb_user_data_t user, eb_callback_
   cycle->user_data = user;
   cycle->un_ops.first = EB_NULL;
   cycle->un_link.device = devicep;
+  cycle->timeout = 0;
+  cycle->idempotent = 0;
+  cycle->priority = EB_PRIORITY_BULK;
   
   if (cb) {
     cycle->callback = cb;
@@ -76,6 +160,10 @@ eb_status_t eb_cycle_open(eb_device_t devicep, eb_user_data_t user, eb_callback_
     cycle->callback = &eb_block_f;
   }
   
+  /* The group callback runs exactly once from now on */
+  if (cb == &eb_group_done)
+    __atomic_add_fetch(&((struct eb_group*)user)->pending, 1, __ATOMIC_RELAXED);
+  
   ++device->unready;
     
   *result = cyclep;
@@ -106,6 +194,10 @@ void eb_cycle_abort(eb_cycle_t cyclep) {
   device = EB_DEVICE(cycle->un_link.device);
   --device->unready;
   
+  /* An aborted cycle no longer holds up its group */
+  if (cycle->callback == &eb_group_done)
+    __atomic_sub_fetch(&((struct eb_group*)cycle->user_data)->pending, 1, __ATOMIC_RELAXED);
+  
   eb_cycle_destroy(cyclep);
   eb_free_cycle(cyclep);
 }
@@ -129,31 +221,34 @@ static void eb_raw_cycle_close(eb_cycle_t cyclep) {
       prev = i;
     }
     cycle->un_ops.first = prev;
+    
+    /* The latency of the cycle starts now */
+    if (prev != EB_NULL && device->flow != 0 && device->flow->latency != 0)
+      EB_OPERATION(prev)->queued = eb_socket_clock();
   }
   
-  /* Queue us to the device */
-  cycle->un_link.next = device->un_link.ready;
-  device->un_link.ready = cyclep;
-  
   /* Remove us from the incomplete cycle counter */
   --device->unready;
+  
+  eb_trace(EB_TRACE_CLOSE, EB_TRACE_HANDLE(cycle->un_link.device), EB_TRACE_HANDLE(cyclep), 0);
+  
+  /* Queue us to the device */
+  eb_device_queue(cycle->un_link.device, cyclep);
 }
 
 static eb_status_t eb_cycle_block(eb_device_t devicep, eb_cycle_t cyclep) {
   struct eb_cycle* cycle;
-  eb_status_t status;
-  eb_socket_t socketp;
+  struct eb_block_wait wait;
 
   cycle = EB_CYCLE(cyclep);
   
   if (cycle->callback == &eb_block_f) {
-    status = 1;
-    cycle->user_data = &status;
-    
-    socketp = eb_device_socket(devicep);
-    while (status > 0) eb_socket_run(socketp, -1);
+    wait.status = 1;
+    wait.cond = 0;
+    cycle->user_data = &wait;
     
-    return status;
+    eb_socket_block(eb_device_socket(devicep), &wait.status, &wait.cond);
+    return wait.status;
   } else {
     return EB_OK;
   }
@@ -45,9 +45,16 @@ struct eb_cycle {
     eb_cycle_t next;
     eb_device_t device;
   } un_link;
+  
+  unsigned int timeout : 30;   /* microseconds; 0 = EB_TIMER_DEFAULT */
+  unsigned int idempotent : 1; /* may be retransmitted */
+  unsigned int priority : 1;   /* EB_PRIORITY_{BULK,REALTIME} */
 };
 
 /* Recursively free the operations. Does not free cycle. */
 EB_PRIVATE void eb_cycle_destroy(eb_cycle_t cycle);
 
+/* Report the outcome to the user, then free the cycle. Invalidates pointers. */
+EB_PRIVATE void eb_cycle_finish(eb_cycle_t cycle, eb_operation_t operation, eb_status_t status);
+
 #endif
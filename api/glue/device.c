@@ -31,11 +31,51 @@
 #include "device.h"
 #include "socket.h"
 #include "widths.h"
+#include "histogram.h"
+#include "capture.h"
+#include "operation.h"
 #include "../transport/transport.h"
 #include "../memory/memory.h"
 #include "../format/bigendian.h"
 
-eb_status_t eb_device_open(eb_socket_t socketp, const char* address, eb_width_t proposed_widths, int attempts, eb_device_t* result) {
+#include <stdlib.h>
+#include <string.h>
+
+/* Allocate the counters and flow control state on first use */
+static struct eb_device_flow* eb_device_flow(eb_device_t devicep) {
+  struct eb_device* device;
+  struct eb_device_flow* flow;
+  
+  device = EB_DEVICE(devicep);
+  if (device->flow != 0) return device->flow;
+  
+  if ((flow = (struct eb_device_flow*)malloc(sizeof(struct eb_device_flow))) == 0)
+    return 0;
+  
+  memset(&flow->stats, 0, sizeof(flow->stats));
+  flow->retries = 0;
+  flow->srtt = 0;
+  flow->rttvar = 0;
+  flow->byte_rate = 0;
+  flow->packet_rate = 0;
+  flow->byte_credit = 0;
+  flow->packet_credit = 0;
+  flow->byte_burst = 0;
+  flow->packet_burst = 0;
+  flow->refilled = eb_socket_clock();
+  flow->window = 0;
+  flow->inflight = 0;
+  flow->cwnd = 0;
+  flow->ssthresh = 0;
+  flow->reduced = flow->refilled;
+  flow->latency = 0;
+  
+  device->flow = flow;
+  return flow;
+}
+
+/* Allocate the device and connect its link; probing is up to the caller */
+static eb_status_t eb_device_connect(eb_socket_t socketp, const char* address, eb_width_t proposed_widths, eb_device_t* result) {
   eb_device_t devicep;
   eb_transport_t transportp;
   eb_link_t linkp;
@@ -73,8 +113,19 @@ eb_status_t eb_device_open(eb_socket_t socketp, const char* address, eb_width_t
   device = EB_DEVICE(devicep);
   device->socket = socketp;
   device->un_link.ready = EB_NULL;
+  device->urgent = EB_NULL;
   device->unready = 0;
+  device->flow = 0;
   device->link = linkp;
+  device->widths = 0;
+  
+  /* Devices opened by the user always keep counters */
+  if (eb_device_flow(devicep) == 0) {
+    eb_free_link(linkp);
+    eb_free_device(devicep);
+    *result = EB_NULL;
+    return EB_OOM;
+  }
   
   link = EB_LINK(linkp);
   
@@ -87,6 +138,8 @@ eb_status_t eb_device_open(eb_socket_t socketp, const char* address, eb_width_t
   }
   
   if (transportp == EB_NULL) {
+    device = EB_DEVICE(devicep);
+    free(device->flow);
     eb_free_link(linkp);
     eb_free_device(devicep);
     *result = EB_NULL;
@@ -94,6 +147,8 @@ eb_status_t eb_device_open(eb_socket_t socketp, const char* address, eb_width_t
   }
   
   if (status != EB_OK) {
+    device = EB_DEVICE(devicep);
+    free(device->flow);
     eb_free_link(linkp);
     eb_free_device(devicep);
     *result = EB_NULL;
@@ -104,8 +159,87 @@ eb_status_t eb_device_open(eb_socket_t socketp, const char* address, eb_width_t
   device->next = socket->first_device;
   socket->first_device = devicep;
   
-  /* If the connection is streaming, we must do exactly one handshake */
-  if (eb_transports[transport->link_type].mtu == 0)
+  *result = devicep;
+  return EB_OK;
+}
+
+/* If the connection is streaming, we must do exactly one handshake */
+static int eb_device_streaming(eb_device_t devicep) {
+  struct eb_device* device;
+  struct eb_transport* transport;
+  
+  device = EB_DEVICE(devicep);
+  transport = EB_TRANSPORT(device->transport);
+  return eb_transports[transport->link_type].mtu == 0;
+}
+
+/* Ask the remote side for its widths; the answer fills device->widths */
+static void eb_device_probe(eb_device_t devicep, eb_width_t proposed_widths) {
+  uint8_t buf[8] = { 0x4E, 0x6F, 0x11, 0, 0x0, 0x0, 0x0, 0x0 };
+  struct eb_device* device;
+  struct eb_transport* transport;
+  struct eb_link* link;
+  FILE* capture;
+  
+  device = EB_DEVICE(devicep);
+  link = EB_LINK(device->link);
+  transport = EB_TRANSPORT(device->transport);
+  
+  buf[3] = proposed_widths;
+  *(uint32_t*)(buf+4) = htobe32((uint32_t)(uintptr_t)devicep);
+  eb_transports[transport->link_type].send(transport, link, buf, sizeof(buf));
+  
+  capture = EB_SOCKET(device->socket)->state->capture;
+  if (capture != 0) eb_capture_packet(capture, EB_CAPTURE_SENT, transport, devicep, buf, sizeof(buf));
+}
+
+/* Has the probe been answered (or the link failed)? */
+static int eb_device_probed(eb_device_t devicep) {
+  struct eb_device* device;
+  
+  device = EB_DEVICE(devicep);
+  return device->link == EB_NULL || device->widths != 0;
+}
+
+/* Agree on widths once probing is over; closes the device on failure */
+static eb_status_t eb_device_settle(eb_device_t devicep, eb_width_t proposed_widths) {
+  struct eb_device* device;
+  eb_status_t status;
+  
+  device = EB_DEVICE(devicep);
+  
+  if (device->link == EB_NULL) {
+    status = EB_FAIL;
+  } else if (device->widths == 0) {
+    status = EB_TIMEOUT;
+  } else {
+    device->widths &= proposed_widths;
+    if (eb_width_possible(device->widths) == 0) {
+      status = EB_WIDTH;
+    } else {
+      device->widths = eb_width_refine(device->widths);
+      return EB_OK;
+    }
+  }
+  
+  eb_device_close(devicep);
+  return status;
+}
+
+eb_status_t eb_device_open(eb_socket_t socketp, const char* address, eb_width_t proposed_widths, int attempts, eb_device_t* result) {
+  eb_device_t devicep;
+  struct eb_device* device;
+  eb_status_t status;
+  int timeout, got;
+  
+  if ((status = eb_device_connect(socketp, address, proposed_widths, &devicep)) != EB_OK) {
+    *result = EB_NULL;
+    return status;
+  }
+  
+  proposed_widths &= EB_SOCKET(socketp)->widths;
+  
+  if (eb_device_streaming(devicep))
     attempts = 1;
   
   if (attempts == 0) {
@@ -116,53 +250,99 @@ eb_status_t eb_device_open(eb_socket_t socketp, const char* address, eb_width_t
       return EB_WIDTH;
     }
     
+    device = EB_DEVICE(devicep);
     device->widths = proposed_widths;
   } else {
     /* Try to determine port width */
-    device->widths = 0;
     do {
-      uint8_t buf[8] = { 0x4E, 0x6F, 0x11, 0, 0x0, 0x0, 0x0, 0x0 };
-      int timeout, got;
-      
-      buf[3] = proposed_widths;
-      
-      link = EB_LINK(device->link);
-      transport = EB_TRANSPORT(device->transport);
-      
-      *(uint32_t*)(buf+4) = htobe32((uint32_t)(uintptr_t)devicep);
-      eb_transports[transport->link_type].send(transport, link, buf, sizeof(buf));
+      eb_device_probe(devicep, proposed_widths);
       
       timeout = 3000000; /* 3 seconds */
-      while (timeout > 0 && device->link != EB_NULL && device->widths == 0) {
+      while (timeout > 0 && !eb_device_probed(devicep)) {
         got = eb_socket_run(socketp, timeout); /* Invalidates all pointers */
         timeout -= got;
-        device = EB_DEVICE(devicep);
       }
-    } while (device->widths == 0 && device->link != EB_NULL && --attempts != 0);
+    } while (!eb_device_probed(devicep) && --attempts != 0);
     
-    if (device->link == EB_NULL) {
-      eb_device_close(devicep);
+    if ((status = eb_device_settle(devicep, proposed_widths)) != EB_OK) {
       *result = EB_NULL;
-      return EB_FAIL;
+      return status;
     }
-    
-    if (device->widths == 0) {
-      eb_device_close(devicep);
-      *result = EB_NULL;
-      return EB_TIMEOUT;
+  }
+  
+  *result = devicep;
+  return EB_OK;
+}
+
+eb_status_t eb_device_open_all(eb_socket_t socketp, int count, const char* const* addresses, eb_width_t proposed_widths, int attempts, eb_user_data_t user, eb_device_open_callback_t cb) {
+  eb_device_t* devices;
+  eb_status_t status;
+  int i, pending, round, timeout, got;
+  
+  if ((devices = (eb_device_t*)malloc(count * sizeof(eb_device_t))) == 0)
+    return EB_OOM;
+  
+  /* Look up all the host names at once, so connect only hits the cache */
+  eb_transport_prefetch(addresses, count);
+  
+  proposed_widths &= EB_SOCKET(socketp)->widths;
+  
+  pending = 0;
+  for (i = 0; i < count; ++i) {
+    if ((status = eb_device_connect(socketp, addresses[i], proposed_widths, &devices[i])) != EB_OK) {
+      devices[i] = EB_NULL;
+      (*cb)(user, i, EB_NULL, status);
+    } else if (attempts == 0) {
+      if (!eb_width_refined(proposed_widths)) {
+        eb_device_close(devices[i]);
+        devices[i] = EB_NULL;
+        (*cb)(user, i, EB_NULL, EB_WIDTH);
+      } else {
+        EB_DEVICE(devices[i])->widths = proposed_widths;
+        (*cb)(user, i, devices[i], EB_OK);
+        devices[i] = EB_NULL;
+      }
+    } else {
+      ++pending;
+    }
+  }
+  
+  /* Every round probes all unanswered devices together */
+  for (round = 0; pending > 0 && round != attempts; ++round) {
+    for (i = 0; i < count; ++i) {
+      if (devices[i] == EB_NULL) continue;
+      /* Streaming links get exactly one handshake */
+      if (round == 0 || !eb_device_streaming(devices[i]))
+        eb_device_probe(devices[i], proposed_widths);
     }
     
-    device->widths &= proposed_widths;
-    if (eb_width_possible(device->widths) == 0) {
-      eb_device_close(devicep);
-      *result = EB_NULL;
-      return EB_WIDTH;
+    timeout = 3000000; /* 3 seconds */
+    while (timeout > 0 && pending > 0) {
+      got = eb_socket_run(socketp, timeout); /* Invalidates all pointers */
+      timeout -= got;
+      
+      /* Report devices in the order their answers arrive */
+      for (i = 0; i < count; ++i) {
+        if (devices[i] == EB_NULL) continue;
+        if (!eb_device_probed(devices[i]) && (timeout > 0 || !eb_device_streaming(devices[i]))) continue;
+        
+        status = eb_device_settle(devices[i], proposed_widths);
+        (*cb)(user, i, status == EB_OK ? devices[i] : EB_NULL, status);
+        devices[i] = EB_NULL;
+        --pending;
+      }
     }
+  }
+  
+  /* Whoever remains never answered */
+  for (i = 0; i < count; ++i) {
+    if (devices[i] == EB_NULL) continue;
     
-    device->widths = eb_width_refine(device->widths);
+    eb_device_settle(devices[i], proposed_widths);
+    (*cb)(user, i, EB_NULL, EB_TIMEOUT);
   }
   
-  *result = devicep;
+  free(devices);
   return EB_OK;
 }
 
@@ -232,7 +412,9 @@ eb_status_t eb_socket_passive(eb_socket_t socketp, const char* address) {
   device = EB_DEVICE(devicep);
   device->socket = socketp;
   device->un_link.passive = devicep;
+  device->urgent = EB_NULL;
   device->unready = 0;
+  device->flow = 0;
   device->widths = 0;
   device->link = linkp;
   
@@ -284,7 +466,9 @@ eb_link_t eb_device_new_slave(eb_socket_t socketp, eb_transport_t transportp, eb
   
   device->socket = socketp;
   device->un_link.passive = devicep;
+  device->urgent = EB_NULL;
   device->unready = 0;
+  device->flow = 0;
   device->widths = 0;
   device->link = linkp;
   device->transport = transportp;
@@ -312,7 +496,7 @@ eb_status_t eb_device_close(eb_device_t devicep) {
   eb_device_t* ptr, i;
   eb_link_t linkp;
   eb_socket_t socketp;
-  eb_cycle_t cyclep, nextp, prevp, firstp;
+  eb_cycle_t cyclep, nextp, firstp;
   
   device = EB_DEVICE(devicep);
   socketp = device->socket;
@@ -321,8 +505,9 @@ eb_status_t eb_device_close(eb_device_t devicep) {
     return EB_BUSY;
     
   if (device->un_link.passive != devicep) {
-    /* We will clear these cycles */
-    firstp = device->un_link.ready;
+    /* We will clear these cycles, so the answers come back 'in order' */
+    firstp = eb_device_dequeue(devicep);
+    device = EB_DEVICE(devicep);
     
     /* Mark the device as inappropriate for cycle_open */
     device->un_link.passive = devicep;
@@ -334,26 +519,13 @@ eb_status_t eb_device_close(eb_device_t devicep) {
     firstp = EB_NULL;
   }
   
-  /* First, reverse the list so the answer come back 'in order' */
-  prevp = EB_NULL;
-  for (cyclep = firstp; cyclep != EB_NULL; cyclep = nextp) {
-    cycle = EB_CYCLE(cyclep);
-    nextp = cycle->un_link.next;
-    cycle->un_link.next = prevp;
-    prevp = cyclep;
-  }
-  
   /* Kill the cycles */
-  for (cyclep = prevp; cyclep != EB_NULL; cyclep = nextp) {
+  for (cyclep = firstp; cyclep != EB_NULL; cyclep = nextp) {
     cycle = EB_CYCLE(cyclep);
     nextp = cycle->un_link.next;
     
     cycle->un_link.device = devicep;
-    (*cycle->callback)(cycle->user_data, cycle->un_link.device, cycle->un_ops.first, EB_TIMEOUT);
-    
-    /* Free it */
-    eb_cycle_destroy(cyclep);
-    eb_free_cycle(cyclep);
+    eb_cycle_finish(cyclep, cycle->un_ops.first, EB_TIMEOUT);
   }
   
   /* Refresh pointers */
@@ -382,6 +554,8 @@ eb_status_t eb_device_close(eb_device_t devicep) {
     eb_free_link(linkp);
   }
   
+  if (device->flow != 0) free(device->flow->latency);
+  free(device->flow);
   eb_free_device(devicep);
   
   return EB_OK;
@@ -394,6 +568,319 @@ eb_width_t eb_device_width(eb_device_t devicep) {
   return device->widths;
 }
 
+eb_status_t eb_device_retransmit(eb_device_t devicep, int retries) {
+  struct eb_device_flow* flow;
+  
+  if (retries < 0) retries = 0;
+  if (retries > EB_MAX_RETRIES) retries = EB_MAX_RETRIES;
+  
+  if ((flow = eb_device_flow(devicep)) == 0)
+    return EB_OOM;
+  
+  flow->retries = retries;
+  return EB_OK;
+}
+
+eb_status_t eb_device_pace(eb_device_t devicep, uint32_t bytes_per_second, uint32_t burst_bytes, uint32_t packets_per_second, uint32_t burst_packets) {
+  struct eb_device_flow* flow;
+  
+  if ((flow = eb_device_flow(devicep)) == 0)
+    return EB_OOM;
+  
+  /* A bucket must hold at least one packet */
+  if (burst_bytes == 0) burst_bytes = 1;
+  if (burst_packets == 0) burst_packets = 1;
+  
+  flow->byte_rate = bytes_per_second;
+  flow->packet_rate = packets_per_second;
+  flow->byte_burst = (int64_t)burst_bytes * 1000000;
+  flow->packet_burst = (int64_t)burst_packets * 1000000;
+  
+  /* Start out full */
+  flow->byte_credit = flow->byte_burst;
+  flow->packet_credit = flow->packet_burst;
+  flow->refilled = eb_socket_clock();
+  
+  return EB_OK;
+}
+
+void eb_device_queue(eb_device_t devicep, eb_cycle_t cyclep) {
+  struct eb_device* device;
+  struct eb_cycle* cycle;
+  
+  device = EB_DEVICE(devicep);
+  cycle = EB_CYCLE(cyclep);
+  
+  if (cycle->priority == EB_PRIORITY_REALTIME) {
+    cycle->un_link.next = device->urgent;
+    device->urgent = cyclep;
+  } else {
+    cycle->un_link.next = device->un_link.ready;
+    device->un_link.ready = cyclep;
+  }
+}
+
+eb_cycle_t eb_device_dequeue(eb_device_t devicep) {
+  struct eb_device* device;
+  struct eb_cycle* cycle;
+  eb_cycle_t cyclep, nextp, prevp;
+  
+  device = EB_DEVICE(devicep);
+  
+  /* Both queues are stacks; reversing urgent onto the reversed bulk
+   * queue leaves the realtime cycles in front.
+   */
+  prevp = EB_NULL;
+  for (cyclep = device->un_link.ready; cyclep != EB_NULL; cyclep = nextp) {
+    cycle = EB_CYCLE(cyclep);
+    nextp = cycle->un_link.next;
+    cycle->un_link.next = prevp;
+    prevp = cyclep;
+  }
+  for (cyclep = device->urgent; cyclep != EB_NULL; cyclep = nextp) {
+    cycle = EB_CYCLE(cyclep);
+    nextp = cycle->un_link.next;
+    cycle->un_link.next = prevp;
+    prevp = cyclep;
+  }
+  
+  device->un_link.ready = EB_NULL;
+  device->urgent = EB_NULL;
+  
+  return prevp;
+}
+
+eb_status_t eb_device_window(eb_device_t devicep, int max_cycles) {
+  struct eb_device_flow* flow;
+  
+  if (max_cycles < 0) max_cycles = 0;
+  if (max_cycles > 0xFFFF) max_cycles = 0xFFFF;
+  if (max_cycles != 0 && max_cycles < EB_CWND_MIN) max_cycles = EB_CWND_MIN;
+  
+  if ((flow = eb_device_flow(devicep)) == 0)
+    return EB_OOM;
+  
+  flow->window = max_cycles;
+  flow->ssthresh = (uint32_t)max_cycles << 8;
+  flow->cwnd = (max_cycles < EB_CWND_INIT ? max_cycles : EB_CWND_INIT) << 8;
+  flow->reduced = eb_socket_clock();
+  
+  return EB_OK;
+}
+
+void eb_device_stats(eb_device_t devicep, struct eb_stats* stats) {
+  struct eb_device* device;
+  
+  device = EB_DEVICE(devicep);
+  if (device->flow != 0)
+    *stats = device->flow->stats;
+  else
+    memset(stats, 0, sizeof(*stats));
+}
+
+eb_status_t eb_device_histograms(eb_device_t devicep, int enable) {
+  struct eb_device_flow* flow;
+  struct eb_histogram* latency;
+  uint32_t clock;
+  
+  if ((flow = eb_device_flow(devicep)) == 0)
+    return EB_OOM;
+  
+  if (!enable) {
+    free(flow->latency);
+    flow->latency = 0;
+    return EB_OK;
+  }
+  
+  if (flow->latency != 0) return EB_OK;
+  
+  if ((latency = (struct eb_histogram*)malloc(2*sizeof(struct eb_histogram))) == 0)
+    return EB_OOM;
+  
+  clock = eb_socket_clock();
+  eb_histogram_reset(&latency[EB_LATENCY_CYCLE], clock);
+  eb_histogram_reset(&latency[EB_LATENCY_RTT], clock);
+  
+  flow->latency = latency;
+  return EB_OK;
+}
+
+eb_status_t eb_device_latency(eb_device_t devicep, int which, struct eb_latency* latency) {
+  struct eb_device* device;
+  
+  device = EB_DEVICE(devicep);
+  if (device->flow == 0 || device->flow->latency == 0) return EB_FAIL;
+  if (which != EB_LATENCY_CYCLE && which != EB_LATENCY_RTT) return EB_FAIL;
+  
+  eb_histogram_summary(&device->flow->latency[which], latency);
+  return EB_OK;
+}
+
+void eb_device_latency_reset(eb_device_t devicep) {
+  struct eb_device* device;
+  uint32_t clock;
+  
+  device = EB_DEVICE(devicep);
+  if (device->flow == 0 || device->flow->latency == 0) return;
+  
+  clock = eb_socket_clock();
+  eb_histogram_reset(&device->flow->latency[EB_LATENCY_CYCLE], clock);
+  eb_histogram_reset(&device->flow->latency[EB_LATENCY_RTT], clock);
+}
+
+void eb_device_measure(struct eb_device_flow* flow, eb_operation_t firstp, int answered, uint32_t sent) {
+  struct eb_histogram* cycle;
+  uint32_t clock, queued;
+  
+  clock = eb_socket_clock();
+  cycle = &flow->latency[EB_LATENCY_CYCLE];
+  
+  if (answered)
+    eb_histogram_add(&flow->latency[EB_LATENCY_RTT], clock - sent);
+  
+  /* Cycles closed before the histograms were enabled were not stamped */
+  queued = EB_OPERATION(firstp)->queued;
+  if ((int32_t)(queued - cycle->since) >= 0 && (int32_t)(clock - queued) >= 0)
+    eb_histogram_add(cycle, clock - queued);
+}
+
+void eb_device_requeue(eb_device_t devicep, eb_cycle_t cyclep) {
+  struct eb_device* device;
+  struct eb_cycle* cycle;
+  eb_cycle_t nextp, urgent, ready, *tailp;
+  
+  /* Stack the returned cycles by priority, newest on top */
+  urgent = ready = EB_NULL;
+  for (; cyclep != EB_NULL; cyclep = nextp) {
+    cycle = EB_CYCLE(cyclep);
+    nextp = cycle->un_link.next;
+    
+    if (cycle->priority == EB_PRIORITY_REALTIME) {
+      cycle->un_link.next = urgent;
+      urgent = cyclep;
+    } else {
+      cycle->un_link.next = ready;
+      ready = cyclep;
+    }
+  }
+  
+  /* They are older than anything queued since, so go underneath */
+  device = EB_DEVICE(devicep);
+  for (tailp = &device->urgent; *tailp != EB_NULL; tailp = &cycle->un_link.next)
+    cycle = EB_CYCLE(*tailp);
+  *tailp = urgent;
+  
+  for (tailp = &device->un_link.ready; *tailp != EB_NULL; tailp = &cycle->un_link.next)
+    cycle = EB_CYCLE(*tailp);
+  *tailp = ready;
+}
+
+uint32_t eb_device_rto(struct eb_device_flow* flow, int attempt) {
+  uint32_t rto;
+  
+  if (flow->srtt == 0) {
+    rto = EB_RTO_INIT;
+  } else {
+    rto = flow->srtt + 4*flow->rttvar;
+    if (rto < EB_RTO_MIN) rto = EB_RTO_MIN;
+  }
+  
+  rto <<= attempt;
+  if (rto > EB_RTO_MAX) rto = EB_RTO_MAX;
+  
+  return rto;
+}
+
+void eb_device_rtt(struct eb_device_flow* flow, uint32_t rtt) {
+  int32_t err;
+  
+  /* Jacobson/Karels, as RFC 6298: gains of 1/8 and 1/4 */
+  if (flow->srtt == 0) {
+    flow->srtt = rtt ? rtt : 1;
+    flow->rttvar = rtt/2;
+  } else {
+    err = rtt - flow->srtt;
+    flow->srtt += err/8;
+    if (flow->srtt == 0) flow->srtt = 1;
+    if (err < 0) err = -err;
+    flow->rttvar += (err - (int32_t)flow->rttvar)/4;
+  }
+}
+
+/* Microseconds until credit reaches need, at rate per second */
+static long eb_device_bucket(int64_t credit, int64_t need, uint32_t rate) {
+  if (rate == 0 || credit >= need) return 0;
+  return (long)((need - credit + rate - 1) / rate);
+}
+
+long eb_device_pace_wait(struct eb_device_flow* flow, uint32_t clock, int bytes) {
+  int64_t need;
+  uint32_t elapsed;
+  long wait, packets;
+  
+  if (!eb_device_paced(flow)) return 0;
+  
+  /* Refill; long idle periods only top the buckets up */
+  elapsed = clock - flow->refilled;
+  if ((int32_t)elapsed < 0) elapsed = 0;
+  if (elapsed > 60000000) elapsed = 60000000;
+  flow->refilled = clock;
+  
+  flow->byte_credit += (int64_t)flow->byte_rate * elapsed;
+  if (flow->byte_credit > flow->byte_burst) flow->byte_credit = flow->byte_burst;
+  flow->packet_credit += (int64_t)flow->packet_rate * elapsed;
+  if (flow->packet_credit > flow->packet_burst) flow->packet_credit = flow->packet_burst;
+  
+  /* A packet bigger than the bucket waits for a full bucket */
+  need = (int64_t)bytes * 1000000;
+  if (need > flow->byte_burst) need = flow->byte_burst;
+  
+  wait    = eb_device_bucket(flow->byte_credit,   need,    flow->byte_rate);
+  packets = eb_device_bucket(flow->packet_credit, 1000000, flow->packet_rate);
+  
+  return (wait > packets) ? wait : packets;
+}
+
+void eb_device_pace_charge(struct eb_device_flow* flow, int bytes) {
+  if (flow->byte_rate != 0)
+    flow->byte_credit -= (int64_t)bytes * 1000000;
+  if (flow->packet_rate != 0)
+    flow->packet_credit -= 1000000;
+}
+
+void eb_device_sent(struct eb_device_flow* flow) {
+  if (flow->window != 0 && flow->inflight != 0xFFFF)
+    ++flow->inflight;
+}
+
+void eb_device_acked(struct eb_device_flow* flow) {
+  if (flow->inflight != 0) --flow->inflight;
+  if (flow->window == 0) return;
+  
+  /* Slow start adds a cycle per reply, then one per window of replies */
+  if (flow->cwnd < flow->ssthresh)
+    flow->cwnd += 256;
+  else
+    flow->cwnd += 65536 / flow->cwnd;
+  
+  if (flow->cwnd > (uint32_t)flow->window << 8)
+    flow->cwnd = (uint32_t)flow->window << 8;
+}
+
+void eb_device_lost(struct eb_device_flow* flow, uint32_t sent, uint32_t clock) {
+  if (flow->inflight != 0) --flow->inflight;
+  if (flow->window == 0) return;
+  
+  /* The losses of one window are one congestion event */
+  if ((int32_t)(sent - flow->reduced) < 0) return;
+  flow->reduced = clock;
+  
+  flow->cwnd /= 2;
+  if (flow->cwnd < EB_CWND_MIN << 8)
+    flow->cwnd = EB_CWND_MIN << 8;
+  flow->ssthresh = flow->cwnd;
+}
+
 eb_socket_t eb_device_socket(eb_device_t devicep) {
   struct eb_device* device;
   
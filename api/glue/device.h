@@ -41,14 +41,101 @@ struct eb_device {
     eb_cycle_t ready;
     eb_device_t passive; /* points to self if a 'server' link */
   } un_link;
+  eb_cycle_t urgent; /* EB_PRIORITY_REALTIME cycles, sent before un_link.ready */
   
   uint8_t unready;
   uint8_t widths;
   
   eb_link_t link; /* if connection is broken => EB_NULL */
   eb_transport_t transport;
+  
+  struct eb_device_flow* flow; /* 0 for passive devices */
+};
+
+/* Counters and flow control of a link; too big for the device itself */
+struct eb_device_flow {
+  struct eb_stats stats;
+  
+  /* Retransmission of idempotent cycles */
+  uint8_t retries; /* 0 = disabled */
+  uint32_t srtt;   /* smoothed round-trip time in us; 0 = not yet measured */
+  uint32_t rttvar; /* its mean deviation in us */
+  
+  /* Token buckets pacing outbound packets; a rate of 0 = unlimited.
+   * Credit is kept in millionths, so refilling is rate*us.
+   */
+  uint32_t byte_rate, packet_rate;       /* per second */
+  int64_t byte_credit, packet_credit;    /* may go negative by one packet */
+  int64_t byte_burst, packet_burst;      /* bucket depths */
+  uint32_t refilled;                     /* clock of the last refill */
+  
+  /* Congestion window on cycles awaiting a reply, in 1/256ths of a cycle */
+  uint16_t window;   /* largest allowed, in cycles; 0 = disabled */
+  uint16_t inflight; /* cycles sent and not yet answered */
+  uint32_t cwnd, ssthresh;
+  uint32_t reduced;  /* clock of the last decrease */
+  
+  /* [EB_LATENCY_CYCLE] and [EB_LATENCY_RTT]; 0 = not measured */
+  struct eb_histogram* latency;
 };
 
+/* The window starts small and grows exponentially until a loss */
+#define EB_CWND_INIT 4
+#define EB_CWND_MIN  2
+
+/* Retransmissions are counted by EB_OP_RETRIES of the first operation */
+#define EB_MAX_RETRIES 7
+
+/* Retransmission timeout bounds in microseconds */
+#define EB_RTO_MIN  1000
+#define EB_RTO_INIT 200000
+#define EB_RTO_MAX  2000000
+
+/* Push a closed cycle onto the send queue for its priority */
+EB_PRIVATE void eb_device_queue(eb_device_t device, eb_cycle_t cycle);
+
+/* Detach all queued cycles, realtime first, each class in the order queued */
+EB_PRIVATE eb_cycle_t eb_device_dequeue(eb_device_t device);
+
+/* Return unsent cycles (a list in send order) to the front of the queues */
+EB_PRIVATE void eb_device_requeue(eb_device_t device, eb_cycle_t cycle);
+
+/* Retransmission timeout for an attempt, backing off exponentially */
+EB_PRIVATE uint32_t eb_device_rto(struct eb_device_flow* flow, int attempt);
+
+/* Feed a round-trip time sample (of a cycle never retransmitted) */
+EB_PRIVATE void eb_device_rtt(struct eb_device_flow* flow, uint32_t rtt);
+
+/* Microseconds until the buckets hold enough for a packet; 0 = send now */
+EB_PRIVATE long eb_device_pace_wait(struct eb_device_flow* flow, uint32_t clock, int bytes);
+
+/* Take a sent packet from the buckets */
+EB_PRIVATE void eb_device_pace_charge(struct eb_device_flow* flow, int bytes);
+
+/* Is either token bucket limited? */
+#define eb_device_paced(flow) \
+  ((flow)->byte_rate != 0 || (flow)->packet_rate != 0)
+
+/* Can another cycle be sent that awaits a reply? */
+#define eb_device_window_open(flow) \
+  ((flow)->window == 0 || (flow)->inflight < ((flow)->cwnd >> 8))
+
+/* A cycle awaiting a reply was sent */
+EB_PRIVATE void eb_device_sent(struct eb_device_flow* flow);
+
+/* Its reply arrived: grow the window (additive increase) */
+EB_PRIVATE void eb_device_acked(struct eb_device_flow* flow);
+
+/* It timed out or must be retransmitted: halve the window, at most once
+ * for all the cycles which were sent before the last decrease.
+ */
+EB_PRIVATE void eb_device_lost(struct eb_device_flow* flow, uint32_t sent, uint32_t clock);
+
+/* Sample the latency of a completed cycle since it closed, and if it was
+ * answered, since it was sent. Only call while flow->latency != 0.
+ */
+EB_PRIVATE void eb_device_measure(struct eb_device_flow* flow, eb_operation_t first, int answered, uint32_t sent);
+
 /* Create a new slave device */
 EB_PRIVATE eb_link_t eb_device_new_slave(eb_socket_t socketp, eb_transport_t transportp, eb_link_t linkp);
 
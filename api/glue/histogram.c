@@ -0,0 +1,122 @@
+/** @file histogram.c
+ *  @brief Log-linear histograms of latencies in microseconds.
+ *
+ *  Copyright (C) 2026 GSI Helmholtz Centre for Heavy Ion Research GmbH
+ *
+ *  Bucket i of group g = i/SUB covers SUB+i%SUB shifted left by g-1;
+ *  group 0 holds the small values exactly.
+ *
+ *  @author Etherbone Core Developers <etherbone-core@ohwr.org>
+ *
+ *  @bug None!
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define ETHERBONE_IMPL
+
+#include "histogram.h"
+
+#include <string.h>
+
+static int eb_histogram_msb(uint32_t x) {
+  int msb;
+  
+  msb = 0;
+  if ((x >> 16) != 0) { x >>= 16; msb += 16; }
+  if ((x >>  8) != 0) { x >>=  8; msb +=  8; }
+  if ((x >>  4) != 0) { x >>=  4; msb +=  4; }
+  if ((x >>  2) != 0) { x >>=  2; msb +=  2; }
+  if ((x >>  1) != 0) {           msb +=  1; }
+  
+  return msb;
+}
+
+static int eb_histogram_index(uint32_t us) {
+  int shift;
+  
+  if (us < EB_HISTOGRAM_SUB) return us;
+  
+  shift = eb_histogram_msb(us) - EB_HISTOGRAM_BITS;
+  return (shift+1)*EB_HISTOGRAM_SUB + (us >> shift) - EB_HISTOGRAM_SUB;
+}
+
+/* The largest value which falls into the bucket */
+static uint32_t eb_histogram_top(int index) {
+  int group, sub;
+  
+  group = index / EB_HISTOGRAM_SUB;
+  sub = index % EB_HISTOGRAM_SUB;
+  
+  if (group == 0) return sub;
+  return ((uint32_t)(EB_HISTOGRAM_SUB + sub + 1) << (group-1)) - 1; /* wraps for the last */
+}
+
+void eb_histogram_reset(struct eb_histogram* histogram, uint32_t clock) {
+  histogram->since = clock;
+  histogram->min = 0;
+  histogram->max = 0;
+  histogram->count = 0;
+  histogram->sum = 0;
+  memset(histogram->bucket, 0, sizeof(histogram->bucket));
+}
+
+void eb_histogram_add(struct eb_histogram* histogram, uint32_t us) {
+  if (histogram->count == 0 || us < histogram->min) histogram->min = us;
+  if (us > histogram->max) histogram->max = us;
+  
+  ++histogram->count;
+  histogram->sum += us;
+  ++histogram->bucket[eb_histogram_index(us)];
+}
+
+/* The smallest bucket top below which permille/1000 of the samples fall */
+static uint32_t eb_histogram_quantile(struct eb_histogram* histogram, int permille) {
+  uint64_t rank, seen;
+  uint32_t top;
+  int i;
+  
+  rank = (histogram->count * permille + 999) / 1000;
+  if (rank == 0) rank = 1;
+  
+  seen = 0;
+  for (i = 0; i < EB_HISTOGRAM_BUCKETS; ++i) {
+    seen += histogram->bucket[i];
+    if (seen >= rank) break;
+  }
+  
+  /* The bucket may reach past the largest sample */
+  top = eb_histogram_top(i);
+  return (top > histogram->max) ? histogram->max : top;
+}
+
+void eb_histogram_summary(struct eb_histogram* histogram, struct eb_latency* latency) {
+  latency->count = histogram->count;
+  
+  if (histogram->count == 0) {
+    latency->min = latency->max = latency->mean = 0;
+    latency->p50 = latency->p90 = latency->p99 = latency->p999 = 0;
+    return;
+  }
+  
+  latency->min  = histogram->min;
+  latency->max  = histogram->max;
+  latency->mean = histogram->sum / histogram->count;
+  latency->p50  = eb_histogram_quantile(histogram, 500);
+  latency->p90  = eb_histogram_quantile(histogram, 900);
+  latency->p99  = eb_histogram_quantile(histogram, 990);
+  latency->p999 = eb_histogram_quantile(histogram, 999);
+}
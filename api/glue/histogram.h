@@ -0,0 +1,58 @@
+/** @file histogram.h
+ *  @brief Log-linear histograms of latencies in microseconds.
+ *
+ *  Copyright (C) 2026 GSI Helmholtz Centre for Heavy Ion Research GmbH
+ *
+ *  As in HdrHistogram, each power of two is split into linear buckets,
+ *  so every recorded value keeps the same relative precision. Adding a
+ *  sample is a few shifts and an increment; nothing is allocated.
+ *
+ *  @author Etherbone Core Developers <etherbone-core@ohwr.org>
+ *
+ *  @bug None!
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#ifndef EB_HISTOGRAM_H
+#define EB_HISTOGRAM_H
+
+#include "../etherbone.h"
+
+/* Values below EB_HISTOGRAM_SUB are exact; above, each power of two has
+ * EB_HISTOGRAM_SUB buckets, so a bucket is at most 1/32 (3%) of its value.
+ */
+#define EB_HISTOGRAM_BITS    5
+#define EB_HISTOGRAM_SUB     (1 << EB_HISTOGRAM_BITS)
+#define EB_HISTOGRAM_BUCKETS ((33 - EB_HISTOGRAM_BITS) * EB_HISTOGRAM_SUB)
+
+struct eb_histogram {
+  uint32_t since; /* eb_socket_clock of the last reset */
+  uint32_t min, max;
+  uint64_t count, sum;
+  uint32_t bucket[EB_HISTOGRAM_BUCKETS];
+};
+
+/* Forget all samples */
+EB_PRIVATE void eb_histogram_reset(struct eb_histogram* histogram, uint32_t clock);
+
+/* Record a sample */
+EB_PRIVATE void eb_histogram_add(struct eb_histogram* histogram, uint32_t us);
+
+/* Summarize the samples; percentiles are the top of their bucket */
+EB_PRIVATE void eb_histogram_summary(struct eb_histogram* histogram, struct eb_latency* latency);
+
+#endif
@@ -41,6 +41,10 @@ typedef uint8_t eb_operation_flags_t;
 #define EB_OP_ERROR	0x08
 #define EB_OP_CHECKED	0x10
 
+/* Times the cycle was retransmitted; kept in its first operation */
+#define EB_OP_RETRIES	0xE0
+#define EB_OP_RETRY	0x20
+
 struct eb_operation {
   eb_address_t address;
   union {
@@ -52,6 +56,8 @@ struct eb_operation {
   eb_operation_flags_t flags;
   eb_format_t format;
   eb_operation_t next;
+  
+  uint32_t queued; /* of the first: when the cycle closed, if measured */
 };
 
 EB_PRIVATE eb_operation_t eb_find_bus(eb_operation_t op);
@@ -0,0 +1,301 @@
+/** @file queue.c
+ *  @brief Cycles submitted by other threads.
+ *
+ *  Copyright (C) 2026 GSI Helmholtz Centre for Heavy Ion Research GmbH 
+ *
+ *  Only eb_queue_submit may run concurrently with the socket's thread.
+ *  It never dereferences a handle, so it is immune to the memory arrays
+ *  moving underneath it.
+ *
+ *  @author Etherbone Core Developers <etherbone-core@ohwr.org>
+ *
+ *  @bug None!
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define ETHERBONE_IMPL
+
+#include "queue.h"
+#include "socket.h"
+#include "operation.h"
+#include "../memory/memory.h"
+
+#include <stdlib.h>
+
+#ifndef __WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+static void eb_queue_ignore(eb_user_data_t user, eb_device_t device, eb_operation_t operation, eb_status_t status) {
+}
+
+eb_status_t eb_socket_queue(eb_socket_t socketp, eb_queue_t* result) {
+#ifdef __WIN32
+  *result = 0;
+  return EB_FAIL;
+#else
+  struct eb_socket* socket;
+  struct eb_socket_aux* aux;
+  struct eb_queue* queue;
+  
+  socket = EB_SOCKET(socketp);
+  aux = EB_SOCKET_AUX(socket->aux);
+  
+  if (aux->queue == 0) {
+    if ((queue = (struct eb_queue*)malloc(sizeof(struct eb_queue))) == 0) {
+      *result = 0;
+      return EB_OOM;
+    }
+    
+    if (pipe(queue->wake) != 0) {
+      free(queue);
+      *result = 0;
+      return EB_FAIL;
+    }
+    
+    fcntl(queue->wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(queue->wake[1], F_SETFL, O_NONBLOCK);
+    queue->head = 0;
+    queue->reactor = 0;
+    queue->ring = 0;
+    queue->ring_size = 0;
+    queue->ring_tail = 0;
+    queue->polled = 0;
+    queue->fill = 0;
+    
+    aux->queue = queue;
+  }
+  
+  *result = aux->queue;
+  return EB_OK;
+#endif
+}
+
+void eb_queue_submit(eb_queue_t queue, struct eb_submission* submission) {
+#ifndef __WIN32
+  struct eb_submission* head;
+  char byte;
+  
+  /* Join the group now, so eb_group_wait also waits for cycles not yet started */
+  if (submission->callback == &eb_group_done)
+    __atomic_add_fetch(&((struct eb_group*)submission->user_data)->pending, 1, __ATOMIC_RELAXED);
+  
+  head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+  do {
+    submission->next = head;
+  } while (!__atomic_compare_exchange_n(&queue->head, &head, submission, 1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+  
+  /* Only the first submission needs to wake the socket; a full pipe is awake anyway */
+  if (head == 0) {
+    byte = 0;
+    if (write(queue->wake[1], &byte, 1) < 0) { /* ignore */ }
+  }
+#endif
+}
+
+static void eb_queue_start(struct eb_submission* submission) {
+  struct eb_submit_op* op;
+  eb_callback_t callback;
+  eb_cycle_t cycle;
+  eb_status_t status;
+  int i;
+  
+  callback = submission->callback ? submission->callback : &eb_queue_ignore;
+  
+  if ((status = eb_cycle_open(submission->device, submission->user_data, callback, &cycle)) != EB_OK) {
+    (*callback)(submission->user_data, submission->device, EB_NULL, status);
+    return;
+  }
+  
+  /* eb_queue_submit already counted the cycle towards its group */
+  if (callback == &eb_group_done)
+    __atomic_sub_fetch(&((struct eb_group*)submission->user_data)->pending, 1, __ATOMIC_RELAXED);
+  
+  for (i = 0; i < submission->count; ++i) {
+    op = &submission->ops[i];
+    switch (op->flags & (EB_SUBMIT_WRITE|EB_SUBMIT_CONFIG)) {
+    case EB_SUBMIT_READ:
+      eb_cycle_read(cycle, op->address, op->format, &op->data);
+      break;
+    case EB_SUBMIT_READ|EB_SUBMIT_CONFIG:
+      eb_cycle_read_config(cycle, op->address, op->format, &op->data);
+      break;
+    case EB_SUBMIT_WRITE:
+      eb_cycle_write(cycle, op->address, op->format, op->data);
+      break;
+    case EB_SUBMIT_WRITE|EB_SUBMIT_CONFIG:
+      eb_cycle_write_config(cycle, op->address, op->format, op->data);
+      break;
+    }
+  }
+  
+  if (submission->silent) {
+    eb_cycle_close_silently(cycle);
+  } else {
+    eb_cycle_close(cycle);
+  }
+}
+
+/* Take everything submitted so far, oldest first */
+static struct eb_submission* eb_queue_take(struct eb_queue* queue) {
+  struct eb_submission* submission;
+  struct eb_submission* prev;
+  struct eb_submission* next;
+  
+#ifdef __WIN32
+  submission = 0;
+#else
+  submission = __atomic_exchange_n(&queue->head, 0, __ATOMIC_ACQUIRE);
+#endif
+  
+  /* Reverse the linked-list so it's FIFO */
+  prev = 0;
+  for (; submission != 0; submission = next) {
+    next = submission->next;
+    submission->next = prev;
+    prev = submission;
+  }
+  
+  return prev;
+}
+
+void eb_queue_drain(struct eb_queue* queue, eb_user_data_t user, eb_descriptor_callback_t ready) {
+  struct eb_submission* submission;
+  struct eb_submission* next;
+  char buf[64];
+  
+#ifndef __WIN32
+  if ((*ready)(user, queue->wake[0], EB_DESCRIPTOR_IN))
+    while (read(queue->wake[0], &buf[0], sizeof(buf)) > 0) { }
+#endif
+  
+  for (submission = eb_queue_take(queue); submission != 0; submission = next) {
+    next = submission->next; /* the callback may recycle the submission */
+    eb_queue_start(submission);
+  }
+}
+
+static void eb_queue_release(eb_operation_t first) {
+  eb_operation_t i, next;
+  
+  for (i = first; i != EB_NULL; i = next) {
+    next = EB_OPERATION(i)->next;
+    eb_free_operation(i);
+  }
+}
+
+void eb_complete(eb_user_data_t user, eb_device_t device, eb_operation_t operation, eb_status_t status) {
+  struct eb_completion done;
+  
+  /* Called directly (not via eb_cycle_finish); the operations are not ours */
+  done.user_data = user;
+  done.device = device;
+  done.operation = operation;
+  done.status = status;
+  eb_queue_complete(eb_device_socket(device), &done, EB_NULL);
+}
+
+void eb_queue_complete(eb_socket_t socketp, struct eb_completion* done, eb_operation_t first) {
+  struct eb_queue* queue;
+  struct eb_queue_completion* ring;
+  int size, used, i;
+  
+  if (eb_socket_queue(socketp, &queue) != EB_OK) {
+    eb_queue_release(first);
+    return;
+  }
+  
+  used = queue->polled + queue->fill;
+  if (used == queue->ring_size) {
+    size = queue->ring_size ? queue->ring_size*2 : 64;
+    if ((ring = (struct eb_queue_completion*)malloc(size * sizeof(struct eb_queue_completion))) == 0) {
+      /* Nowhere to put it; drop the completion rather than leak */
+      eb_queue_release(first);
+      return;
+    }
+    
+    /* Unwrap the old ring */
+    for (i = 0; i < used; ++i)
+      ring[i] = queue->ring[(queue->ring_tail + i) % queue->ring_size];
+    
+    free(queue->ring);
+    queue->ring = ring;
+    queue->ring_size = size;
+    queue->ring_tail = 0;
+  }
+  
+  /* Timestamps of the reply being parsed, if that is what completed it */
+  done->sent = EB_SOCKET(socketp)->state->sent;
+  done->received = EB_SOCKET(socketp)->state->received;
+  done->completed = eb_socket_realtime();
+  
+  i = (queue->ring_tail + used) % queue->ring_size;
+  queue->ring[i].done = *done;
+  queue->ring[i].first = first;
+  ++queue->fill;
+}
+
+int eb_socket_poll_completions(eb_socket_t socketp, struct eb_completion* out, int max) {
+  struct eb_socket* socket;
+  struct eb_socket_aux* aux;
+  struct eb_queue* queue;
+  int i, n;
+  
+  socket = EB_SOCKET(socketp);
+  aux = EB_SOCKET_AUX(socket->aux);
+  
+  if ((queue = aux->queue) == 0) return 0;
+  
+  /* Reclaim what the caller saw last time */
+  for (i = 0; i < queue->polled; ++i)
+    eb_queue_release(queue->ring[(queue->ring_tail + i) % queue->ring_size].first);
+  
+  if (queue->ring_size != 0)
+    queue->ring_tail = (queue->ring_tail + queue->polled) % queue->ring_size;
+  
+  n = queue->fill < max ? queue->fill : max;
+  for (i = 0; i < n; ++i)
+    out[i] = queue->ring[(queue->ring_tail + i) % queue->ring_size].done;
+  
+  queue->polled = n;
+  queue->fill -= n;
+  return n;
+}
+
+void eb_queue_destroy(struct eb_queue* queue) {
+  struct eb_submission* submission;
+  struct eb_submission* next;
+  int i;
+  
+  for (submission = eb_queue_take(queue); submission != 0; submission = next) {
+    next = submission->next;
+    /* eb_complete would need the (closed) device to find this socket */
+    if (submission->callback && submission->callback != &eb_complete)
+      (*submission->callback)(submission->user_data, submission->device, EB_NULL, EB_FAIL);
+  }
+  
+  for (i = 0; i < queue->polled + queue->fill; ++i)
+    eb_queue_release(queue->ring[(queue->ring_tail + i) % queue->ring_size].first);
+  
+#ifndef __WIN32
+  close(queue->wake[0]);
+  close(queue->wake[1]);
+#endif
+  free(queue->ring);
+  free(queue);
+}
@@ -0,0 +1,59 @@
+/** @file queue.h
+ *  @brief Cycles submitted by other threads.
+ *
+ *  Copyright (C) 2026 GSI Helmholtz Centre for Heavy Ion Research GmbH 
+ *
+ *  Producers push caller-owned submissions onto a lock-free stack.
+ *  The thread running the socket pops the whole stack at once,
+ *  restores FIFO order, and turns each submission into a cycle.
+ *
+ *  @author Etherbone Core Developers <etherbone-core@ohwr.org>
+ *
+ *  @bug None!
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#ifndef EB_QUEUE_H
+#define EB_QUEUE_H
+
+#include "../etherbone.h"
+
+struct eb_queue_completion {
+  struct eb_completion done;
+  eb_operation_t first; /* owned by the ring; EB_NULL if none */
+};
+
+struct eb_queue {
+  struct eb_submission* head; /* pushed atomically by any thread */
+  int wake[2]; /* pipe written when head leaves the empty state */
+  struct eb_reactor* reactor; /* 0 unless eb_socket_thread */
+  
+  /* Ring of completions: 'polled' returned last time, then 'fill' new ones */
+  struct eb_queue_completion* ring;
+  int ring_size, ring_tail, polled, fill;
+};
+
+/* Start the submitted cycles. Called by eb_socket_check. */
+EB_PRIVATE void eb_queue_drain(struct eb_queue* queue, eb_user_data_t user, eb_descriptor_callback_t ready);
+
+/* Append to the completion ring, which takes ownership of 'first' */
+EB_PRIVATE void eb_queue_complete(eb_socket_t socketp, struct eb_completion* done, eb_operation_t first);
+
+/* Fail any remaining submissions and release the queue */
+EB_PRIVATE void eb_queue_destroy(struct eb_queue* queue);
+
+#endif
@@ -30,8 +30,11 @@
 #include "readwrite.h"
 #include "socket.h"
 #include "cycle.h"
+#include "device.h"
+#include "timer.h"
 #include "operation.h"
 #include "sdb.h"
+#include "trace.h"
 #include "../memory/memory.h"
 #include "../format/bigendian.h"
 
@@ -44,9 +47,11 @@ int eb_socket_write_config(eb_socket_t socketp, eb_width_t widths, eb_address_t
   eb_cycle_t cyclep;
   eb_status_t status;
   struct eb_socket* socket;
+  struct eb_socket_state* state;
   struct eb_response* response;
   struct eb_operation* operation;
   struct eb_cycle* cycle;
+  struct eb_device* device;
   
   /* Walk the response queue */
   socket = EB_SOCKET(socketp);
@@ -59,6 +64,17 @@ int eb_socket_write_config(eb_socket_t socketp, eb_width_t widths, eb_address_t
     }
     response = EB_RESPONSE(responsep);
     
+    /* Skip expired responses, freeing those eb_socket_check is done with */
+    if (response->address == 0) {
+      *responsepp = response->next;
+      eb_free_response(responsep);
+      continue;
+    }
+    if (response->address == 1) {
+      responsepp = &response->next;
+      continue;
+    }
+    
     if (response->address == (addr & 0xFFFE)) break;
     responsepp = &response->next;
   }
@@ -115,7 +131,19 @@ int eb_socket_write_config(eb_socket_t socketp, eb_width_t widths, eb_address_t
     cyclep = response->cycle;
     cycle = EB_CYCLE(cyclep);
 
+    state = socket->state; /* not in the array; never moves */
     *responsepp = response->next;
+    eb_timer_disarm(state->timers, responsep);
+    
+    /* Only a cycle sent exactly once gives a clean round-trip time (Karn) */
+    device = EB_DEVICE(cycle->un_link.device);
+    if (device->flow != 0) {
+      if (device->flow->retries != 0 && (EB_OPERATION(cycle->un_ops.first)->flags & EB_OP_RETRIES) == 0)
+        eb_device_rtt(device->flow, eb_socket_clock() - response->sent);
+      eb_device_acked(device->flow);
+      if (device->flow->latency != 0)
+        eb_device_measure(device->flow, cycle->un_ops.first, 1, response->sent);
+    }
     
     /* Detect segfault */
     status = EB_OK;
@@ -124,10 +152,14 @@ int eb_socket_write_config(eb_socket_t socketp, eb_width_t widths, eb_address_t
       if ((operation->flags & EB_OP_ERROR) != 0) status = EB_SEGFAULT;
     }
     
-    (*cycle->callback)(cycle->user_data, cycle->un_link.device, cycle->un_ops.first, fail?EB_FAIL:status);
-
-    eb_cycle_destroy(cyclep);
-    eb_free_cycle(cyclep);
+    eb_trace(EB_TRACE_REPLY, EB_TRACE_HANDLE(cycle->un_link.device), EB_TRACE_HANDLE(cyclep), eb_socket_clock() - response->sent);
+    
+    /* Report when the request left and the reply arrived, on the kernel clock */
+    state->sent = eb_socket_realtime() - (uint64_t)(uint32_t)(eb_socket_clock() - response->sent)*1000;
+    state->received = state->rx_stamp;
+    eb_cycle_finish(cyclep, cycle->un_ops.first, fail?EB_FAIL:status); /* invalidates socket */
+    state->sent = 0;
+    state->received = 0;
     eb_free_response(responsep);
     return 1;
   } else {
@@ -170,6 +202,7 @@ void eb_socket_write(eb_socket_t socketp, eb_width_t widths, eb_address_t addr_b
   
   /* Update the error shift status */
   *error = (*error << 1) | fail;
+  if (fail) ++EB_SOCKET(socketp)->state->stats.handler_misses;
 }
 
 eb_data_t eb_socket_read_config(eb_socket_t socketp, eb_width_t widths, eb_address_t addr, uint64_t error) {
@@ -266,5 +299,6 @@ eb_data_t eb_socket_read(eb_socket_t socketp, eb_width_t widths, eb_address_t ad
   
   /* Update the error shift status */
   *error = (*error << 1) | fail;
+  if (fail) ++EB_SOCKET(socketp)->state->stats.handler_misses;
   return out;
 }
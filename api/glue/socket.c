@@ -32,10 +32,18 @@
 #include "socket.h"
 #include "device.h"
 #include "cycle.h"
+#include "timer.h"
+#include "operation.h"
 #include "widths.h"
 #include "../transport/transport.h"
 #include "../memory/memory.h"
 #include "../format/format.h"
+#include "queue.h"
+#include "trace.h"
+#include "capture.h"
+
+#include <stdlib.h>
+#include <string.h>
 
 #ifdef __WIN32
 #include <winsock2.h>
@@ -48,6 +56,7 @@ eb_status_t eb_socket_open(uint16_t abi_code, const char* port, eb_width_t suppo
   struct eb_transport* transport;
   struct eb_socket* socket;
   struct eb_socket_aux* aux;
+  struct eb_socket_state* state;
   eb_status_t status;
   uint8_t link_type;
 #ifdef  __WIN32
@@ -85,12 +94,34 @@ eb_status_t eb_socket_open(uint16_t abi_code, const char* port, eb_width_t suppo
     eb_free_socket(socketp);
     return EB_OOM;
   }
+  state = (struct eb_socket_state*)malloc(sizeof(struct eb_socket_state));
+  if (state == 0) {
+    *result = EB_NULL;
+    eb_free_socket(socketp);
+    eb_free_socket_aux(auxp);
+    return EB_OOM;
+  }
+  state->timers = eb_timer_new(eb_socket_clock());
+  if (state->timers == 0) {
+    *result = EB_NULL;
+    free(state);
+    eb_free_socket(socketp);
+    eb_free_socket_aux(auxp);
+    return EB_OOM;
+  }
+  memset(&state->stats, 0, sizeof(state->stats));
+  state->capture = 0;
+  state->rx_stamp = 0;
+  state->sent = 0;
+  state->received = 0;
   
 #ifdef __WIN32
   wVersionRequested = MAKEWORD(2, 2);
   if (WSAStartup(wVersionRequested, &wsaData) != 0) {
     eb_free_socket(socketp);
     eb_free_socket_aux(auxp);
+    eb_timer_free(state->timers);
+    free(state);
     return EB_FAIL;
   }
 #endif
@@ -136,12 +167,14 @@ eb_status_t eb_socket_open(uint16_t abi_code, const char* port, eb_width_t suppo
   socket->last_response = EB_NULL;
   socket->widths = supported_widths;
   socket->aux = auxp;
+  socket->state = state;
   
   aux = EB_SOCKET_AUX(auxp);
   aux->time_cache = 0;
   aux->rba = 0x8000;
   aux->first_transport = first_transport;
   aux->sdb_offset = 0;
+  aux->queue = 0;
   
   if (link_type != eb_transport_size) {
     eb_socket_close(socketp);
@@ -150,6 +183,7 @@ eb_status_t eb_socket_open(uint16_t abi_code, const char* port, eb_width_t suppo
   
   /* Update time_cache */
   eb_socket_run(socketp, 0);
+  eb_trace_open();
   
   *result = socketp;
   return status;
@@ -209,6 +243,14 @@ eb_status_t eb_socket_close(eb_socket_t socketp) {
   auxp = socket->aux;
   aux = EB_SOCKET_AUX(auxp);
   
+  /* Callbacks of leftover submissions may move the aux */
+  if (aux->queue != 0) {
+    eb_socket_join(aux->queue);
+    eb_queue_destroy(aux->queue);
+    aux = EB_SOCKET_AUX(auxp);
+    aux->queue = 0;
+  }
+  
   for (transportp = aux->first_transport; transportp != EB_NULL; transportp = next_transportp) {
     transport = EB_TRANSPORT(transportp);
     next_transportp = transport->next;
@@ -220,20 +262,25 @@ eb_status_t eb_socket_close(eb_socket_t socketp) {
   WSACleanup();
 #endif
 
+  socket = EB_SOCKET(socketp);
+  if (socket->state->capture != 0) fclose(socket->state->capture);
+  eb_timer_free(socket->state->timers);
+  free(socket->state);
   eb_free_socket(socketp);
   eb_free_socket_aux(auxp);
   return EB_OK;
 }
 
-static void eb_socket_filter_inflight(eb_response_t* goodp, eb_response_t* badp, eb_device_t devicep, eb_response_t firstp) {
+static void eb_socket_filter_inflight(eb_response_t* goodp, eb_response_t* badp, eb_cycle_t* expiredp, eb_device_t devicep, eb_response_t firstp) {
   struct eb_response* response;
   struct eb_cycle* cycle;
   eb_response_t good, bad;
   eb_response_t responsep, next_responsep;
-  eb_cycle_t cyclep;
+  eb_cycle_t cyclep, expired;
   
   good = *goodp;
   bad = *badp;
+  expired = *expiredp;
   
   /* Partiton the list */
   for (responsep = firstp; responsep != EB_NULL; responsep = next_responsep) {
@@ -241,6 +288,25 @@ static void eb_socket_filter_inflight(eb_response_t* goodp, eb_response_t* badp,
     next_responsep = response->next;
     
     cyclep = response->cycle;
+    
+    /* Expired responses are freed once eb_socket_check is done with them */
+    if (response->address == 0) {
+      eb_free_response(responsep);
+      continue;
+    }
+    
+    /* eb_socket_check still holds this one, so only take away its cycle */
+    if (response->address == 1) {
+      if (cyclep != EB_NULL && EB_CYCLE(cyclep)->un_link.device == devicep) {
+        response->cycle = EB_NULL;
+        EB_CYCLE(cyclep)->un_link.next = expired;
+        expired = cyclep;
+      }
+      response->next = good;
+      good = responsep;
+      continue;
+    }
+    
     cycle = EB_CYCLE(cyclep);
    
     if (cycle->un_link.device == devicep) {
@@ -254,22 +320,26 @@ static void eb_socket_filter_inflight(eb_response_t* goodp, eb_response_t* badp,
   
   *goodp = good;
   *badp = bad;
+  *expiredp = expired;
 }
 
 void eb_socket_kill_inflight(eb_socket_t socketp, eb_device_t devicep) {
   struct eb_socket* socket;
   struct eb_response* response;
   struct eb_cycle* cycle;
+  struct eb_timer_wheel* timers;
   eb_response_t responsep, next_responsep;
   eb_response_t good, bad;
-  eb_cycle_t cyclep;
+  eb_cycle_t cyclep, next_cyclep, expired;
   
   /* Split the list into good responses we keep, and bad responses we kill */
   good = EB_NULL;
   bad = EB_NULL;
+  expired = EB_NULL;
   socket = EB_SOCKET(socketp);
-  eb_socket_filter_inflight(&good, &bad, devicep, socket->last_response);
-  eb_socket_filter_inflight(&good, &bad, devicep, eb_response_flip(socket->first_response));
+  timers = socket->state->timers;
+  eb_socket_filter_inflight(&good, &bad, &expired, devicep, socket->last_response);
+  eb_socket_filter_inflight(&good, &bad, &expired, devicep, eb_response_flip(socket->first_response));
   socket->first_response = good;
   socket->last_response = EB_NULL;
   
@@ -283,15 +353,21 @@ void eb_socket_kill_inflight(eb_socket_t socketp, eb_device_t devicep) {
     
     /* Mark the response for clean-up */
     response->cycle = EB_NULL;
+    eb_timer_disarm(timers, responsep);
     
-    /* Run the callback */
-    (*cycle->callback)(cycle->user_data, cycle->un_link.device, cycle->un_ops.first, EB_TIMEOUT);
-      
-    /* Free it all */
-    eb_cycle_destroy(cyclep);
-    eb_free_cycle(cyclep);
+    /* Run the callback and free it all */
+    eb_cycle_finish(cyclep, cycle->un_ops.first, EB_TIMEOUT);
     eb_free_response(responsep);
   }
+  
+  /* Fail the cycles of expired responses eb_socket_check has yet to reach */
+  for (cyclep = expired; cyclep != EB_NULL; cyclep = next_cyclep) {
+    cycle = EB_CYCLE(cyclep);
+    next_cyclep = cycle->un_link.next;
+    
+    cycle->un_link.device = devicep;
+    eb_cycle_finish(cyclep, cycle->un_ops.first, EB_TIMEOUT);
+  }
 }
 
 void eb_socket_descriptors(eb_socket_t socketp, eb_user_data_t user, eb_descriptor_callback_t cb) {
@@ -310,6 +386,10 @@ void eb_socket_descriptors(eb_socket_t socketp, eb_user_data_t user, eb_descript
   first_devicep = socket->first_device;
   first_transportp = aux->first_transport;
   
+  /* Wake up for cycles submitted by other threads */
+  if (aux->queue != 0)
+    (*cb)(user, aux->queue->wake[0], EB_DESCRIPTOR_IN);
+  
   /* Add all the transports */
   for (transportp = first_transportp; transportp != EB_NULL; transportp = next_transportp) {
     transport = EB_TRANSPORT(transportp);
@@ -336,32 +416,189 @@ void eb_socket_descriptors(eb_socket_t socketp, eb_user_data_t user, eb_descript
   }
 }
 
+long eb_socket_timeout_us(eb_socket_t socketp) {
+  struct eb_socket* socket;
+  struct eb_device* device;
+  eb_device_t devicep;
+  uint32_t clock;
+  long next, wait;
+  
+  socket = EB_SOCKET(socketp);
+  clock = eb_socket_clock();
+  next = eb_timer_next(socket->state->timers, clock);
+  
+  /* Wake up when paced devices may send their queued cycles */
+  for (devicep = socket->first_device; devicep != EB_NULL; devicep = device->next) {
+    device = EB_DEVICE(devicep);
+    if (device->flow == 0 || device->un_link.passive == devicep) continue;
+    if (!eb_device_paced(device->flow)) continue;
+    if (device->un_link.ready == EB_NULL && device->urgent == EB_NULL) continue;
+    if (!eb_device_window_open(device->flow)) continue; /* a reply or timeout reopens it */
+    
+    wait = eb_device_pace_wait(device->flow, clock, 0);
+    if (next < 0 || wait < next) next = wait;
+  }
+  
+  return next;
+}
+
+void eb_socket_stats(eb_socket_t socketp, struct eb_stats* stats) {
+  struct eb_socket* socket;
+  
+  socket = EB_SOCKET(socketp);
+  *stats = socket->state->stats;
+}
+
+eb_status_t eb_socket_capture(eb_socket_t socketp, const char* filename) {
+  struct eb_socket* socket;
+  struct eb_socket_state* state;
+  eb_status_t status;
+  FILE* file;
+  
+  socket = EB_SOCKET(socketp);
+  state = socket->state;
+  status = EB_OK;
+  
+  /* Finish the previous capture */
+  if (state->capture != 0) {
+    if (ferror(state->capture)) status = EB_FAIL;
+    if (fclose(state->capture) != 0) status = EB_FAIL;
+    state->capture = 0;
+  }
+  
+  if (filename == 0) return status;
+  
+  if ((file = fopen(filename, "wb")) == 0) return EB_FAIL;
+  if (eb_capture_open(file) != 0) {
+    fclose(file);
+    return EB_FAIL;
+  }
+  
+  state->capture = file;
+  return status;
+}
+
 uint32_t eb_socket_timeout(eb_socket_t socketp) {
   struct eb_socket* socket;
   struct eb_socket_aux* aux;
-  struct eb_response* response;
-  uint16_t udelta;
-  int16_t sdelta;
+  long remaining;
+  
+  remaining = eb_socket_timeout_us(socketp);
+  if (remaining < 0) return 0;
   
   socket = EB_SOCKET(socketp);
   aux = EB_SOCKET_AUX(socket->aux);
   
-  /* Find the first timeout */
-  if (socket->first_response == EB_NULL) {
-    socket->first_response = eb_response_flip(socket->last_response);
-    socket->last_response = EB_NULL;
-  }
+  /* Round up, so a seconds-based loop never wakes too early to expire it */
+  return aux->time_cache + (remaining + 999999) / 1000000;
+}
+
+/* Free the expired responses at the front of the queue awaiting replies */
+static void eb_socket_reap(struct eb_socket* socket) {
+  struct eb_response* response;
+  eb_response_t responsep;
   
-  /* Determine how long until deadline expires */ 
-  if (socket->first_response != EB_NULL) {
-    response = EB_RESPONSE(socket->first_response);
+  while (1) {
+    if ((responsep = socket->first_response) == EB_NULL) {
+      if (socket->last_response == EB_NULL) return;
+      socket->first_response = responsep = eb_response_flip(socket->last_response);
+      socket->last_response = EB_NULL;
+    }
+    
+    response = EB_RESPONSE(responsep);
+    if (response->address != 0) return;
     
-    udelta = response->deadline - ((uint16_t)aux->time_cache);
-    sdelta = udelta; /* Sign conversion */
-    return aux->time_cache + sdelta;
-  } else {
+    socket->first_response = response->next;
+    eb_free_response(responsep);
+  }
+}
+
+/* Requeue a cycle whose retransmission timeout expired; 0 if it is out of time */
+static int eb_socket_retransmit(eb_cycle_t cyclep, uint32_t sent, uint32_t clock) {
+  struct eb_cycle* cycle;
+  struct eb_device* device;
+  struct eb_operation* first;
+  struct eb_operation* operation;
+  eb_operation_t operationp;
+  eb_device_t devicep;
+  uint32_t timeout;
+  int32_t remaining;
+  
+  cycle = EB_CYCLE(cyclep);
+  devicep = cycle->un_link.device;
+  device = EB_DEVICE(devicep);
+  
+  timeout = cycle->timeout;
+  if (timeout == 0) timeout = EB_TIMER_DEFAULT;
+  
+  /* The whole cycle timed out, or the device is going away */
+  remaining = sent + timeout - clock;
+  if (remaining <= 0 || device->link == EB_NULL || device->un_link.passive == devicep)
     return 0;
+  
+  /* Forget error bits shifted in by a partial reply to the lost transmission */
+  for (operationp = cycle->un_ops.first; operationp != EB_NULL; operationp = operation->next) {
+    operation = EB_OPERATION(operationp);
+    operation->flags &= ~EB_OP_ERROR;
+  }
+  
+  /* Count the attempt and carry over what is left of the timeout */
+  first = EB_OPERATION(cycle->un_ops.first);
+  first->flags += EB_OP_RETRY;
+  cycle->timeout = remaining;
+  
+  /* The response address is retired with the response, so a late reply
+   * to the previous transmission matches nothing and is ignored.
+   * The cycle was sent before anything still queued, so it goes underneath.
+   */
+  cycle->un_link.next = EB_NULL;
+  eb_device_requeue(devicep, cyclep);
+  
+  return 1;
+}
+
+/* Response addresses are handed out in sending order; 1 if a was sent after b */
+static int eb_socket_newer(struct eb_response* a, struct eb_response* b) {
+  return ((a->address - b->address) & 0x7FFE) < 0x4000;
+}
+
+/* Sort the expired responses newest first, so retransmits requeue in order */
+static eb_response_t eb_socket_sort_expired(eb_response_t list) {
+  struct eb_response* response;
+  struct eb_response* other;
+  eb_response_t half, tail, *tailp;
+  eb_response_t responsep;
+  
+  /* Split the list in two halves by alternating elements */
+  half = tail = EB_NULL;
+  for (responsep = list; responsep != EB_NULL; responsep = list) {
+    response = EB_RESPONSE(responsep);
+    list = response->timer_next;
+    response->timer_next = half;
+    half = tail;
+    tail = responsep;
   }
+  
+  if (half == EB_NULL) return tail;
+  half = eb_socket_sort_expired(half);
+  tail = eb_socket_sort_expired(tail);
+  
+  /* Merge the sorted halves */
+  for (tailp = &list; half != EB_NULL && tail != EB_NULL; tailp = &response->timer_next) {
+    response = EB_RESPONSE(half);
+    other = EB_RESPONSE(tail);
+    if (eb_socket_newer(other, response)) {
+      *tailp = tail;
+      response = other;
+      tail = response->timer_next;
+    } else {
+      *tailp = half;
+      half = response->timer_next;
+    }
+  }
+  *tailp = (half != EB_NULL) ? half : tail;
+  
+  return list;
 }
 
 int eb_socket_check(eb_socket_t socketp, uint32_t now, eb_user_data_t user, eb_descriptor_callback_t ready) {
@@ -374,36 +611,70 @@ int eb_socket_check(eb_socket_t socketp, uint32_t now, eb_user_data_t user, eb_d
   eb_device_t devicep, next_devicep;
   eb_transport_t transportp, next_transportp;
   eb_link_t new_linkp;
-  eb_response_t responsep;
+  eb_response_t responsep, expired;
   eb_cycle_t cyclep;
   eb_socket_aux_t auxp;
+  struct eb_stats* stats;
+  uint32_t clock;
   int completed;
   
   socket = EB_SOCKET(socketp);
   auxp = socket->aux;
+  stats = &socket->state->stats; /* not in the array; never moves */
   completed = 0;
   
   /* Step 1. Kill any expired timeouts */
-  while (socket->first_response != EB_NULL &&
-         eb_socket_timeout(socketp) <= now) {
-    /* Kill first */
-    responsep = socket->first_response;
+  clock = eb_socket_clock();
+  expired = eb_socket_sort_expired(eb_timer_expire(socket->state->timers, clock));
+  
+  /* Retire them all before any callback can close their device.
+   * They stay queued, and are freed once matching walks past them.
+   * Closing a device fails their cycles itself and clears them here.
+   */
+  for (responsep = expired; responsep != EB_NULL; responsep = response->timer_next) {
+    response = EB_RESPONSE(responsep);
+    response->address = 1;
+  }
+  
+  while (expired != EB_NULL) {
+    responsep = expired;
     response = EB_RESPONSE(responsep);
+    expired = response->timer_next;
     
     cyclep = response->cycle;
+    response->cycle = EB_NULL;
+    response->address = 0;
+    if (cyclep == EB_NULL) continue;
+    
     cycle = EB_CYCLE(cyclep);
     
-    socket->first_response = response->next;
+    /* Either way the device missed its deadline */
+    device = EB_DEVICE(cycle->un_link.device);
+    if (device->flow != 0)
+      eb_device_lost(device->flow, response->sent, clock);
+    
+    if (eb_socket_retransmit(cyclep, response->sent, clock)) {
+      ++stats->retransmits;
+      if (device->flow != 0) ++device->flow->stats.retransmits;
+      continue;
+    }
+    
+    ++stats->timeouts;
+    if (device->flow != 0) {
+      ++device->flow->stats.timeouts;
+      if (device->flow->latency != 0)
+        eb_device_measure(device->flow, cycle->un_ops.first, 0, 0);
+    }
     
-    (*cycle->callback)(cycle->user_data, cycle->un_link.device, cycle->un_ops.first, EB_TIMEOUT);
-    socket = EB_SOCKET(socketp); /* Restore pointer */
+    eb_trace(EB_TRACE_EXPIRE, EB_TRACE_HANDLE(cycle->un_link.device), EB_TRACE_HANDLE(cyclep), 0);
+    eb_cycle_finish(cyclep, cycle->un_ops.first, EB_TIMEOUT);
     
     ++completed;
-    eb_cycle_destroy(cyclep);
-    eb_free_cycle(cyclep);
-    eb_free_response(responsep);
   }
   
+  socket = EB_SOCKET(socketp); /* Restore pointer */
+  eb_socket_reap(socket);
+  
   /* Get some memory for accepting connections */
   new_linkp = eb_new_link();
   
@@ -431,6 +702,11 @@ int eb_socket_check(eb_socket_t socketp, uint32_t now, eb_user_data_t user, eb_d
     }
   }
   
+  /* Start cycles submitted by other threads; flushed below */
+  aux = EB_SOCKET_AUX(auxp);
+  if (aux->queue != 0)
+    eb_queue_drain(aux->queue, user, ready);
+  
   /* Poll all the connections */
   socket = EB_SOCKET(socketp);
   for (devicep = socket->first_device; devicep != EB_NULL; devicep = next_devicep) {
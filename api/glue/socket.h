@@ -30,6 +30,8 @@
 #ifndef EB_SOCKET_H
 #define EB_SOCKET_H
 
+#include <stdio.h>
+
 #include "../etherbone.h"
 #include "../transport/transport.h"
 #include "handler.h"
@@ -42,15 +44,23 @@ struct eb_response {
   /* xxxxxxxxxxxxxxxL
    * L=0 means read-back
    * L=1 means status-back
+   * 1 once expired, while eb_socket_check works through it
+   * 0 when it is done; it stays queued until matching walks past it
    */
   uint16_t address;
-  uint16_t deadline; /* Low 16-bits of a UTC seconds counter */
+  uint8_t timer_slot;
+  uint32_t deadline; /* Low 32-bits of eb_socket_clock */
+  uint32_t sent;     /* eb_socket_clock when the cycle was sent */
   
   eb_response_t next;
   eb_cycle_t cycle;
   
   eb_operation_t write_cursor;
   eb_operation_t status_cursor;
+  
+  /* Chain in a slot of the timer wheel */
+  eb_response_t timer_next;
+  eb_response_t timer_prev;
 };
 
 typedef EB_POINTER(eb_socket_aux) eb_socket_aux_t;
@@ -60,6 +70,7 @@ struct eb_socket_aux {
   uint16_t rba;
   
   eb_transport_t first_transport;
+  struct eb_queue* queue; /* 0 until eb_socket_queue */
 };
 
 struct eb_socket {
@@ -72,6 +83,19 @@ struct eb_socket {
   
   eb_socket_aux_t aux;
   uint8_t widths;
+  
+  struct eb_socket_state* state;
+};
+
+struct eb_timer_wheel;
+
+/* Counters and timers of a socket; too big for the socket itself */
+struct eb_socket_state {
+  struct eb_stats stats;
+  struct eb_timer_wheel* timers; /* deadlines of the responses */
+  FILE* capture; /* see eb_socket_capture; 0 if not recording */
+  uint64_t rx_stamp; /* kernel receive time of the packet being parsed; 0 if unknown */
+  uint64_t sent, received; /* of the cycle being completed; see eb_completion */
 };
 
 /* Invert last_response, suitable for attaching to the end of first_response */
@@ -80,4 +104,23 @@ EB_PRIVATE eb_response_t eb_response_flip(eb_response_t firstp);
 /* Kill all responses inflight for this device */
 EB_PRIVATE void eb_socket_kill_inflight(eb_socket_t socketp, eb_device_t devicep);
 
+/* A thread blocked on the outcome of one eb_block cycle */
+struct eb_block_wait {
+  eb_status_t status; /* positive until the cycle completes */
+  void* cond;         /* wakes the thread if a reactor runs the socket */
+};
+
+/* These are implemented by the event loop (transport/run.c).
+ * eb_socket_block sleeps until *busy <= 0; set *busy, then unblock *cond.
+ */
+EB_PRIVATE void eb_socket_block(eb_socket_t socketp, int* busy, void** cond);
+EB_PRIVATE void eb_socket_unblock(void* cond);
+EB_PRIVATE void eb_socket_join(struct eb_queue* queue);
+
+/* Microseconds on a monotonic clock; wraps around every 71 minutes */
+EB_PRIVATE uint32_t eb_socket_clock(void);
+
+/* Nanoseconds since the epoch, comparable to the kernel receive timestamps */
+EB_PRIVATE uint64_t eb_socket_realtime(void);
+
 #endif
@@ -0,0 +1,227 @@
+/** @file timer.c
+ *  @brief A hierarchical timer wheel for response deadlines.
+ *
+ *  Copyright (C) 2026 GSI Helmholtz Centre for Heavy Ion Research GmbH
+ *
+ *  Responses are placed on the level whose reach covers their deadline.
+ *  Level 0 slots hold the responses due within that tick; the exact
+ *  microsecond deadline is only compared when the slot is visited.
+ *
+ *  @author Etherbone Core Developers <etherbone-core@ohwr.org>
+ *
+ *  @bug None!
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define ETHERBONE_IMPL
+
+#include "timer.h"
+#include "../memory/memory.h"
+
+#include <stdlib.h>
+
+struct eb_timer_wheel* eb_timer_new(uint32_t clock) {
+  struct eb_timer_wheel* wheel;
+  int i;
+
+  if ((wheel = (struct eb_timer_wheel*)malloc(sizeof(struct eb_timer_wheel))) == 0)
+    return 0;
+
+  wheel->now = (clock >> EB_TIMER_TICK) & EB_TIMER_MASK;
+  wheel->armed = 0;
+  for (i = 0; i < EB_TIMER_LEVELS*EB_TIMER_SLOTS; ++i)
+    wheel->slot[i] = EB_NULL;
+
+  return wheel;
+}
+
+void eb_timer_free(struct eb_timer_wheel* wheel) {
+  free(wheel);
+}
+
+/* Push the response onto the slot matching its deadline */
+static void eb_timer_link(struct eb_timer_wheel* wheel, eb_response_t responsep) {
+  struct eb_response* response;
+  eb_response_t headp;
+  uint32_t tick, delta;
+  int level, slot;
+
+  response = EB_RESPONSE(responsep);
+  tick = (response->deadline >> EB_TIMER_TICK) & EB_TIMER_MASK;
+  delta = (tick - wheel->now) & EB_TIMER_MASK;
+
+  /* Overdue responses wait in the slot being examined */
+  if (delta > (EB_TIMER_MASK >> 1)) {
+    tick = wheel->now;
+    delta = 0;
+  }
+
+  for (level = 0; level < EB_TIMER_LEVELS-1; ++level)
+    if ((delta >> ((level+1)*EB_TIMER_BITS)) == 0) break;
+
+  slot = level*EB_TIMER_SLOTS + ((tick >> (level*EB_TIMER_BITS)) & (EB_TIMER_SLOTS-1));
+  headp = wheel->slot[slot];
+
+  response->timer_slot = slot;
+  response->timer_prev = EB_NULL;
+  response->timer_next = headp;
+
+  if (headp != EB_NULL)
+    EB_RESPONSE(headp)->timer_prev = responsep;
+
+  wheel->slot[slot] = responsep;
+}
+
+void eb_timer_arm(struct eb_timer_wheel* wheel, eb_response_t responsep) {
+  eb_timer_link(wheel, responsep);
+  ++wheel->armed;
+}
+
+void eb_timer_disarm(struct eb_timer_wheel* wheel, eb_response_t responsep) {
+  struct eb_response* response;
+  eb_response_t prevp, nextp;
+
+  response = EB_RESPONSE(responsep);
+  prevp = response->timer_prev;
+  nextp = response->timer_next;
+
+  if (prevp == EB_NULL)
+    wheel->slot[response->timer_slot] = nextp;
+  else
+    EB_RESPONSE(prevp)->timer_next = nextp;
+
+  if (nextp != EB_NULL)
+    EB_RESPONSE(nextp)->timer_prev = prevp;
+
+  --wheel->armed;
+}
+
+/* The low bits of now just wrapped; move the coarser slots down */
+static void eb_timer_cascade(struct eb_timer_wheel* wheel) {
+  struct eb_response* response;
+  eb_response_t responsep, nextp;
+  int level, index;
+
+  for (level = 1; level < EB_TIMER_LEVELS; ++level) {
+    index = (wheel->now >> (level*EB_TIMER_BITS)) & (EB_TIMER_SLOTS-1);
+
+    responsep = wheel->slot[level*EB_TIMER_SLOTS + index];
+    wheel->slot[level*EB_TIMER_SLOTS + index] = EB_NULL;
+
+    for (; responsep != EB_NULL; responsep = nextp) {
+      response = EB_RESPONSE(responsep);
+      nextp = response->timer_next;
+      eb_timer_link(wheel, responsep);
+    }
+
+    if (index != 0) break;
+  }
+}
+
+eb_response_t eb_timer_expire(struct eb_timer_wheel* wheel, uint32_t clock) {
+  struct eb_response* response;
+  eb_response_t responsep, nextp, expired;
+  uint32_t target;
+  int index;
+
+  target = (clock >> EB_TIMER_TICK) & EB_TIMER_MASK;
+  expired = EB_NULL;
+
+  /* Never run backwards */
+  if (((target - wheel->now) & EB_TIMER_MASK) > (EB_TIMER_MASK >> 1))
+    target = wheel->now;
+
+  while (wheel->armed != 0) {
+    index = wheel->now & (EB_TIMER_SLOTS-1);
+    responsep = wheel->slot[index];
+    wheel->slot[index] = EB_NULL;
+
+    for (; responsep != EB_NULL; responsep = nextp) {
+      response = EB_RESPONSE(responsep);
+      nextp = response->timer_next;
+
+      if ((int32_t)(response->deadline - clock) <= 0) {
+        response->timer_next = expired;
+        expired = responsep;
+        --wheel->armed;
+      } else {
+        /* Due later within this tick */
+        eb_timer_link(wheel, responsep);
+      }
+    }
+
+    if (wheel->now == target) break;
+
+    wheel->now = (wheel->now + 1) & EB_TIMER_MASK;
+    if ((wheel->now & (EB_TIMER_SLOTS-1)) == 0)
+      eb_timer_cascade(wheel);
+  }
+
+  /* Nothing left to cascade, so skip ahead */
+  if (wheel->armed == 0)
+    wheel->now = target;
+
+  return expired;
+}
+
+long eb_timer_next(struct eb_timer_wheel* wheel, uint32_t clock) {
+  struct eb_response* response;
+  eb_response_t responsep;
+  uint32_t tick, best;
+  int32_t delta;
+  int level, shift, found, i;
+
+  if (wheel->armed == 0) return -1;
+
+  found = 0;
+  best = 0;
+
+  /* Level 0 knows the exact deadlines */
+  for (i = 0; i < EB_TIMER_SLOTS; ++i) {
+    responsep = wheel->slot[(wheel->now + i) & (EB_TIMER_SLOTS-1)];
+    if (responsep == EB_NULL) continue;
+
+    for (; responsep != EB_NULL; responsep = response->timer_next) {
+      response = EB_RESPONSE(responsep);
+      if (!found || (int32_t)(response->deadline - best) < 0)
+        best = response->deadline;
+      found = 1;
+    }
+    break;
+  }
+
+  /* Due before the next cascade? Then nothing on a coarser level is sooner */
+  if (!found || (wheel->now & (EB_TIMER_SLOTS-1)) + i >= EB_TIMER_SLOTS) {
+    /* The coarser levels are only known to the start of their slot */
+    for (level = 1; level < EB_TIMER_LEVELS; ++level) {
+      shift = level*EB_TIMER_BITS;
+      for (i = 1; i <= EB_TIMER_SLOTS; ++i) {
+        tick = (wheel->now >> shift) + i;
+        if (wheel->slot[level*EB_TIMER_SLOTS + (tick & (EB_TIMER_SLOTS-1))] != EB_NULL) break;
+      }
+      if (i > EB_TIMER_SLOTS) continue;
+
+      tick = (tick << shift) << EB_TIMER_TICK; /* wraps like the clock */
+      if (!found || (int32_t)(tick - best) < 0)
+        best = tick;
+      found = 1;
+    }
+  }
+
+  delta = best - clock;
+  return (delta < 0) ? 0 : delta;
+}
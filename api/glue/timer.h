@@ -0,0 +1,73 @@
+/** @file timer.h
+ *  @brief A hierarchical timer wheel for response deadlines.
+ *
+ *  Copyright (C) 2026 GSI Helmholtz Centre for Heavy Ion Research GmbH
+ *
+ *  Every response waiting for its device is armed on the wheel.
+ *  Arming and disarming are O(1); expiry walks one slot per tick and
+ *  cascades the coarser levels down as their time approaches.
+ *
+ *  @author Etherbone Core Developers <etherbone-core@ohwr.org>
+ *
+ *  @bug None!
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#ifndef EB_TIMER_H
+#define EB_TIMER_H
+
+#include "socket.h"
+
+/* A tick is 2^EB_TIMER_TICK microseconds (256us).
+ * The 24-bit tick counter is split into four levels of 64 slots each:
+ * 16ms, 1s, 67s and 71 minutes of reach respectively.
+ */
+#define EB_TIMER_TICK   8
+#define EB_TIMER_BITS   6
+#define EB_TIMER_SLOTS  (1 << EB_TIMER_BITS)
+#define EB_TIMER_LEVELS 4
+#define EB_TIMER_MASK   0xFFFFFFUL
+
+/* Deadlines are compared as signed 32-bit microsecond differences.
+ * The limit is lower still, to fit the timeout field of a cycle.
+ */
+#define EB_TIMER_MAX     0x3FFFFFFFUL
+#define EB_TIMER_DEFAULT 5000000UL /* used for cycles without eb_cycle_timeout */
+
+struct eb_timer_wheel {
+  uint32_t now; /* the tick whose slot is examined next */
+  uint32_t armed;
+  eb_response_t slot[EB_TIMER_LEVELS*EB_TIMER_SLOTS];
+};
+
+/* Allocate a wheel starting at the given clock; 0 if out of memory */
+EB_PRIVATE struct eb_timer_wheel* eb_timer_new(uint32_t clock);
+EB_PRIVATE void eb_timer_free(struct eb_timer_wheel* wheel);
+
+/* Arm/disarm response->deadline. Does not allocate. */
+EB_PRIVATE void eb_timer_arm(struct eb_timer_wheel* wheel, eb_response_t response);
+EB_PRIVATE void eb_timer_disarm(struct eb_timer_wheel* wheel, eb_response_t response);
+
+/* Disarm all responses due by clock, returned as a list linked by timer_next */
+EB_PRIVATE eb_response_t eb_timer_expire(struct eb_timer_wheel* wheel, uint32_t clock);
+
+/* Microseconds until something might expire; -1 if nothing is armed.
+ * The result may be early (a cascade is due), but is never late.
+ */
+EB_PRIVATE long eb_timer_next(struct eb_timer_wheel* wheel, uint32_t clock);
+
+#endif
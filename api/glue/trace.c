@@ -0,0 +1,126 @@
+/** @file trace.c
+ *  @brief Optional tracepoints recorded into a shared-memory ring.
+ *
+ *  Copyright (C) 2026 GSI Helmholtz Centre for Heavy Ion Research GmbH
+ *
+ *  Writers claim a slot with one atomic increment and publish it by
+ *  storing its sequence number last, so a reader in another process can
+ *  tell complete events from those being overwritten under it.
+ *
+ *  @author Etherbone Core Developers <etherbone-core@ohwr.org>
+ *
+ *  @bug None!
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define ETHERBONE_IMPL
+
+#include "trace.h"
+
+#if defined(EB_TRACE) && !defined(__WIN32)
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <time.h>
+
+static struct eb_trace_ring* eb_trace_ring;
+static int eb_trace_opened;
+
+void eb_trace_open(void) {
+  struct eb_trace_ring* ring;
+  char name[40];
+  size_t size;
+  int fd;
+  
+  /* Only the first socket of the process creates the ring */
+  if (__atomic_exchange_n(&eb_trace_opened, 1, __ATOMIC_ACQ_REL) != 0) return;
+  
+  size = sizeof(struct eb_trace_ring) + ((1UL << EB_TRACE_BITS) - 1) * sizeof(struct eb_trace_event);
+  snprintf(name, sizeof(name), EB_TRACE_NAME, (long)getpid());
+  
+  /* A ring left behind by an earlier process with our pid is replaced */
+  shm_unlink(name);
+  if ((fd = shm_open(name, O_RDWR|O_CREAT|O_EXCL, 0644)) == -1) return;
+  
+  if (ftruncate(fd, size) != 0) {
+    close(fd);
+    shm_unlink(name);
+    return;
+  }
+  
+  ring = (struct eb_trace_ring*)mmap(0, size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  
+  if (ring == MAP_FAILED) {
+    shm_unlink(name);
+    return;
+  }
+  
+  /* The new file is zero-filled: every slot reads as incomplete */
+  ring->version = EB_TRACE_VERSION;
+  ring->size = 1UL << EB_TRACE_BITS;
+  ring->pid = getpid();
+  ring->none = EB_TRACE_NONE;
+  __atomic_store_n(&ring->magic, EB_TRACE_MAGIC, __ATOMIC_RELEASE);
+  __atomic_store_n(&eb_trace_ring, ring, __ATOMIC_RELEASE);
+  
+  eb_trace(EB_TRACE_OPEN, EB_TRACE_NONE, EB_TRACE_NONE, ring->pid);
+}
+
+void eb_trace(uint32_t event, uint32_t device, uint32_t cycle, uint32_t arg) {
+  struct eb_trace_ring* ring;
+  struct eb_trace_event* slot;
+  struct timespec ts;
+  uint64_t index;
+  
+  ring = __atomic_load_n(&eb_trace_ring, __ATOMIC_ACQUIRE);
+  if (ring == 0) return;
+  
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  
+  index = __atomic_fetch_add(&ring->head, 1, __ATOMIC_RELAXED);
+  slot = &ring->event[index & (ring->size-1)];
+  
+  /* Invalidate the slot before overwriting it */
+  __atomic_store_n(&slot->seq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  
+  slot->time = (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+  slot->event = event;
+  slot->device = device;
+  slot->cycle = cycle;
+  slot->arg = arg;
+  
+  __atomic_store_n(&slot->seq, (uint32_t)(index+1), __ATOMIC_RELEASE);
+}
+
+#elif defined(EB_TRACE)
+
+void eb_trace_open(void) {
+}
+
+void eb_trace(uint32_t event, uint32_t device, uint32_t cycle, uint32_t arg) {
+}
+
+#endif
+
+void eb_trace_mark(uint32_t value) {
+  eb_trace(EB_TRACE_MARK, EB_TRACE_NONE, EB_TRACE_NONE, value);
+}
@@ -0,0 +1,97 @@
+/** @file trace.h
+ *  @brief Optional tracepoints recorded into a shared-memory ring.
+ *
+ *  Copyright (C) 2026 GSI Helmholtz Centre for Heavy Ion Research GmbH
+ *
+ *  Built with -DEB_TRACE, each socket process records the life of its
+ *  cycles (close, pack, send, receive, reply, callback) into a ring in
+ *  POSIX shared memory, named /etherbone-trace.<pid>. The eb-trace tool
+ *  prints the ring as a timeline, while running or after a crash.
+ *  Without EB_TRACE the tracepoints compile to nothing.
+ *
+ *  @author Etherbone Core Developers <etherbone-core@ohwr.org>
+ *
+ *  @bug None!
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#ifndef EB_TRACE_H
+#define EB_TRACE_H
+
+#include "../etherbone.h"
+
+#define EB_TRACE_MAGIC   0x45425452UL /* "EBTR" */
+#define EB_TRACE_VERSION 1
+#define EB_TRACE_NAME    "/etherbone-trace.%ld"
+
+/* The ring holds the last 2^EB_TRACE_BITS events (768KB by default) */
+#ifndef EB_TRACE_BITS
+#define EB_TRACE_BITS 15
+#endif
+
+/* What happened; device and cycle are handles, EB_TRACE_NONE if not applicable */
+#define EB_TRACE_OPEN     1 /* socket opened;   arg = pid */
+#define EB_TRACE_CLOSE    2 /* cycle closed;    arg = 0 */
+#define EB_TRACE_PACK     3 /* cycle packed;    arg = records */
+#define EB_TRACE_SEND     4 /* packet sent;     arg = bytes */
+#define EB_TRACE_RECV     5 /* packet received; arg = bytes */
+#define EB_TRACE_REPLY    6 /* cycle answered;  arg = round-trip in us */
+#define EB_TRACE_EXPIRE   7 /* cycle timed out; arg = 0 */
+#define EB_TRACE_CALLBACK 8 /* callback entered; arg = status */
+#define EB_TRACE_RETURN   9 /* callback returned; arg = status */
+#define EB_TRACE_MARK    10 /* eb_trace_mark;   arg = value */
+
+struct eb_trace_event {
+  uint64_t time;   /* nanoseconds of CLOCK_MONOTONIC */
+  uint32_t seq;    /* (index+1) once the event is complete; 0 while written */
+  uint32_t event;
+  uint32_t device;
+  uint32_t cycle;
+  uint32_t arg;
+  uint32_t pad;
+};
+
+struct eb_trace_ring {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t size;   /* events in the ring, a power of two */
+  uint32_t pid;
+  uint32_t none;   /* EB_TRACE_NONE of the library */
+  uint32_t pad;
+  uint64_t head;   /* number of events ever claimed */
+  struct eb_trace_event event[1];
+};
+
+#define EB_TRACE_HANDLE(x) ((uint32_t)(uintptr_t)(x))
+#define EB_TRACE_NONE      EB_TRACE_HANDLE(EB_NULL)
+
+#ifdef EB_TRACE
+
+/* Create the ring of this process; later calls do nothing */
+EB_PRIVATE void eb_trace_open(void);
+
+/* Record one event. Lock-free; safe from any thread once open. */
+EB_PRIVATE void eb_trace(uint32_t event, uint32_t device, uint32_t cycle, uint32_t arg);
+
+#else
+
+#define eb_trace_open() do { } while (0)
+#define eb_trace(event, device, cycle, arg) do { } while (0)
+
+#endif
+
+#endif
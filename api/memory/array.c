@@ -34,6 +34,7 @@
 
 EB_POINTER(eb_memory_item) eb_memory_free = EB_END_OF_FREE;
 EB_PRIVATE EB_POINTER(eb_memory_item) eb_memory_used = 0;
+static EB_POINTER(eb_memory_item) eb_memory_peak = 0;
 
 static EB_POINTER(eb_new_memory_item) eb_new_memory_item(void) {
   EB_POINTER(eb_memory_item) alloc;
@@ -46,7 +47,7 @@ static EB_POINTER(eb_new_memory_item) eb_new_memory_item(void) {
   alloc = eb_memory_free;
   eb_memory_free = EB_FREE_ITEM(alloc)->next;
   
-  ++eb_memory_used;
+  if (++eb_memory_used > eb_memory_peak) eb_memory_peak = eb_memory_used;
   return alloc;
 }
 
@@ -56,6 +57,12 @@ static void eb_free_memory_item(EB_POINTER(eb_memory_item) item) {
   --eb_memory_used;
 }
 
+void eb_memory_stats(uint32_t* used, uint32_t* peak, uint32_t* size) {
+  *used = eb_memory_used;
+  *peak = eb_memory_peak;
+  *size = eb_memory_array_size;
+}
+
 eb_operation_t        eb_new_operation       (void) { return (eb_operation_t)       eb_new_memory_item(); }
 eb_cycle_t            eb_new_cycle           (void) { return (eb_cycle_t)           eb_new_memory_item(); }
 eb_device_t           eb_new_device          (void) { return (eb_device_t)          eb_new_memory_item(); }
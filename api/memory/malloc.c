@@ -33,33 +33,57 @@
 #include <stdlib.h>
 #include "memory.h"
 
-eb_operation_t        eb_new_operation       (void) { return (eb_operation_t)       malloc(sizeof(struct eb_operation));        }
-eb_cycle_t            eb_new_cycle           (void) { return (eb_cycle_t)           malloc(sizeof(struct eb_cycle));            }
-eb_device_t           eb_new_device          (void) { return (eb_device_t)          malloc(sizeof(struct eb_device));           }
-eb_handler_callback_t eb_new_handler_callback(void) { return (eb_handler_callback_t)malloc(sizeof(struct eb_handler_callback)); }
-eb_handler_address_t  eb_new_handler_address (void) { return (eb_handler_address_t) malloc(sizeof(struct eb_handler_address));  }
-eb_response_t         eb_new_response        (void) { return (eb_response_t)        malloc(sizeof(struct eb_response));         }
-eb_socket_t           eb_new_socket          (void) { return (eb_socket_t)          malloc(sizeof(struct eb_socket));           }
-eb_socket_aux_t       eb_new_socket_aux      (void) { return (eb_socket_aux_t)      malloc(sizeof(struct eb_socket_aux));       }
-eb_transport_t        eb_new_transport       (void) { return (eb_transport_t)       malloc(sizeof(struct eb_transport));        }
-eb_link_t             eb_new_link            (void) { return (eb_link_t)            malloc(sizeof(struct eb_link));             }
-eb_sdb_scan_t         eb_new_sdb_scan        (void) { return (eb_sdb_scan_t)        malloc(sizeof(struct eb_sdb_scan));         }
-eb_sdb_scan_meta_t    eb_new_sdb_scan_meta   (void) { return (eb_sdb_scan_meta_t)   malloc(sizeof(struct eb_sdb_scan_meta));    }
-eb_sdb_record_t       eb_new_sdb_record      (void) { return (eb_sdb_record_t)      malloc(sizeof(struct eb_sdb_record));       }
+/* Every object is a separate block; only count them */
+static uint32_t eb_memory_used = 0;
+static uint32_t eb_memory_peak = 0;
 
-void eb_free_operation       (eb_operation_t        x) { free(x); }
-void eb_free_cycle           (eb_cycle_t            x) { free(x); }
-void eb_free_device          (eb_device_t           x) { free(x); }
-void eb_free_handler_callback(eb_handler_callback_t x) { free(x); }
-void eb_free_handler_address (eb_handler_address_t  x) { free(x); }
-void eb_free_response        (eb_response_t         x) { free(x); }
-void eb_free_socket          (eb_socket_t           x) { free(x); }
-void eb_free_socket_aux      (eb_socket_aux_t       x) { free(x); }
-void eb_free_transport       (eb_transport_t        x) { free(x); }
-void eb_free_link            (eb_link_t             x) { free(x); }
-void eb_free_sdb_scan        (eb_sdb_scan_t         x) { free(x); }
-void eb_free_sdb_scan_meta   (eb_sdb_scan_meta_t    x) { free(x); }
-void eb_free_sdb_record      (eb_sdb_record_t       x) { free(x); }
+static void* eb_malloc(size_t size) {
+  void* out;
+  
+  if ((out = malloc(size)) != 0 && ++eb_memory_used > eb_memory_peak)
+    eb_memory_peak = eb_memory_used;
+  
+  return out;
+}
+
+static void eb_free(void* x) {
+  if (x != 0) --eb_memory_used;
+  free(x);
+}
+
+eb_operation_t        eb_new_operation       (void) { return (eb_operation_t)       eb_malloc(sizeof(struct eb_operation));        }
+eb_cycle_t            eb_new_cycle           (void) { return (eb_cycle_t)           eb_malloc(sizeof(struct eb_cycle));            }
+eb_device_t           eb_new_device          (void) { return (eb_device_t)          eb_malloc(sizeof(struct eb_device));           }
+eb_handler_callback_t eb_new_handler_callback(void) { return (eb_handler_callback_t)eb_malloc(sizeof(struct eb_handler_callback)); }
+eb_handler_address_t  eb_new_handler_address (void) { return (eb_handler_address_t) eb_malloc(sizeof(struct eb_handler_address));  }
+eb_response_t         eb_new_response        (void) { return (eb_response_t)        eb_malloc(sizeof(struct eb_response));         }
+eb_socket_t           eb_new_socket          (void) { return (eb_socket_t)          eb_malloc(sizeof(struct eb_socket));           }
+eb_socket_aux_t       eb_new_socket_aux      (void) { return (eb_socket_aux_t)      eb_malloc(sizeof(struct eb_socket_aux));       }
+eb_transport_t        eb_new_transport       (void) { return (eb_transport_t)       eb_malloc(sizeof(struct eb_transport));        }
+eb_link_t             eb_new_link            (void) { return (eb_link_t)            eb_malloc(sizeof(struct eb_link));             }
+eb_sdb_scan_t         eb_new_sdb_scan        (void) { return (eb_sdb_scan_t)        eb_malloc(sizeof(struct eb_sdb_scan));         }
+eb_sdb_scan_meta_t    eb_new_sdb_scan_meta   (void) { return (eb_sdb_scan_meta_t)   eb_malloc(sizeof(struct eb_sdb_scan_meta));    }
+eb_sdb_record_t       eb_new_sdb_record      (void) { return (eb_sdb_record_t)      eb_malloc(sizeof(struct eb_sdb_record));       }
+
+void eb_free_operation       (eb_operation_t        x) { eb_free(x); }
+void eb_free_cycle           (eb_cycle_t            x) { eb_free(x); }
+void eb_free_device          (eb_device_t           x) { eb_free(x); }
+void eb_free_handler_callback(eb_handler_callback_t x) { eb_free(x); }
+void eb_free_handler_address (eb_handler_address_t  x) { eb_free(x); }
+void eb_free_response        (eb_response_t         x) { eb_free(x); }
+void eb_free_socket          (eb_socket_t           x) { eb_free(x); }
+void eb_free_socket_aux      (eb_socket_aux_t       x) { eb_free(x); }
+void eb_free_transport       (eb_transport_t        x) { eb_free(x); }
+void eb_free_link            (eb_link_t             x) { eb_free(x); }
+void eb_free_sdb_scan        (eb_sdb_scan_t         x) { eb_free(x); }
+void eb_free_sdb_scan_meta   (eb_sdb_scan_meta_t    x) { eb_free(x); }
+void eb_free_sdb_record      (eb_sdb_record_t       x) { eb_free(x); }
+
+void eb_memory_stats(uint32_t* used, uint32_t* peak, uint32_t* size) {
+  *used = eb_memory_used;
+  *peak = eb_memory_peak;
+  *size = 0;
+}
 
 #else
 
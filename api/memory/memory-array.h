@@ -60,6 +60,7 @@ EB_PRIVATE extern union eb_memory_item eb_memory_array[];
 EB_PRIVATE extern union eb_memory_item* eb_memory_array;
 #endif
 EB_PRIVATE extern EB_POINTER(eb_memory_item) eb_memory_free;
+EB_PRIVATE extern uint32_t eb_memory_array_size; /* cells in eb_memory_array */
 
 EB_PRIVATE int eb_expand_array(void);
 
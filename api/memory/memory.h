@@ -66,7 +66,7 @@ EB_PRIVATE void eb_free_socket_aux(eb_socket_aux_t x);
 EB_PRIVATE void eb_free_transport(eb_transport_t x);
 EB_PRIVATE void eb_free_link(eb_link_t x);
 EB_PRIVATE void eb_free_sdb_scan(eb_sdb_scan_t x);
-EB_PRIVATE void eb_free_sdb_scan_meta(eb_sdb_scan_t x);
+EB_PRIVATE void eb_free_sdb_scan_meta(eb_sdb_scan_meta_t x);
 EB_PRIVATE void eb_free_sdb_record(eb_sdb_record_t x);
 
 #endif
@@ -35,7 +35,7 @@
 #include "memory.h"
 
 union eb_memory_item eb_memory_array[EB_USE_STATIC];
-static const EB_POINTER(eb_memory_item) eb_memory_array_size = EB_USE_STATIC;
+EB_PRIVATE uint32_t eb_memory_array_size = EB_USE_STATIC;
 
 int eb_expand_array(void) {
   static int setup = 0;
@@ -0,0 +1,378 @@
+/** @file bench.cpp
+ *  @brief Benchmarks of the library against a loopback slave.
+ *
+ *  Copyright (C) 2026 GSI Helmholtz Centre for Heavy Ion Research GmbH
+ *
+ *  As in loopback.cpp, one socket is both master and slave: the devices
+ *  connect back to the port of the socket itself, where Memory answers.
+ *  Each measurement prints one line of JSON, so runs can be compared.
+ *
+ *  @author Etherbone Core Developers <etherbone-core@ohwr.org>
+ *
+ *  @bug None!
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define __STDC_FORMAT_MACROS
+#define __STDC_CONSTANT_MACROS
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h> /* getopt */
+
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "../etherbone.h"
+
+using namespace etherbone;
+using namespace std;
+
+#define HANDLERS 64 /* attached for dispatch and sdb */
+
+static const char* program;
+static const char* port = "60500";
+static double scale = 1.0;
+static vector<string> only;
+
+static void die(const char* why, status_t error) {
+  fflush(stdout);
+  fprintf(stderr, "%s: %s: %s\n", program, why, eb_status(error));
+  exit(1);
+}
+
+static double now_us() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1e6 + ts.tv_nsec/1e3;
+}
+
+static int iterations(int base) {
+  int n = (int)(base*scale);
+  return (n < 1) ? 1 : n;
+}
+
+/* Answers every read with its address */
+class Memory : public Handler {
+public:
+  status_t read (address_t address, width_t width, data_t* data);
+  status_t write(address_t address, width_t width, data_t  data);
+};
+
+status_t Memory::read(address_t address, width_t width, data_t* data) {
+  *data = address & 0xFFFFFFFFUL;
+  return EB_OK;
+}
+
+status_t Memory::write(address_t address, width_t width, data_t data) {
+  return EB_OK;
+}
+
+/* The timings of one benchmark */
+class Result {
+public:
+  string name;
+  long ops;
+  double start, stop;
+  vector<double> latency; /* microseconds per cycle */
+
+  Result(const string& name);
+  bool wanted() const;
+  void report();
+};
+
+Result::Result(const string& name_) : name(name_), ops(0), start(0), stop(0) {
+}
+
+bool Result::wanted() const {
+  if (only.empty()) return true;
+  for (unsigned i = 0; i < only.size(); ++i)
+    if (name.compare(0, only[i].size(), only[i]) == 0) return true;
+  return false;
+}
+
+void Result::report() {
+  double seconds = (stop - start) / 1e6;
+
+  printf("{\"bench\": \"%s\", \"ops\": %ld, \"seconds\": %.6f, \"ops_per_s\": %.0f",
+    name.c_str(), ops, seconds, seconds > 0 ? ops/seconds : 0.0);
+
+  if (!latency.empty()) {
+    sort(latency.begin(), latency.end());
+    printf(", \"p50_us\": %.2f, \"p99_us\": %.2f, \"p999_us\": %.2f",
+      latency[latency.size()*500/1000],
+      latency[latency.size()*990/1000],
+      latency[latency.size()*999/1000]);
+  }
+
+  printf("}\n");
+  fflush(stdout);
+}
+
+/* A cycle in flight */
+struct Pending {
+  double sent;
+  Result* result;
+  int* busy;
+};
+
+static void complete(Pending* pending, Device dev, Operation op, status_t status) {
+  if (status != EB_OK) die("cycle failed", status);
+  pending->result->latency.push_back(now_us() - pending->sent);
+  --*pending->busy;
+}
+
+/* Keep up to depth cycles of ops operations in flight */
+static void pipeline(Socket socket, Device device, Result& result, int cycles, int depth, int ops, bool write, address_t spread) {
+  vector<Pending> pending(cycles);
+  format_t format = EB_BIG_ENDIAN|EB_DATA32;
+  address_t base;
+  Cycle cycle;
+  status_t err;
+  int busy;
+
+  busy = 0;
+  result.start = now_us();
+
+  for (int i = 0; i < cycles; ++i) {
+    while (busy >= depth) socket.run(-1);
+
+    pending[i].result = &result;
+    pending[i].busy = &busy;
+
+    if ((err = cycle.open(device, &pending[i], &wrap_function_callback<Pending, complete>)) != EB_OK)
+      die("cycle.open", err);
+
+    base = 0x10000 * (1 + (spread ? rand() % spread : 0));
+    for (int j = 0; j < ops; ++j) {
+      if (spread) base = 0x10000 * (1 + rand() % spread);
+      if (write) cycle.write(base + 4*j, format, j);
+      else       cycle.read (base + 4*j, format, 0);
+    }
+
+    pending[i].sent = now_us();
+    cycle.close();
+    ++busy;
+  }
+
+  while (busy > 0) socket.run(-1);
+
+  result.stop = now_us();
+  result.ops = (long)cycles * ops;
+}
+
+/* Open and abort cycles: the allocator and operation bookkeeping */
+static void bench_alloc(Device device) {
+  Result result("alloc");
+  Cycle cycle;
+  status_t err;
+  double t;
+  int cycles;
+
+  if (!result.wanted()) return;
+
+  cycles = iterations(100000);
+  result.start = now_us();
+  for (int i = 0; i < cycles; ++i) {
+    t = now_us();
+    if ((err = cycle.open(device)) != EB_OK) die("cycle.open", err);
+    for (int j = 0; j < 32; ++j)
+      cycle.read(0x10000 + 4*j, EB_BIG_ENDIAN|EB_DATA32, 0);
+    cycle.abort();
+    result.latency.push_back(now_us() - t);
+  }
+  result.stop = now_us();
+  result.ops = (long)cycles * 32;
+  result.report();
+}
+
+static int sdb_records;
+static void sdb_complete(int* busy, Device dev, const struct sdb_table* sdb, status_t status) {
+  if (status != EB_OK) die("sdb scan", status);
+  sdb_records += sdb->interconnect.sdb_records;
+  --*busy;
+}
+
+/* Read and decode the table of the attached devices */
+static void bench_sdb(Socket socket, Device device) {
+  Result result("sdb");
+  status_t err;
+  double t;
+  int scans, busy;
+
+  if (!result.wanted()) return;
+
+  scans = iterations(2000);
+  sdb_records = 0;
+  result.start = now_us();
+  for (int i = 0; i < scans; ++i) {
+    t = now_us();
+    busy = 1;
+    if ((err = device.sdb_scan_root(&busy, &sdb_wrap_function_callback<int, sdb_complete>)) != EB_OK)
+      die("sdb_scan_root", err);
+    while (busy > 0) socket.run(-1);
+    result.latency.push_back(now_us() - t);
+  }
+  result.stop = now_us();
+  result.ops = sdb_records;
+  result.report();
+}
+
+/* Connect to the socket itself; false if the transport is unavailable */
+static bool open_loopback(Socket socket, const char* transport, Device& device) {
+  string address;
+  status_t err;
+
+  if (strcmp(transport, "shm") == 0)
+    address = string(transport) + "/" + port;
+  else
+    address = string(transport) + "/localhost/" + port;
+
+  if ((err = device.open(socket, address.c_str(), EB_ADDR32|EB_DATA32)) != EB_OK) {
+    fprintf(stderr, "%s: skipping %s: %s\n", program, address.c_str(), eb_status(err));
+    return false;
+  }
+
+  return true;
+}
+
+/* Throughput and latency over one transport */
+static void bench_transport(Socket socket, const char* transport) {
+  Device device;
+  status_t err;
+
+  Result rtt      (string("rtt/")        + transport);
+  Result stream   (string("throughput/") + transport);
+  Result format   (string("format/")     + transport);
+  Result dispatch (string("dispatch/")   + transport);
+
+  if (!rtt.wanted() && !stream.wanted() && !format.wanted() && !dispatch.wanted()) return;
+  if (!open_loopback(socket, transport, device)) return;
+
+  /* One read at a time: the round-trip latency */
+  if (rtt.wanted()) {
+    pipeline(socket, device, rtt, iterations(20000), 1, 1, false, 0);
+    rtt.report();
+  }
+
+  /* Many reads in flight */
+  if (stream.wanted()) {
+    pipeline(socket, device, stream, iterations(20000), 16, 32, false, 0);
+    stream.report();
+  }
+
+  /* Long write cycles: mostly packing and parsing records */
+  if (format.wanted()) {
+    pipeline(socket, device, format, iterations(5000), 16, 250, true, 0);
+    format.report();
+  }
+
+  /* Reads scattered over all the attached devices */
+  if (dispatch.wanted()) {
+    pipeline(socket, device, dispatch, iterations(10000), 16, 32, false, HANDLERS);
+    dispatch.report();
+  }
+
+  if ((err = device.close()) != EB_OK) die("device.close", err);
+}
+
+static void help(void) {
+  fprintf(stderr, "Usage: %s [OPTION] [benchmark ...]\n", program);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Runs the benchmarks whose names start with one of the arguments (all).\n");
+  fprintf(stderr, "Each result is printed as one line of JSON.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -p <port>      port of the loopback slave             (60500)\n");
+  fprintf(stderr, "  -s <scale>     multiply the iteration counts            (1.0)\n");
+  fprintf(stderr, "  -h             display this help and exit\n");
+}
+
+int main(int argc, char** argv) {
+  static Memory memory[HANDLERS];
+  struct sdb_device device[HANDLERS];
+  char* value_end;
+  status_t err;
+  int opt;
+
+  program = argv[0];
+
+  while ((opt = getopt(argc, argv, "p:s:h")) != -1) {
+    switch (opt) {
+    case 'p':
+      port = optarg;
+      break;
+    case 's':
+      scale = strtod(optarg, &value_end);
+      if (*value_end || scale <= 0) {
+        fprintf(stderr, "%s: invalid scale -- '%s'\n", program, optarg);
+        return 1;
+      }
+      break;
+    case 'h':
+      help();
+      return 1;
+    default:
+      return 1;
+    }
+  }
+
+  for (; optind < argc; ++optind)
+    only.push_back(argv[optind]);
+
+  Socket socket;
+  if ((err = socket.open(port, EB_DATAX|EB_ADDRX)) != EB_OK) die("socket.open", err);
+
+  /* Devices at 0x10000, 0x20000, ... */
+  for (int i = 0; i < HANDLERS; ++i) {
+    memset(&device[i], 0, sizeof(device[i]));
+    device[i].abi_class = 0x1;
+    device[i].abi_ver_major = 1;
+    device[i].bus_specific = EB_DATAX;
+    device[i].sdb_component.addr_first = 0x10000 * (i+1);
+    device[i].sdb_component.addr_last  = 0x10000 * (i+1) + 0xFFFF;
+    device[i].sdb_component.product.vendor_id = 0x651; /* GSI */
+    device[i].sdb_component.product.device_id = 0xb576c7f1;
+    device[i].sdb_component.product.version = 1;
+    device[i].sdb_component.product.date = 0x20120101;
+    device[i].sdb_component.product.record_type = sdb_record_device;
+    memcpy(device[i].sdb_component.product.name, "Software-Memory    ", sizeof(device[i].sdb_component.product.name));
+
+    if ((err = socket.attach(&device[i], &memory[i])) != EB_OK) die("socket.attach", err);
+  }
+
+  /* Library overhead, over the cheapest transport */
+  Device local;
+  if ((Result("alloc").wanted() || Result("sdb").wanted()) && open_loopback(socket, "shm", local)) {
+    bench_alloc(local);
+    bench_sdb(socket, local);
+    if ((err = local.close()) != EB_OK) die("device.close", err);
+  }
+
+  bench_transport(socket, "shm");
+  bench_transport(socket, "tcp");
+  bench_transport(socket, "udp");
+
+  for (int i = 0; i < HANDLERS; ++i)
+    socket.detach(&device[i]);
+
+  if ((err = socket.close()) != EB_OK) die("socket.close", err);
+
+  return 0;
+}
@@ -0,0 +1,112 @@
+/** @file expire.c
+ *  @brief Close a device from the callback of a cycle which timed out.
+ *
+ *  Copyright (C) 2026 GSI Helmholtz Centre for Heavy Ion Research GmbH
+ *
+ *  Two cycles are sent to a UDP port which never answers, so both
+ *  expire in the same eb_socket_run. The first callback closes the
+ *  device. The other cycle must still complete exactly once, with
+ *  EB_TIMEOUT, and never touch the closed device.
+ *
+ *  @author Etherbone Core Developers <etherbone-core@ohwr.org>
+ *
+ *  @bug None!
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "../etherbone.h"
+
+#define CYCLES 2
+
+static int calls[CYCLES];
+static int closed;
+
+static void die(const char* why, eb_status_t status) {
+  fprintf(stderr, "%s: %s\n", why, eb_status(status));
+  exit(1);
+}
+
+static void expired(eb_user_data_t user, eb_device_t dev, eb_operation_t op, eb_status_t status) {
+  long i = (long)user;
+  eb_status_t err;
+
+  ++calls[i];
+  if (status != EB_TIMEOUT) die("cycle", status);
+
+  /* The first callback to run closes the device under the other cycle */
+  if (!closed) {
+    closed = 1;
+    if ((err = eb_device_close(dev)) != EB_OK) die("eb_device_close", err);
+  }
+}
+
+int main(void) {
+  struct sockaddr_in sa;
+  socklen_t len;
+  eb_socket_t sock;
+  eb_device_t device;
+  eb_cycle_t cycle;
+  eb_status_t err;
+  char address[64];
+  long i;
+  int sink, done;
+
+  /* A UDP port which swallows everything */
+  if ((sink = socket(AF_INET, SOCK_DGRAM, 0)) == -1) die("socket", EB_FAIL);
+  memset(&sa, 0, sizeof(sa));
+  sa.sin_family = AF_INET;
+  sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  len = sizeof(sa);
+  if (bind(sink, (struct sockaddr*)&sa, len) != 0) die("bind", EB_FAIL);
+  if (getsockname(sink, (struct sockaddr*)&sa, &len) != 0) die("getsockname", EB_FAIL);
+  sprintf(address, "udp/127.0.0.1/%d", ntohs(sa.sin_port));
+
+  if ((err = eb_socket_open(EB_ABI_CODE, 0, EB_ADDR32|EB_DATA32, &sock)) != EB_OK) die("eb_socket_open", err);
+  if ((err = eb_device_open(sock, address, EB_ADDR32|EB_DATA32, 0, &device)) != EB_OK) die("eb_device_open", err);
+
+  /* Track the device, so losses reach its flow control */
+  if ((err = eb_device_window(device, 16)) != EB_OK) die("eb_device_window", err);
+
+  for (i = 0; i < CYCLES; ++i) {
+    if ((err = eb_cycle_open(device, (eb_user_data_t)i, &expired, &cycle)) != EB_OK) die("eb_cycle_open", err);
+    eb_cycle_timeout(cycle, 100000);
+    eb_cycle_read(cycle, 0x1000 + i*4, EB_DATA32|EB_BIG_ENDIAN, 0);
+    eb_cycle_close(cycle);
+  }
+
+  for (done = 0; done < CYCLES; ) {
+    eb_socket_run(sock, 1000000);
+    for (done = i = 0; i < CYCLES; ++i) done += calls[i];
+  }
+
+  for (i = 0; i < CYCLES; ++i)
+    if (calls[i] != 1) die("callback count", EB_FAIL);
+
+  if ((err = eb_socket_close(sock)) != EB_OK) die("eb_socket_close", err);
+  close(sink);
+
+  printf("ok\n");
+  return 0;
+}
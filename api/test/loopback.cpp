@@ -29,7 +29,6 @@
 #define __STDC_FORMAT_MACROS
 #define __STDC_CONSTANT_MACROS
 
-// #define EB_MEMORY_HACK 1
 #define EB_TEST_TCP 1
 
 #include <stdio.h>
@@ -43,11 +42,6 @@
 #include "../etherbone.h"
 #include "../glue/version.h"
 
-#ifdef EB_MEMORY_HACK
-extern uint16_t eb_memory_used; // A hack to read directly the memory consumption of EB
-extern uint32_t eb_memory_array_size;
-#endif
-
 using namespace etherbone;
 using namespace std;
 
@@ -340,10 +334,10 @@ void test_width(Socket socket, width_t width) {
 #endif
   
   for (int len = 0; len < 4000; ++len) {
-#ifdef EB_MEMORY_HACK
-    printf("\rLength: %d ==> %d/%d cells used... ", len, eb_memory_used, eb_memory_array_size);
+    uint32_t used, peak, size;
+    memory_stats(&used, &peak, &size);
+    printf("\rLength: %d ==> %d/%d cells used (peak %d)... ", len, used, size, peak);
     fflush(stdout);
-#endif
     
     for (int requests = 1; requests <= 9; ++requests)
       for (int repetitions = 0; repetitions < 100; ++repetitions)
@@ -366,8 +360,8 @@ int main() {
   device.sdb_component.addr_last  = ~(eb_address_t)0;
   device.sdb_component.product.vendor_id = 0x651; /* GSI */
   device.sdb_component.product.device_id = 0xb576c7f1;
-  device.sdb_component.product.version = EB_VERSION_SHORT;
-  device.sdb_component.product.date = EB_DATE_SHORT;
+  device.sdb_component.product.version = eb_version_short;
+  device.sdb_component.product.date = eb_date_short;
   device.sdb_component.product.record_type = sdb_record_device;
   
   memcpy(device.sdb_component.product.name, "Software-Memory    ", sizeof(device.sdb_component.product.name));
@@ -383,9 +377,9 @@ int main() {
   
   if ((err = socket.close()) != EB_OK) die("socket.close", err);
 
-#ifdef EB_MEMORY_HACK
-  printf("\nFinal memory consumption: %d/%d\n", eb_memory_used, eb_memory_array_size);
-#endif
+  uint32_t used, peak, size;
+  memory_stats(&used, &peak, &size);
+  printf("\nFinal memory consumption: %d/%d (peak %d)\n", used, size, peak);
   
   return 0;
 }
@@ -0,0 +1,582 @@
+/** @file eb-broker.c
+ *  @brief Share one streaming Etherbone link between many local clients.
+ *
+ *  Copyright (C) 2026 GSI Helmholtz Centre for Heavy Ion Research GmbH 
+ *
+ *  The broker owns the link (usually a dev/wbm character device) and
+ *  accepts clients on the streaming transports of its port (tcp, shm).
+ *  Whole cycles are taken round-robin from the clients and merged into
+ *  large writes to the device. A slave answers read records in order,
+ *  so responses are routed back by remembering who issued each read.
+ *
+ *  @author Etherbone Core Developers <etherbone-core@ohwr.org>
+ *
+ *  @bug Requests sent by the device to the host (eg: MSI) are dropped.
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define _POSIX_C_SOURCE 200112L /* getopt */
+
+#include <unistd.h> /* getopt */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+
+#include "../transport/transport.h"
+#include "../transport/posix-tcp.h"
+#include "../format/format.h"
+#include "../glue/widths.h"
+
+#define MAX_CLIENTS 256
+#define BATCH_LIMIT 65536        /* bytes of cycles merged into one device write */
+#define CYCLE_LIMIT (1024*1024)  /* largest cycle a client may build up */
+#define OUT_LIMIT   (1024*1024)  /* unsent responses before a client's cycles wait */
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+struct eb_buffer {
+  uint8_t* data;
+  int used;
+  int size;
+};
+
+struct eb_client {
+  int active;
+  int probed;
+  unsigned int generation;
+  struct eb_transport* transport;
+  struct eb_link link;
+  struct eb_buffer in;  /* bytes not yet forwarded to the device */
+  int scanned;          /* prefix of in split into whole records */
+  int complete;         /* prefix of in holding whole cycles */
+  int unread;           /* reading stopped early; the link may hold more */
+  struct eb_buffer out; /* responses not yet sent to the client */
+};
+
+/* Who issued a read record still awaiting its response */
+struct eb_route {
+  int client;
+  unsigned int generation;
+};
+
+static const char* program;
+static int verbose;
+
+static struct eb_transport* transports;
+static int* listening;
+static struct eb_transport* device_transport;
+static struct eb_link device_link;
+static eb_width_t device_widths;
+static int alignment, record_alignment;
+
+static struct eb_client clients[MAX_CLIENTS];
+
+static struct eb_route* routes;
+static int route_head, route_count, route_size;
+static int route_owner; /* client receiving the current response cycle, -1 to drop */
+static int route_open;  /* inside a response cycle */
+
+static void help(void) {
+  fprintf(stderr, "Usage: %s [OPTION] <port> <proto/host/port>\n", program);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -v             verbose operation\n");
+  fprintf(stderr, "  -h             display this help and exit\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Clients connect with tcp/localhost/<port> or shm/<port>.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Report Etherbone bugs to <etherbone-core@ohwr.org>\n");
+}
+
+static void eb_buffer_reserve(struct eb_buffer* buffer, int len) {
+  int size;
+  
+  if (buffer->used + len <= buffer->size) return;
+  
+  size = buffer->size ? buffer->size : 4096;
+  while (size < buffer->used + len) size *= 2;
+  
+  if ((buffer->data = (uint8_t*)realloc(buffer->data, size)) == 0) {
+    fprintf(stderr, "%s: out of memory\n", program);
+    exit(1);
+  }
+  buffer->size = size;
+}
+
+static void eb_buffer_append(struct eb_buffer* buffer, const uint8_t* data, int len) {
+  eb_buffer_reserve(buffer, len);
+  memcpy(buffer->data + buffer->used, data, len);
+  buffer->used += len;
+}
+
+static void eb_buffer_consume(struct eb_buffer* buffer, int len) {
+  memmove(buffer->data, buffer->data + len, buffer->used - len);
+  buffer->used -= len;
+}
+
+static int eb_record_size(const uint8_t* record) {
+  int wcount = record[2];
+  int rcount = record[3];
+  return record_alignment + alignment*(wcount + rcount + (wcount>0) + (rcount>0));
+}
+
+static void eb_route_push(int client) {
+  struct eb_route* grown;
+  int i, size;
+  
+  if (route_count == route_size) {
+    size = route_size ? route_size*2 : 256;
+    if ((grown = (struct eb_route*)malloc(size * sizeof(struct eb_route))) == 0) {
+      fprintf(stderr, "%s: out of memory\n", program);
+      exit(1);
+    }
+    for (i = 0; i < route_count; ++i)
+      grown[i] = routes[(route_head + i) % route_size];
+    free(routes);
+    routes = grown;
+    route_size = size;
+    route_head = 0;
+  }
+  
+  i = (route_head + route_count) % route_size;
+  routes[i].client = client;
+  routes[i].generation = clients[client].generation;
+  ++route_count;
+}
+
+static int eb_route_pop(void) {
+  struct eb_route* route;
+  
+  if (route_count == 0) return -1;
+  
+  route = &routes[route_head];
+  route_head = (route_head + 1) % route_size;
+  --route_count;
+  
+  if (!clients[route->client].active || clients[route->client].generation != route->generation)
+    return -1; /* client left */
+  
+  return route->client;
+}
+
+static void eb_client_drop(int i) {
+  struct eb_client* client = &clients[i];
+  
+  if (verbose) fprintf(stdout, "Client %d disconnected\n", i);
+  
+  eb_transports[client->transport->link_type].disconnect(client->transport, &client->link);
+  free(client->in.data);
+  free(client->out.data);
+  client->active = 0;
+}
+
+/* The socket of a tcp client; -1 for links whose send never blocks (shm) */
+static int eb_client_socket(struct eb_client* client) {
+  if (eb_transports[client->transport->link_type].send != &eb_posix_tcp_send) return -1;
+  return ((struct eb_posix_tcp_link*)&client->link)->socket;
+}
+
+/* Can the client take more responses? Otherwise its cycles wait. */
+static int eb_client_ready(struct eb_client* client) {
+  return client->active && client->complete > 0 && client->out.used < OUT_LIMIT;
+}
+
+/* Read more from the client? Not while it has plenty queued, or ignores its responses */
+static int eb_client_reading(struct eb_client* client) {
+  return client->complete < BATCH_LIMIT && client->out.used < OUT_LIMIT;
+}
+
+/* Send as many responses as the client accepts without blocking */
+static void eb_client_flush(int i) {
+  struct eb_client* client = &clients[i];
+  int sock, len;
+  
+  if (client->out.used == 0) return;
+  
+  if ((sock = eb_client_socket(client)) == -1) {
+    eb_transports[client->transport->link_type].send(client->transport, &client->link, client->out.data, client->out.used);
+    client->out.used = 0;
+    return;
+  }
+  
+  len = send(sock, (const char*)client->out.data, client->out.used, MSG_DONTWAIT | MSG_NOSIGNAL);
+  if (len > 0) {
+    eb_buffer_consume(&client->out, len);
+  } else if (len < 0 && !eb_posix_ip_ewouldblock()) {
+    eb_client_drop(i);
+  }
+}
+
+/* Answer the probe and split new input into records and cycles. -1 on protocol error. */
+static int eb_client_scan(struct eb_client* client) {
+  uint8_t* record;
+  int size;
+  
+  if (!client->probed) {
+    if (client->in.used < 8) return 0;
+    
+    record = client->in.data;
+    if (record[0] != 0x4E || record[1] != 0x6F || (record[2] & EB_HEADER_PF) == 0) return -1;
+    
+    record[2] = 0x10 | EB_HEADER_PR | EB_HEADER_NR; /* V1 probe response */
+    record[3] = device_widths;                      /* The client must adopt these */
+    
+    /* Bytes 4-7 are echoed back */
+    eb_buffer_append(&client->out, record, 8);
+    eb_buffer_consume(&client->in, 8);
+    client->probed = 1;
+  }
+  
+  while (client->in.used - client->scanned >= record_alignment) {
+    record = client->in.data + client->scanned;
+    size = eb_record_size(record);
+    if (client->in.used - client->scanned < size) break;
+    
+    client->scanned += size;
+    if ((record[0] & EB_RECORD_CYC) != 0) client->complete = client->scanned;
+  }
+  
+  if (client->scanned - client->complete > CYCLE_LIMIT) return -1;
+  return 0;
+}
+
+/* Move one whole cycle from the client to the device batch */
+static void eb_client_take(int i, struct eb_buffer* batch) {
+  struct eb_client* client = &clients[i];
+  uint8_t* record;
+  int len;
+  
+  len = 0;
+  do {
+    record = client->in.data + len;
+    if (record[3] != 0) eb_route_push(i);
+    len += eb_record_size(record);
+  } while ((record[0] & EB_RECORD_CYC) == 0);
+  
+  eb_buffer_append(batch, client->in.data, len);
+  eb_buffer_consume(&client->in, len);
+  client->scanned  -= len;
+  client->complete -= len;
+}
+
+/* Hand whole response records from the device to their clients */
+static void eb_device_route(struct eb_buffer* in) {
+  uint8_t* record;
+  int pos, size;
+  
+  for (pos = 0; in->used - pos >= record_alignment; pos += size) {
+    record = in->data + pos;
+    size = eb_record_size(record);
+    if (in->used - pos < size) break;
+    
+    if (record[3] != 0) {
+      /* The device is asking us something; nobody here can answer */
+      if (verbose) fprintf(stdout, "Dropping request from the device\n");
+      continue;
+    }
+    
+    /* Each read record is answered by exactly one write record */
+    if (record[2] != 0) {
+      route_owner = eb_route_pop();
+      route_open = 1;
+    }
+    
+    /* Padding outside a response cycle belongs to nobody */
+    if (route_open && route_owner != -1)
+      eb_buffer_append(&clients[route_owner].out, record, size);
+    
+    if ((record[0] & EB_RECORD_CYC) != 0) route_open = 0;
+  }
+  
+  eb_buffer_consume(in, pos);
+}
+
+struct eb_block_sets {
+  int nfd;
+  fd_set rfds;
+  fd_set wfds;
+};
+
+static int eb_update_sets(eb_user_data_t data, eb_descriptor_t fd, uint8_t mode) {
+  struct eb_block_sets* set = (struct eb_block_sets*)data;
+  
+  if (fd > set->nfd) set->nfd = fd;
+  
+  if ((mode & EB_DESCRIPTOR_IN)  != 0) FD_SET(fd, &set->rfds);
+  if ((mode & EB_DESCRIPTOR_OUT) != 0) FD_SET(fd, &set->wfds);
+  
+  return 0;
+}
+
+static int eb_check_sets(eb_user_data_t data, eb_descriptor_t fd, uint8_t mode) {
+  struct eb_block_sets* set = (struct eb_block_sets*)data;
+  
+  return 
+    (((mode & EB_DESCRIPTOR_IN)  != 0) && FD_ISSET(fd, &set->rfds)) ||
+    (((mode & EB_DESCRIPTOR_OUT) != 0) && FD_ISSET(fd, &set->wfds));
+}
+
+/* Negotiate the bus widths of the device */
+static int eb_device_probe(void) {
+  struct eb_transport_ops* ops;
+  struct eb_block_sets sets;
+  struct timeval tv;
+  uint8_t buf[8] = { 0x4E, 0x6F, 0x11, EB_ADDRX|EB_DATAX, 0x0, 0x0, 0x0, 0x0 };
+  eb_width_t biggest;
+  int got, len;
+  
+  ops = &eb_transports[device_transport->link_type];
+  ops->send(device_transport, &device_link, buf, sizeof(buf));
+  
+  for (got = 0; got < 8; got += len) {
+    FD_ZERO(&sets.rfds);
+    FD_ZERO(&sets.wfds);
+    sets.nfd = 0;
+    ops->fdes(device_transport, &device_link, &sets, &eb_update_sets);
+    
+    tv.tv_sec = 3;
+    tv.tv_usec = 0;
+    if (select(sets.nfd+1, &sets.rfds, &sets.wfds, 0, &tv) <= 0) return -1;
+    
+    if ((len = ops->poll(device_transport, &device_link, &sets, &eb_check_sets, &buf[got], 8-got)) < 0) return -1;
+  }
+  
+  if (buf[0] != 0x4E || buf[1] != 0x6F || (buf[2] & EB_HEADER_PR) == 0) return -1;
+  
+  device_widths = eb_width_refine(buf[3] & (EB_ADDRX|EB_DATAX));
+  if (!eb_width_possible(device_widths)) return -1;
+  
+  /* Alignment is either 2, 4, or 8. */
+  biggest = (device_widths >> 4) | (device_widths & EB_DATAX);
+  alignment = 2;
+  alignment += (biggest >= EB_DATA32)*2;
+  alignment += (biggest >= EB_DATA64)*4;
+  record_alignment = 4;
+  record_alignment += (biggest >= EB_DATA64)*4;
+  
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  struct eb_block_sets sets;
+  struct eb_transport_ops* ops;
+  struct eb_client* client;
+  struct eb_buffer batch, device_in;
+  struct eb_link* link;
+  eb_status_t status;
+  uint8_t buffer[65536];
+  const char* port;
+  const char* address;
+  unsigned int t;
+  struct timeval zero;
+  int opt, error, i, j, len, rr, progress, sock, busy;
+  
+  /* Default arguments */
+  program = argv[0];
+  verbose = 0;
+  error = 0;
+  
+  /* Process the command-line arguments */
+  while ((opt = getopt(argc, argv, "vh")) != -1) {
+    switch (opt) {
+    case 'v':
+      verbose = 1;
+      break;
+    case 'h':
+      help();
+      return 1;
+    case ':':
+    case '?':
+      error = 1;
+      break;
+    default:
+      fprintf(stderr, "%s: bad getopt result\n", program);
+      return 1;
+    }
+  }
+  
+  if (error) return 1;
+  
+  if (optind + 2 != argc) {
+    fprintf(stderr, "%s: expecting two non-optional arguments: <port> <proto/host/port>\n", program);
+    return 1;
+  }
+  
+  port = argv[optind];
+  address = argv[optind+1];
+  
+  transports = (struct eb_transport*)calloc(eb_transport_size, sizeof(struct eb_transport));
+  listening = (int*)calloc(eb_transport_size, sizeof(int));
+  if (transports == 0 || listening == 0) {
+    fprintf(stderr, "%s: out of memory\n", program);
+    return 1;
+  }
+  
+  /* Clients may use any streaming transport */
+  for (t = 0; t < eb_transport_size; ++t) {
+    transports[t].link_type = t;
+    if (eb_transports[t].mtu != 0) continue;
+    
+    status = eb_transports[t].open(&transports[t], port);
+    if (status == EB_ADDRESS) continue;
+    if (status != EB_OK) {
+      fprintf(stderr, "%s: failed to listen on port %s\n", program, port);
+      return 1;
+    }
+    listening[t] = 1;
+  }
+  
+  /* The device must be a streaming link as well */
+  status = EB_ADDRESS;
+  for (t = 0; t < eb_transport_size; ++t) {
+    if (!listening[t]) continue;
+    status = eb_transports[t].connect(&transports[t], &device_link, address, 0);
+    if (status != EB_ADDRESS) break;
+  }
+  
+  if (status != EB_OK) {
+    fprintf(stderr, "%s: failed to open %s (must be a streaming link)\n", program, address);
+    return 1;
+  }
+  device_transport = &transports[t];
+  
+  if (eb_device_probe() != 0) {
+    fprintf(stderr, "%s: %s did not answer the width probe\n", program, address);
+    return 1;
+  }
+  
+  if (verbose) fprintf(stdout, "Serving %s (widths 0x%02x) on port %s\n", address, device_widths, port);
+  
+  memset(&batch, 0, sizeof(batch));
+  memset(&device_in, 0, sizeof(device_in));
+  route_owner = -1;
+  route_open = 0;
+  rr = 0;
+  
+  while (1) {
+    /* Block for a link to go active: */
+    FD_ZERO(&sets.rfds);
+    FD_ZERO(&sets.wfds);
+    sets.nfd = 0;
+    
+    ops = &eb_transports[device_transport->link_type];
+    ops->fdes(device_transport, &device_link, &sets, &eb_update_sets);
+    
+    for (t = 0; t < eb_transport_size; ++t)
+      if (listening[t]) eb_transports[t].fdes(&transports[t], 0, &sets, &eb_update_sets);
+    
+    busy = 0;
+    for (i = 0; i < MAX_CLIENTS; ++i) {
+      client = &clients[i];
+      if (!client->active) continue;
+      
+      if (eb_client_reading(client))
+        eb_transports[client->transport->link_type].fdes(client->transport, &client->link, &sets, &eb_update_sets);
+      
+      /* Wait for room to send the rest of its responses */
+      if (client->out.used > 0 && (sock = eb_client_socket(client)) != -1)
+        eb_update_sets(&sets, sock, EB_DESCRIPTOR_OUT);
+      
+      /* Cycles left over from the last batch need no wake-up */
+      if (eb_client_ready(client) || (client->unread && eb_client_reading(client))) busy = 1;
+    }
+    
+    zero.tv_sec = 0;
+    zero.tv_usec = 0;
+    select(sets.nfd+1, &sets.rfds, &sets.wfds, 0, busy ? &zero : 0);
+    
+    /* New clients? */
+    for (t = 0; t < eb_transport_size; ++t) {
+      if (!listening[t]) continue;
+      
+      do {
+        for (i = 0; i < MAX_CLIENTS && clients[i].active; ++i) { }
+        link = (i == MAX_CLIENTS) ? 0 : &clients[i].link; /* 0 => refuse */
+        
+        if ((len = eb_transports[t].accept(&transports[t], link, &sets, &eb_check_sets)) > 0) {
+          client = &clients[i];
+          client->active = 1;
+          client->probed = 0;
+          client->generation++;
+          client->transport = &transports[t];
+          client->scanned = 0;
+          client->complete = 0;
+          client->unread = 0;
+          memset(&client->in, 0, sizeof(client->in));
+          memset(&client->out, 0, sizeof(client->out));
+          if (verbose) fprintf(stdout, "Client %d connected\n", i);
+        }
+      } while (len > 0);
+    }
+    
+    /* Collect cycles from the clients */
+    for (i = 0; i < MAX_CLIENTS; ++i) {
+      client = &clients[i];
+      if (!client->active || !eb_client_reading(client)) continue;
+      
+      ops = &eb_transports[client->transport->link_type];
+      do {
+        len = ops->poll(client->transport, &client->link, &sets, &eb_check_sets, &buffer[0], sizeof(buffer));
+        if (len > 0) eb_buffer_append(&client->in, &buffer[0], len);
+      } while (len > 0 && client->in.used < BATCH_LIMIT);
+      client->unread = (len > 0); /* its descriptor may not wake us for the rest */
+      
+      if (len < 0 || eb_client_scan(client) != 0)
+        eb_client_drop(i);
+    }
+    
+    /* One cycle per client per round, until the batch is full */
+    batch.used = 0;
+    do {
+      progress = 0;
+      for (j = 0; j < MAX_CLIENTS && batch.used < BATCH_LIMIT; ++j) {
+        i = (rr + j) % MAX_CLIENTS;
+        if (eb_client_ready(&clients[i])) {
+          eb_client_take(i, &batch);
+          progress = 1;
+        }
+      }
+    } while (progress && batch.used < BATCH_LIMIT);
+    rr = (rr + 1) % MAX_CLIENTS;
+    
+    if (batch.used > 0) {
+      ops = &eb_transports[device_transport->link_type];
+      ops->send_buffer(device_transport, &device_link, 1);
+      ops->send(device_transport, &device_link, batch.data, batch.used);
+      ops->send_buffer(device_transport, &device_link, 0);
+    }
+    
+    /* Route responses */
+    ops = &eb_transports[device_transport->link_type];
+    while ((len = ops->poll(device_transport, &device_link, &sets, &eb_check_sets, &buffer[0], sizeof(buffer))) > 0)
+      eb_buffer_append(&device_in, &buffer[0], len);
+    
+    if (len < 0) {
+      fprintf(stderr, "%s: lost connection to %s\n", program, address);
+      return 1;
+    }
+    
+    eb_device_route(&device_in);
+    
+    for (i = 0; i < MAX_CLIENTS; ++i)
+      if (clients[i].active) eb_client_flush(i);
+  }
+  
+  return 1;
+}
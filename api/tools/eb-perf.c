@@ -0,0 +1,469 @@
+/** @file eb-perf.c
+ *  @brief A tool for measuring the throughput and latency of a device.
+ *
+ *  Copyright (C) 2026 GSI Helmholtz Centre for Heavy Ion Research GmbH
+ *
+ *  Sweeps the shape of the cycles sent to a device and reports the
+ *  bandwidth, operation rate and latency percentiles of each.
+ *
+ *  @author Etherbone Core Developers <etherbone-core@ohwr.org>
+ *
+ *  @bug None!
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define _POSIX_C_SOURCE 200112L /* strtoull + getopt + clock_gettime */
+#define _ISOC99_SOURCE /* strtoull on old systems */
+
+#include <unistd.h> /* getopt */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../etherbone.h"
+
+#define MAX_SWEEP 16
+
+static const char* program;
+static eb_width_t address_width, data_width;
+static eb_address_t address, window;
+static eb_format_t endian;
+static int verbose, quiet;
+
+static void help(void) {
+  fprintf(stderr, "Usage: %s [OPTION] <proto/host/port> <address/size>\n", program);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Measures cycles of every combination of the lists below against\n");
+  fprintf(stderr, "the size bytes starting at address. Writes clobber that range!\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -a <width>     acceptable address bus widths     (8/16/32/64)\n");
+  fprintf(stderr, "  -d <width>     acceptable data bus widths        (8/16/32/64)\n");
+  fprintf(stderr, "  -b             big-endian operation                    (auto)\n");
+  fprintf(stderr, "  -l             little-endian operation                 (auto)\n");
+  fprintf(stderr, "  -r <retries>   number of times to attempt autonegotiation (3)\n");
+  fprintf(stderr, "  -s <sizes>     bytes per operation                (widest)\n");
+  fprintf(stderr, "  -o <counts>    operations per cycle                (1,16,64)\n");
+  fprintf(stderr, "  -w <percents>  percentage of operations which write     (0)\n");
+  fprintf(stderr, "  -m <modes>     addressing: inc and/or fifo              (inc)\n");
+  fprintf(stderr, "  -i <depths>    cycles in flight                      (1,16)\n");
+  fprintf(stderr, "  -n <cycles>    cycles per measurement                (1000)\n");
+  fprintf(stderr, "  -j             print each measurement as a line of JSON\n");
+  fprintf(stderr, "  -p             disable self-describing wishbone device probe\n");
+  fprintf(stderr, "  -v             verbose operation\n");
+  fprintf(stderr, "  -q             quiet: do not display warnings\n");
+  fprintf(stderr, "  -h             display this help and exit\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Report Etherbone bugs to <etherbone-core@ohwr.org>\n");
+  fprintf(stderr, "Version: %s\n%s\nLicensed under the LGPL v3.\n", eb_source_version(), eb_build_info());
+}
+
+/* Parse a comma separated list of numbers */
+static int parse_list(const char* arg, long* out, long min, long max) {
+  char* end;
+  int n;
+
+  for (n = 0; n < MAX_SWEEP; ++n) {
+    out[n] = strtol(arg, &end, 0);
+    if (end == arg || out[n] < min || out[n] > max) return 0;
+    if (*end == 0) return n+1;
+    if (*end != ',') return 0;
+    arg = end+1;
+  }
+
+  return 0;
+}
+
+static double now_us(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec*1e6 + ts.tv_nsec/1e3;
+}
+
+static int compare_double(const void* a, const void* b) {
+  double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+/* One measurement in progress */
+static double* latency;
+static double* sent;
+static int busy, done, errors, segfaults;
+
+static void complete(eb_user_data_t user, eb_device_t dev, eb_operation_t op, eb_status_t status) {
+  int index = (int)(long)user;
+
+  latency[done++] = now_us() - sent[index];
+  --busy;
+
+  if (status != EB_OK) {
+    if (errors++ == 0 && !quiet)
+      fprintf(stderr, "%s: warning: etherbone cycle error: %s\n", program, eb_status(status));
+    return;
+  }
+
+  for (; op != EB_NULL; op = eb_operation_next(op))
+    if (eb_operation_had_error(op)) ++segfaults;
+}
+
+static void measure(eb_socket_t socket, eb_device_t device, int cycles, eb_format_t size, int ops, int writes, int fifo, int depth, int json) {
+  eb_status_t status;
+  eb_cycle_t cycle;
+  eb_address_t offset;
+  double start, seconds, p50, p99, p999;
+  int i, j, wcount;
+
+  busy = done = errors = segfaults = 0;
+  offset = 0;
+  wcount = 0;
+
+  start = now_us();
+  for (i = 0; i < cycles; ++i) {
+    while (busy >= depth)
+      eb_socket_run(socket, -1);
+
+    if ((status = eb_cycle_open(device, (eb_user_data_t)(long)i, &complete, &cycle)) != EB_OK) {
+      fprintf(stderr, "%s: cannot create cycle: %s\n", program, eb_status(status));
+      exit(1);
+    }
+
+    for (j = 0; j < ops; ++j) {
+      /* Spread the writes evenly over the operations */
+      wcount += writes;
+      if (wcount >= 100) {
+        wcount -= 100;
+        eb_cycle_write(cycle, address + offset, endian | size, (eb_data_t)j);
+      } else {
+        eb_cycle_read(cycle, address + offset, endian | size, 0);
+      }
+
+      if (!fifo) {
+        offset += size;
+        if (offset + size > window) offset = 0;
+      }
+    }
+
+    sent[i] = now_us();
+    eb_cycle_close(cycle);
+    ++busy;
+  }
+
+  while (busy > 0)
+    eb_socket_run(socket, -1);
+
+  seconds = (now_us() - start) / 1e6;
+
+  qsort(latency, cycles, sizeof(double), &compare_double);
+  p50  = latency[(long)cycles*500/1000];
+  p99  = latency[(long)cycles*990/1000];
+  p999 = latency[(long)cycles*999/1000];
+
+  if (json) {
+    fprintf(stdout, "{\"size\": %d, \"ops\": %d, \"writes\": %d, \"mode\": \"%s\", \"depth\": %d, "
+                    "\"cycles\": %d, \"seconds\": %.6f, \"bytes_per_s\": %.0f, \"ops_per_s\": %.0f, "
+                    "\"p50_us\": %.2f, \"p99_us\": %.2f, \"p999_us\": %.2f, \"errors\": %d, \"segfaults\": %d}\n",
+                    (int)size, ops, writes, fifo?"fifo":"inc", depth,
+                    cycles, seconds, (double)cycles*ops*size/seconds, (double)cycles*ops/seconds,
+                    p50, p99, p999, errors, segfaults);
+  } else {
+    fprintf(stdout, "%4d %5d %4d%% %4s %5d %10.3f %10.1f %9.1f %9.1f %9.1f %6d\n",
+                    (int)size, ops, writes, fifo?"fifo":"inc", depth,
+                    (double)cycles*ops*size/seconds/1e6, (double)cycles*ops/seconds/1e3,
+                    p50, p99, p999, errors+segfaults);
+  }
+  fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+  long value;
+  char* value_end;
+  int opt, error;
+
+  eb_socket_t socket;
+  eb_status_t status;
+  eb_device_t device;
+  eb_width_t line_width;
+  eb_format_t line_widths;
+  eb_format_t device_support;
+  eb_format_t op_sizes;
+
+  /* Specific command-line options */
+  long sizes[MAX_SWEEP], ops[MAX_SWEEP], writes[MAX_SWEEP], modes[MAX_SWEEP], depths[MAX_SWEEP];
+  int nsizes, nops, nwrites, nmodes, ndepths;
+  int attempts, probe, cycles, json;
+  int s, o, w, m, i;
+  const char* netaddress;
+  char* mode;
+
+  /* Default arguments */
+  program = argv[0];
+  address_width = EB_ADDRX;
+  data_width = EB_DATAX;
+  endian = 0; /* auto-detect */
+  attempts = 3;
+  probe = 1;
+  quiet = 0;
+  verbose = 0;
+  error = 0;
+  cycles = 1000;
+  json = 0;
+  nsizes = 0; /* widest */
+  ops[0] = 1; ops[1] = 16; ops[2] = 64; nops = 3;
+  writes[0] = 0; nwrites = 1;
+  modes[0] = 0; nmodes = 1;
+  depths[0] = 1; depths[1] = 16; ndepths = 2;
+
+  /* Process the command-line arguments */
+  while ((opt = getopt(argc, argv, "a:d:blr:s:o:w:m:i:n:jpvqh")) != -1) {
+    switch (opt) {
+    case 'a':
+      value = eb_width_parse_address(optarg, &address_width);
+      if (value != EB_OK) {
+        fprintf(stderr, "%s: invalid address width -- '%s'\n", program, optarg);
+        error = 1;
+      }
+      break;
+    case 'd':
+      value = eb_width_parse_data(optarg, &data_width);
+      if (value != EB_OK) {
+        fprintf(stderr, "%s: invalid data width -- '%s'\n", program, optarg);
+        error = 1;
+      }
+      break;
+    case 'b':
+      endian = EB_BIG_ENDIAN;
+      break;
+    case 'l':
+      endian = EB_LITTLE_ENDIAN;
+      break;
+    case 'r':
+      value = strtol(optarg, &value_end, 0);
+      if (*value_end || value < 0 || value > 100) {
+        fprintf(stderr, "%s: invalid number of retries -- '%s'\n", program, optarg);
+        return 1;
+      }
+      attempts = value;
+      break;
+    case 's':
+      nsizes = parse_list(optarg, sizes, 1, 8);
+      for (i = 0; i < nsizes; ++i)
+        if ((sizes[i] & (sizes[i]-1)) != 0) nsizes = 0;
+      if (nsizes == 0) {
+        fprintf(stderr, "%s: invalid operation sizes -- '%s'\n", program, optarg);
+        error = 1;
+      }
+      break;
+    case 'o':
+      if ((nops = parse_list(optarg, ops, 1, 1000)) == 0) {
+        fprintf(stderr, "%s: invalid operation counts -- '%s'\n", program, optarg);
+        error = 1;
+      }
+      break;
+    case 'w':
+      if ((nwrites = parse_list(optarg, writes, 0, 100)) == 0) {
+        fprintf(stderr, "%s: invalid write percentages -- '%s'\n", program, optarg);
+        error = 1;
+      }
+      break;
+    case 'm':
+      nmodes = 0;
+      for (mode = strtok(optarg, ","); mode && nmodes < MAX_SWEEP; mode = strtok(0, ",")) {
+        if      (!strcmp(mode, "inc"))  modes[nmodes++] = 0;
+        else if (!strcmp(mode, "fifo")) modes[nmodes++] = 1;
+        else break;
+      }
+      if (mode != 0 || nmodes == 0) {
+        fprintf(stderr, "%s: invalid addressing modes -- '%s'\n", program, optarg);
+        error = 1;
+      }
+      break;
+    case 'i':
+      if ((ndepths = parse_list(optarg, depths, 1, 1000)) == 0) {
+        fprintf(stderr, "%s: invalid depths -- '%s'\n", program, optarg);
+        error = 1;
+      }
+      break;
+    case 'n':
+      value = strtol(optarg, &value_end, 0);
+      if (*value_end || value < 1 || value > 10000000) {
+        fprintf(stderr, "%s: invalid cycle count -- '%s'\n", program, optarg);
+        return 1;
+      }
+      cycles = value;
+      break;
+    case 'j':
+      json = 1;
+      break;
+    case 'p':
+      probe = 0;
+      break;
+    case 'v':
+      verbose = 1;
+      break;
+    case 'q':
+      quiet = 1;
+      break;
+    case 'h':
+      help();
+      return 1;
+    case ':':
+    case '?':
+      error = 1;
+      break;
+    default:
+      fprintf(stderr, "%s: bad getopt result\n", program);
+      return 1;
+    }
+  }
+
+  if (error) return 1;
+
+  if (optind + 2 != argc) {
+    fprintf(stderr, "%s: expecting two non-optional arguments: <proto/host/port> <address/size>\n", program);
+    return 1;
+  }
+
+  netaddress = argv[optind];
+
+  address = strtoull(argv[optind+1], &value_end, 0);
+  if (*value_end == '/')
+    window = strtoull(value_end+1, &value_end, 0);
+  else
+    window = 0;
+  if (*value_end != 0 || window == 0) {
+    fprintf(stderr, "%s: argument does not match format <address>/<size> -- '%s'\n",
+                    program, argv[optind+1]);
+    return 1;
+  }
+
+  if ((latency = (double*)malloc(cycles * sizeof(double))) == 0 ||
+      (sent    = (double*)malloc(cycles * sizeof(double))) == 0) {
+    fprintf(stderr, "%s: out of memory\n", program);
+    return 1;
+  }
+
+  if (verbose)
+    fprintf(stdout, "Opening socket with %s-bit address and %s-bit data widths\n",
+                    eb_width_address(address_width), eb_width_data(data_width));
+
+  if ((status = eb_socket_open(EB_ABI_CODE, 0, address_width|data_width, &socket)) != EB_OK) {
+    fprintf(stderr, "%s: failed to open Etherbone socket: %s\n", program, eb_status(status));
+    return 1;
+  }
+
+  if (verbose)
+    fprintf(stdout, "Connecting to '%s' with %d retry attempts...\n", netaddress, attempts);
+
+  if ((status = eb_device_open(socket, netaddress, EB_ADDRX|EB_DATAX, attempts, &device)) != EB_OK) {
+    fprintf(stderr, "%s: failed to open Etherbone device: %s\n", program, eb_status(status));
+    return 1;
+  }
+
+  line_width = eb_device_width(device);
+  if (verbose)
+    fprintf(stdout, "  negotiated %s-bit address and %s-bit data session.\n",
+                    eb_width_address(line_width), eb_width_data(line_width));
+
+  if (probe) {
+    struct sdb_device info;
+
+    if (verbose)
+      fprintf(stdout, "Scanning remote bus for Wishbone devices...\n");
+
+    if ((status = eb_sdb_find_by_address(device, address, &info)) != EB_OK) {
+      fprintf(stderr, "%s: failed to find SDB record: %s\n", program, eb_status(status));
+      return 1;
+    }
+
+    if ((info.bus_specific & SDB_WISHBONE_LITTLE_ENDIAN) != 0)
+      device_support = EB_LITTLE_ENDIAN;
+    else
+      device_support = EB_BIG_ENDIAN;
+    device_support |= info.bus_specific & EB_DATAX;
+
+    if (address + window - 1 > info.sdb_component.addr_last && !quiet)
+      fprintf(stderr, "%s: warning: range extends past the end of the device at 0x%"EB_ADDR_FMT".\n",
+                      program, (eb_address_t)info.sdb_component.addr_last);
+  } else {
+    device_support = endian | EB_DATAX;
+  }
+
+  /* Did the user request a bad endian? We use it anyway, but issue warning. */
+  if (endian != 0 && (device_support & EB_ENDIAN_MASK) != endian) {
+    if (!quiet)
+      fprintf(stderr, "%s: warning: target device is %s (accessing as %s).\n",
+                      program, eb_format_endian(device_support), eb_format_endian(endian));
+  }
+
+  if (endian == 0) {
+    /* Select the probed endian. May still be 0 if device not found. */
+    endian = device_support & EB_ENDIAN_MASK;
+  }
+
+  /* Operations must suit both the device and the line */
+  line_widths = ((line_width & EB_DATAX) << 1) - 1;
+  op_sizes = line_widths & device_support;
+
+  if (op_sizes == 0) {
+    fprintf(stderr, "%s: error: device's %s-bit data port cannot be used via a %s-bit wire format\n",
+                    program, eb_width_data(device_support), eb_width_data(line_width));
+    return 1;
+  }
+
+  /* Default to the widest operation */
+  if (nsizes == 0) {
+    sizes[0] = op_sizes;
+    sizes[0] |= sizes[0] >> 1;
+    sizes[0] |= sizes[0] >> 2;
+    sizes[0] ^= sizes[0] >> 1;
+    nsizes = 1;
+  }
+
+  if (!json)
+    fprintf(stdout, "size   ops  wr%% mode depth       MB/s      kop/s   p50(us)   p99(us)  p999(us) errors\n");
+
+  for (s = 0; s < nsizes; ++s) {
+    if ((sizes[s] & op_sizes) == 0 || (sizes[s] != (line_width & EB_DATAX) && endian == 0)) {
+      if (!quiet)
+        fprintf(stderr, "%s: warning: skipping unsupported %s-bit operations\n", program, eb_width_data(sizes[s]));
+      continue;
+    }
+    if ((address & (sizes[s]-1)) != 0 || (eb_address_t)sizes[s] > window) {
+      if (!quiet)
+        fprintf(stderr, "%s: warning: skipping %s-bit operations; range is unaligned or too small\n", program, eb_width_data(sizes[s]));
+      continue;
+    }
+
+    for (o = 0; o < nops; ++o)
+      for (w = 0; w < nwrites; ++w)
+        for (m = 0; m < nmodes; ++m)
+          for (i = 0; i < ndepths; ++i)
+            measure(socket, device, cycles, sizes[s], ops[o], writes[w], modes[m], depths[i], json);
+  }
+
+  if ((status = eb_device_close(device)) != EB_OK) {
+    fprintf(stderr, "%s: failed to close Etherbone device: %s\n", program, eb_status(status));
+    return 1;
+  }
+
+  if ((status = eb_socket_close(socket)) != EB_OK) {
+    fprintf(stderr, "%s: failed to close Etherbone socket: %s\n", program, eb_status(status));
+    return 1;
+  }
+
+  return 0;
+}
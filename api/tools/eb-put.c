@@ -51,6 +51,7 @@ static void help(void) {
   fprintf(stderr, "  -a <width>     acceptable address bus widths     (8/16/32/64)\n");
   fprintf(stderr, "  -d <width>     acceptable data bus widths        (8/16/32/64)\n");
   fprintf(stderr, "  -c <cycles>    cycles to pack per packet               (auto)\n");
+  fprintf(stderr, "  -w <cycles>    adapt the cycles in flight, up to this many (udp)\n");
   fprintf(stderr, "  -b             big-endian operation                    (auto)\n");
   fprintf(stderr, "  -l             little-endian operation                 (auto)\n");
   fprintf(stderr, "  -r <retries>   number of times to attempt autonegotiation (3)\n");
@@ -165,7 +166,7 @@ int main(int argc, char** argv) {
   eb_address_t end_address, end_bulk, step, pos;
   
   /* Specific command-line options */
-  int attempts, probe, cycles;
+  int attempts, probe, cycles, window;
   const char* netaddress;
   eb_address_t firmware_length;
 
@@ -175,6 +176,7 @@ int main(int argc, char** argv) {
   data_width = EB_DATAX;
   endian = 0; /* auto-detect */
   attempts = 3;
+  window = 0;
   probe = 1;
   quiet = 0;
   verbose = 0;
@@ -183,7 +185,7 @@ int main(int argc, char** argv) {
   force = 0;
   
   /* Process the command-line arguments */
-  while ((opt = getopt(argc, argv, "a:d:c:blr:fpvqh")) != -1) {
+  while ((opt = getopt(argc, argv, "a:d:c:w:blr:fpvqh")) != -1) {
     switch (opt) {
     case 'a':
       value = eb_width_parse_address(optarg, &address_width);
@@ -207,6 +209,14 @@ int main(int argc, char** argv) {
       }
       cycles = value;
       break;
+    case 'w':
+      value = strtol(optarg, &value_end, 0);
+      if (*value_end || value < 0 || value > 10000) {
+        fprintf(stderr, "%s: invalid window -- '%s'\n", program, optarg);
+        return 1;
+      }
+      window = value;
+      break;
     case 'b':
       endian = EB_BIG_ENDIAN;
       break;
@@ -295,6 +305,11 @@ int main(int argc, char** argv) {
     return 1;
   }
   
+  if (window != 0 && (status = eb_device_window(device, window)) != EB_OK) {
+    fprintf(stderr, "%s: failed to set the window: %s\n", program, eb_status(status));
+    return 1;
+  }
+  
   line_width = eb_device_width(device);
   if (verbose)
     fprintf(stdout, "  negotiated %s-bit address and %s-bit data session.\n", 
@@ -440,8 +455,16 @@ int main(int argc, char** argv) {
     /* Flush? */
     if (++cycle == cycles) {
       cycle = 0;
-      while (todo > 0) {
-        eb_socket_run(socket, -1);
+      if (window != 0) {
+        /* The device sends what its window allows; keep it full */
+        eb_socket_run(socket, 0);
+        while (todo >= window) {
+          eb_socket_run(socket, -1);
+        }
+      } else {
+        while (todo > 0) {
+          eb_socket_run(socket, -1);
+        }
       }
     }
   }
@@ -0,0 +1,548 @@
+/** @file eb-replay.c
+ *  @brief A tool for replaying a capture of Etherbone traffic.
+ *
+ *  Copyright (C) 2026 GSI Helmholtz Centre for Heavy Ion Research GmbH
+ *
+ *  Reads a pcap file written by eb_socket_capture and sends its requests
+ *  to a device again, at their original pace or as fast as the target
+ *  answers. Each reply is matched to its request by the address the
+ *  request asked to be answered at, giving the latency of every packet.
+ *
+ *  @author Etherbone Core Developers <etherbone-core@ohwr.org>
+ *
+ *  @bug None!
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define _POSIX_C_SOURCE 200112L /* strtoull + getopt + clock_gettime */
+#define _ISOC99_SOURCE /* strtoull on old systems */
+
+#include "../transport/posix-udp.h"
+#include "../glue/capture.h"
+#include "../format/format.h"
+
+#include <unistd.h> /* getopt */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define PROBE_KEY (1ULL << 63) /* keys of probes are their tags */
+#define MAX_WAITING 65536      /* requests awaiting their reply */
+
+/* A request of the capture */
+struct request {
+  uint64_t time;   /* nanoseconds after the first request */
+  uint64_t key;    /* address its reply is written to */
+  int answered;    /* does it expect a reply? */
+  int direction;   /* EB_CAPTURE_SENT or EB_CAPTURE_RECEIVED */
+  int len;
+  uint8_t* data;
+};
+
+/* A request sent, awaiting its reply */
+struct waiting {
+  uint64_t key;
+  uint64_t sent;
+  int done;
+};
+
+static const char* program;
+static struct request* requests;
+static long nrequests, skipped_streams;
+static struct waiting waiting[MAX_WAITING];
+static long oldest, newest; /* indexes into waiting, modulo MAX_WAITING */
+static double* latency;
+static long nlatency, lost, unexpected;
+
+static void help(void) {
+  fprintf(stderr, "Usage: %s [OPTION] <capture.pcap> <proto/host/port>\n", program);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Sends the requests recorded by eb_socket_capture (eg: eb-snoop -c)\n");
+  fprintf(stderr, "to the target and measures how long each takes to be answered.\n");
+  fprintf(stderr, "Write requests are replayed too, so only use a target which may be written!\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -D <dir>       replay requests sent or received by the socket    (auto)\n");
+  fprintf(stderr, "  -e <device>    replay only the requests of this device (see -l)  (all)\n");
+  fprintf(stderr, "  -l             list the devices of the capture and exit\n");
+  fprintf(stderr, "  -s <speed>     replay this many times faster than recorded       (1.0)\n");
+  fprintf(stderr, "  -x             replay as fast as the target answers\n");
+  fprintf(stderr, "  -i <depth>     requests awaiting a reply with -x                  (16)\n");
+  fprintf(stderr, "  -t <timeout>   milliseconds to wait for a reply                   (100)\n");
+  fprintf(stderr, "  -r <repeat>    replay the capture this many times                   (1)\n");
+  fprintf(stderr, "  -j             print the result as a line of JSON\n");
+  fprintf(stderr, "  -h             display this help and exit\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Only datagram (udp) traffic can be replayed.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Report Etherbone bugs to <etherbone-core@ohwr.org>\n");
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+static uint32_t swap32(uint32_t x, int swap) {
+  if (!swap) return x;
+  return (x >> 24) | ((x >> 8) & 0xFF00) | ((x << 8) & 0xFF0000) | (x << 24);
+}
+
+static uint64_t load(const uint8_t* p, int bytes) {
+  uint64_t x;
+  int i;
+  
+  x = 0;
+  for (i = 0; i < bytes; ++i) x = (x << 8) | p[i];
+  return x;
+}
+
+/* Find the key of a packet: for a request, the address its first reads are
+ * answered at; for a reply, the address its first writes go to.
+ * Returns 1 if the packet is a request, 0 if it is a reply, -1 if neither.
+ */
+static int classify(const uint8_t* buf, int len, uint64_t* key, int* answered) {
+  int alignment, record_alignment, ptr, request, written;
+  uint64_t wkey;
+  uint8_t widths, biggest, flags, wcount, rcount;
+  
+  if (len < 4 || buf[0] != 0x4E || buf[1] != 0x6F) return -1;
+  
+  if ((buf[2] & (EB_HEADER_PF|EB_HEADER_PR)) != 0) {
+    if (len != 8) return -1;
+    *key = PROBE_KEY | load(buf+4, 4);
+    *answered = 1;
+    return (buf[2] & EB_HEADER_PF) != 0;
+  }
+  
+  widths = buf[3];
+  biggest = (widths >> 4) | (widths & EB_DATAX);
+  alignment = 2;
+  alignment += (biggest >= EB_DATA32)*2;
+  alignment += (biggest >= EB_DATA64)*4;
+  record_alignment = 4;
+  record_alignment += (biggest >= EB_DATA64)*4;
+  
+  /* Replies only write, into the config space of the requester */
+  request = 0;
+  written = 0;
+  wkey = 0;
+  *key = 0;
+  *answered = 0;
+  
+  for (ptr = record_alignment; ptr + record_alignment <= len; ) {
+    flags  = buf[ptr];
+    wcount = buf[ptr+2];
+    rcount = buf[ptr+3];
+    ptr += record_alignment;
+    
+    if (rcount > 0 || (wcount > 0 && (flags & EB_RECORD_WCA) == 0)) request = 1;
+    
+    if (wcount > 0) {
+      if (ptr + alignment > len) return -1;
+      if (!written) wkey = load(buf+ptr, alignment) & ~(uint64_t)1;
+      written = 1;
+      ptr += alignment * (1 + wcount);
+    }
+    
+    if (rcount > 0) {
+      if (ptr + alignment > len) return -1;
+      if (*answered == 0) *key = load(buf+ptr, alignment) & ~(uint64_t)1; /* status reads go to +1 */
+      *answered = 1;
+      ptr += alignment * (1 + rcount);
+    }
+  }
+  
+  if (!request) *key = wkey;
+  return request;
+}
+
+/* Read the capture, keeping the requests of one direction and device */
+static int load_capture(const char* filename, int direction, int list, int filter, uint32_t device) {
+  struct eb_capture_file file;
+  struct eb_capture_record record;
+  struct eb_capture_info* info;
+  uint8_t* data;
+  uint64_t time, key;
+  uint32_t caplen, dev;
+  int swap, nano, answered, type;
+  long capacity, counts[2];
+  FILE* f;
+  
+  if ((f = fopen(filename, "rb")) == 0) {
+    perror(filename);
+    return -1;
+  }
+  
+  if (fread(&file, sizeof(file), 1, f) != 1) {
+    fprintf(stderr, "%s: %s: not a pcap file\n", program, filename);
+    return -1;
+  }
+  
+  swap = 0;
+  nano = 1;
+  if      (file.magic == EB_CAPTURE_MAGIC)                 { }
+  else if (file.magic == EB_CAPTURE_MAGIC_US)              { nano = 0; }
+  else if (swap32(file.magic, 1) == EB_CAPTURE_MAGIC)      { swap = 1; }
+  else if (swap32(file.magic, 1) == EB_CAPTURE_MAGIC_US)   { swap = 1; nano = 0; }
+  else {
+    fprintf(stderr, "%s: %s: not a pcap file\n", program, filename);
+    return -1;
+  }
+  
+  if (swap32(file.linktype, swap) != EB_CAPTURE_LINKTYPE) {
+    fprintf(stderr, "%s: %s: not written by eb_socket_capture\n", program, filename);
+    return -1;
+  }
+  
+  capacity = 0;
+  counts[0] = counts[1] = 0;
+  
+  while (fread(&record, sizeof(record), 1, f) == 1) {
+    caplen = swap32(record.caplen, swap);
+    if (caplen < sizeof(struct eb_capture_info) || caplen > EB_CAPTURE_SNAPLEN) break;
+    
+    if ((data = (uint8_t*)malloc(caplen)) == 0 || fread(data, 1, caplen, f) != caplen) break;
+    
+    info = (struct eb_capture_info*)data;
+    time = (uint64_t)swap32(record.sec, swap)*1000000000 + 
+           (uint64_t)swap32(record.nsec, swap)*(nano ? 1 : 1000);
+    dev = ((uint32_t)info->device[0] << 24) | ((uint32_t)info->device[1] << 16) |
+          ((uint32_t)info->device[2] << 8)  |  (uint32_t)info->device[3];
+    
+    type = info->stream ? -1 : classify(data + sizeof(*info), caplen - sizeof(*info), &key, &answered);
+    
+    if (list) {
+      if (type == 1) printf("%-8s device %08"PRIx32"  %s\n",
+                            info->direction == EB_CAPTURE_SENT ? "sent" : "received", dev,
+                            answered ? "answered" : "unanswered");
+      free(data);
+      continue;
+    }
+    
+    if (info->stream) ++skipped_streams;
+    
+    if (type == 1 && info->direction <= 1) ++counts[info->direction];
+    
+    if (type != 1 || (filter && dev != device)) {
+      free(data);
+      continue;
+    }
+    
+    if (nrequests == capacity) {
+      capacity = capacity ? capacity*2 : 1024;
+      if ((requests = (struct request*)realloc(requests, capacity*sizeof(struct request))) == 0) {
+        fprintf(stderr, "%s: insufficient memory for the capture\n", program);
+        return -1;
+      }
+    }
+    
+    requests[nrequests].time = time;
+    requests[nrequests].key = key;
+    requests[nrequests].answered = answered;
+    requests[nrequests].direction = info->direction;
+    requests[nrequests].len = caplen - sizeof(*info);
+    requests[nrequests].data = data + sizeof(*info);
+    ++nrequests;
+  }
+  
+  fclose(f);
+  
+  if (list) return 0;
+  
+  /* Without a choice, take the side which made the requests */
+  if (direction == -1) direction = (counts[EB_CAPTURE_SENT] >= counts[EB_CAPTURE_RECEIVED]) ? EB_CAPTURE_SENT : EB_CAPTURE_RECEIVED;
+  
+  return direction;
+}
+
+/* Match a reply to the oldest request waiting for it */
+static void receive(const uint8_t* buf, int len) {
+  uint64_t key, now;
+  long i;
+  int answered;
+  
+  if (classify(buf, len, &key, &answered) != 0) {
+    ++unexpected;
+    return;
+  }
+  
+  for (i = oldest; i != newest; ++i) {
+    struct waiting* w = &waiting[i % MAX_WAITING];
+    if (!w->done && w->key == key) break;
+  }
+  
+  if (i == newest) {
+    ++unexpected; /* arrived after its timeout */
+    return;
+  }
+  
+  now = now_ns();
+  waiting[i % MAX_WAITING].done = 1;
+  latency[nlatency++] = (now - waiting[i % MAX_WAITING].sent) / 1e3;
+  
+  while (oldest != newest && waiting[oldest % MAX_WAITING].done) ++oldest;
+}
+
+static void drain(eb_posix_sock_t sock) {
+  uint8_t buf[EB_POSIX_UDP_SLOT];
+  int len;
+  
+  if (sock == -1) return;
+  while ((len = recvfrom(sock, (char*)&buf[0], sizeof(buf), MSG_DONTWAIT, 0, 0)) > 0)
+    receive(buf, len);
+}
+
+static int compare(const void* a, const void* b) {
+  double x = *(const double*)a, y = *(const double*)b;
+  return (x > y) - (x < y);
+}
+
+int main(int argc, char** argv) {
+  struct eb_posix_udp_transport udp_transport;
+  struct eb_transport* transport;
+  struct eb_link udp_link;
+  struct timeval tv;
+  fd_set rfds;
+  eb_status_t status;
+  uint64_t start, stop, now, due, deadline, timeout_ns, base;
+  double speed, seconds;
+  long i, kept, next, repeat, round, depth, sent;
+  int opt, direction, list, filter, fast, json, nfd;
+  uint32_t device;
+  char* value_end;
+  const char* capture;
+  const char* target;
+  
+  program = argv[0];
+  direction = -1;
+  list = 0;
+  filter = 0;
+  device = 0;
+  speed = 1.0;
+  fast = 0;
+  depth = 16;
+  timeout_ns = 100000000;
+  repeat = 1;
+  json = 0;
+  
+  while ((opt = getopt(argc, argv, "D:e:ls:xi:t:r:jh")) != -1) {
+    switch (opt) {
+    case 'D':
+      if (strcmp(optarg, "sent") == 0) direction = EB_CAPTURE_SENT;
+      else if (strcmp(optarg, "received") == 0) direction = EB_CAPTURE_RECEIVED;
+      else {
+        fprintf(stderr, "%s: direction must be sent or received -- '%s'\n", program, optarg);
+        return 1;
+      }
+      break;
+    case 'e':
+      device = strtoul(optarg, &value_end, 16);
+      if (*value_end) {
+        fprintf(stderr, "%s: invalid device -- '%s'\n", program, optarg);
+        return 1;
+      }
+      filter = 1;
+      break;
+    case 'l':
+      list = 1;
+      break;
+    case 's':
+      speed = strtod(optarg, &value_end);
+      if (*value_end || speed <= 0) {
+        fprintf(stderr, "%s: invalid speed -- '%s'\n", program, optarg);
+        return 1;
+      }
+      break;
+    case 'x':
+      fast = 1;
+      break;
+    case 'i':
+      depth = strtol(optarg, &value_end, 0);
+      if (*value_end || depth < 1 || depth > MAX_WAITING) {
+        fprintf(stderr, "%s: invalid depth -- '%s'\n", program, optarg);
+        return 1;
+      }
+      break;
+    case 't':
+      timeout_ns = strtoull(optarg, &value_end, 0) * 1000000;
+      if (*value_end || timeout_ns == 0) {
+        fprintf(stderr, "%s: invalid timeout -- '%s'\n", program, optarg);
+        return 1;
+      }
+      break;
+    case 'r':
+      repeat = strtol(optarg, &value_end, 0);
+      if (*value_end || repeat < 1) {
+        fprintf(stderr, "%s: invalid repeat count -- '%s'\n", program, optarg);
+        return 1;
+      }
+      break;
+    case 'j':
+      json = 1;
+      break;
+    case 'h':
+      help();
+      return 1;
+    case ':':
+    case '?':
+      return 1;
+    default:
+      fprintf(stderr, "%s: bad getopt result\n", program);
+      return 1;
+    }
+  }
+  
+  if (optind + (list ? 1 : 2) != argc) {
+    fprintf(stderr, "%s: expecting %s non-optional arguments: <capture.pcap> <proto/host/port>\n",
+            program, list ? "one" : "two");
+    return 1;
+  }
+  
+  capture = argv[optind];
+  target = list ? 0 : argv[optind+1];
+  
+  if ((direction = load_capture(capture, direction, list, filter, device)) == -1) return 1;
+  if (list) return 0;
+  
+  /* Keep the requests of the chosen direction, timed from the first */
+  kept = 0;
+  for (i = 0; i < nrequests; ++i)
+    if (requests[i].direction == direction)
+      requests[kept++] = requests[i];
+  nrequests = kept;
+  
+  if (nrequests == 0) {
+    fprintf(stderr, "%s: no datagram requests %s in %s\n", program,
+            direction == EB_CAPTURE_SENT ? "sent" : "received", capture);
+    return 1;
+  }
+  
+  base = requests[0].time;
+  for (i = 0; i < nrequests; ++i)
+    requests[i].time = (requests[i].time - base) / speed;
+  
+  if ((latency = (double*)malloc(nrequests * repeat * sizeof(double))) == 0) {
+    fprintf(stderr, "%s: insufficient memory for the results\n", program);
+    return 1;
+  }
+  
+  transport = (struct eb_transport*)&udp_transport;
+  if ((status = eb_posix_udp_open(transport, 0)) != EB_OK) {
+    perror("Cannot open UDP port");
+    return 1;
+  }
+  
+  if ((status = eb_posix_udp_connect(transport, &udp_link, target, 0)) != EB_OK) {
+    fprintf(stderr, "%s: cannot resolve %s\n", program, target);
+    return 1;
+  }
+  
+  if (udp_transport.socket4 != -1) eb_posix_ip_non_blocking(udp_transport.socket4, 1);
+  if (udp_transport.socket6 != -1) eb_posix_ip_non_blocking(udp_transport.socket6, 1);
+  
+  sent = 0;
+  start = now_ns();
+  
+  for (round = 0; round < repeat; ++round) {
+    base = now_ns();
+    next = 0;
+    
+    while (next < nrequests || oldest != newest) {
+      now = now_ns();
+      
+      /* Give up on replies which took too long */
+      while (oldest != newest && (waiting[oldest % MAX_WAITING].done ||
+             now - waiting[oldest % MAX_WAITING].sent > timeout_ns)) {
+        if (!waiting[oldest % MAX_WAITING].done) ++lost;
+        ++oldest;
+      }
+      
+      /* Send every request which is due */
+      due = now;
+      while (next < nrequests) {
+        if (fast) {
+          if (newest - oldest >= depth) break;
+        } else {
+          due = base + requests[next].time;
+          if (due > now || newest - oldest >= MAX_WAITING) break;
+        }
+        
+        eb_posix_udp_send(transport, &udp_link, requests[next].data, requests[next].len);
+        ++sent;
+        
+        if (requests[next].answered) {
+          waiting[newest % MAX_WAITING].key = requests[next].key;
+          waiting[newest % MAX_WAITING].sent = now_ns();
+          waiting[newest % MAX_WAITING].done = 0;
+          ++newest;
+        }
+        ++next;
+      }
+      
+      if (next == nrequests && oldest == newest) break;
+      
+      /* Sleep until a reply, the next request, or the oldest timeout */
+      deadline = now + timeout_ns;
+      if (oldest != newest) deadline = waiting[oldest % MAX_WAITING].sent + timeout_ns;
+      if (!fast && next < nrequests && due < deadline) deadline = due;
+      if (fast && next < nrequests && newest - oldest < depth) deadline = now;
+      
+      now = now_ns();
+      deadline = (deadline > now) ? deadline - now : 0;
+      tv.tv_sec  = deadline / 1000000000;
+      tv.tv_usec = (deadline % 1000000000) / 1000;
+      
+      FD_ZERO(&rfds);
+      nfd = 0;
+      if (udp_transport.socket4 != -1) { FD_SET(udp_transport.socket4, &rfds); nfd = udp_transport.socket4; }
+      if (udp_transport.socket6 != -1) { FD_SET(udp_transport.socket6, &rfds); if (udp_transport.socket6 > nfd) nfd = udp_transport.socket6; }
+      
+      if (select(nfd+1, &rfds, 0, 0, &tv) > 0) {
+        drain(udp_transport.socket4);
+        drain(udp_transport.socket6);
+      }
+    }
+  }
+  
+  stop = now_ns();
+  seconds = (stop - start) / 1e9;
+  
+  qsort(latency, nlatency, sizeof(double), &compare);
+  
+  if (json) {
+    printf("{\"requests\": %ld, \"replies\": %ld, \"lost\": %ld, \"unexpected\": %ld, \"seconds\": %.6f, \"requests_per_s\": %.0f",
+           sent, nlatency, lost, unexpected, seconds, seconds > 0 ? sent/seconds : 0.0);
+    if (nlatency > 0)
+      printf(", \"p50_us\": %.2f, \"p99_us\": %.2f, \"p999_us\": %.2f, \"max_us\": %.2f",
+             latency[nlatency*500/1000], latency[nlatency*990/1000], latency[nlatency*999/1000], latency[nlatency-1]);
+    printf("}\n");
+  } else {
+    if (skipped_streams > 0)
+      fprintf(stderr, "%s: skipped %ld packets of stream transports\n", program, skipped_streams);
+    printf("requests  replies     lost unexpected    seconds  requests/s   p50(us)   p99(us)  p999(us)   max(us)\n");
+    printf("%8ld %8ld %8ld %10ld %10.3f %11.0f", sent, nlatency, lost, unexpected, seconds, seconds > 0 ? sent/seconds : 0.0);
+    if (nlatency > 0)
+      printf(" %9.1f %9.1f %9.1f %9.1f\n",
+             latency[nlatency*500/1000], latency[nlatency*990/1000], latency[nlatency*999/1000], latency[nlatency-1]);
+    else
+      printf("\n");
+  }
+  
+  return 0;
+}
@@ -0,0 +1,1036 @@
+/** @file eb-sim.c
+ *  @brief A fast software slave for load-testing Etherbone masters.
+ *
+ *  Copyright (C) 2026 GSI Helmholtz Centre for Heavy Ion Research GmbH
+ *
+ *  eb-snoop answers through the library socket and is meant for watching
+ *  traffic. eb-sim decodes the UDP datagrams itself: each thread binds its
+ *  own socket to the port with SO_REUSEPORT, so the kernel spreads the
+ *  masters over the threads. Replies may be delayed or dropped on purpose.
+ *
+ *  @author Etherbone Core Developers <etherbone-core@ohwr.org>
+ *
+ *  @bug None!
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define _GNU_SOURCE /* recvmmsg + sendmmsg + SO_REUSEPORT */
+
+#ifdef __linux__
+#define SIM_MMSG 1
+#endif
+
+#include <unistd.h> /* getopt */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+#include "../etherbone.h"
+#define EB_NEED_BIGENDIAN_64 1
+#include "../format/format.h"
+#include "../format/bigendian.h"
+
+#define SIM_SLOT     4096  /* largest datagram answered */
+#define SIM_BATCH    32    /* datagrams moved per system call */
+#define SIM_QUEUE    1024  /* replies each thread may hold back for -L/-J */
+#define SIM_SDB_SIZE 65536 /* address space reserved for the SDB table */
+#define SIM_BUFFER   (4*1024*1024) /* kernel socket buffers */
+
+/* A reply waiting for its injected latency to pass */
+struct sim_reply {
+  uint64_t due; /* CLOCK_MONOTONIC nanoseconds */
+  int sock;
+  int len;
+  socklen_t sa_len;
+  struct sockaddr_storage sa;
+  uint8_t data[SIM_SLOT];
+};
+
+struct sim_counters {
+  uint64_t packets;
+  uint64_t operations;
+  uint64_t dropped;
+  uint64_t misses;
+};
+
+struct sim_thread {
+  pthread_t id;
+  int sock[2]; /* IPv4 and IPv6 */
+  int socks;
+  uint64_t random;
+
+  /* Delayed replies, a binary heap ordered by due */
+  struct sim_reply* pool;
+  struct sim_reply* heap[SIM_QUEUE];
+  struct sim_reply* spare[SIM_QUEUE];
+  int queued;
+
+  /* One batch of requests and their immediate replies */
+  uint8_t rx[SIM_BATCH][SIM_SLOT];
+  uint8_t tx[SIM_BATCH][SIM_SLOT];
+  int rx_len[SIM_BATCH];
+  int tx_len[SIM_BATCH];
+  struct sockaddr_storage sa[SIM_BATCH];
+  socklen_t sa_len[SIM_BATCH];
+
+  struct sim_counters count;  /* private to the thread */
+  struct sim_counters shared; /* published after each batch */
+};
+
+static const char* program;
+static eb_width_t widths;
+static eb_format_t endian;
+static volatile sig_atomic_t stop;
+
+/* The simulated bus */
+static uint8_t* memory;
+static eb_address_t memory_size;
+static eb_address_t sdb_address;
+static uint8_t* sdb_table;
+static int sdb_size;
+
+/* Injected faults */
+static uint64_t latency, jitter; /* nanoseconds */
+static uint64_t drop;            /* out of 2^32 */
+
+static void on_signal(int sig) {
+  stop = 1;
+}
+
+static void help(void) {
+  fprintf(stderr, "Usage: %s [OPTION] <port>\n", program);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Simulates devices of memory behind an Etherbone UDP port.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -a <width>     acceptable address bus widths     (8/16/32/64)\n");
+  fprintf(stderr, "  -d <width>     acceptable data bus widths        (8/16/32/64)\n");
+  fprintf(stderr, "  -b             big-endian operation                (default)\n");
+  fprintf(stderr, "  -l             little-endian operation\n");
+  fprintf(stderr, "  -n <devices>   number of SDB devices                    (1)\n");
+  fprintf(stderr, "  -s <bytes>     memory of each device             (0x100000)\n");
+  fprintf(stderr, "  -f <file>      keep the memory in a file, mapped shared\n");
+  fprintf(stderr, "  -t <threads>   threads sharing the port                 (1)\n");
+  fprintf(stderr, "  -L <us>        delay every reply                        (0)\n");
+  fprintf(stderr, "  -J <us>        vary the delay by up to +/- this         (0)\n");
+  fprintf(stderr, "  -p <percent>   drop this share of the requests          (0)\n");
+  fprintf(stderr, "  -i <seconds>   print the rates at this interval     (never)\n");
+  fprintf(stderr, "  -h             display this help and exit\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Report Etherbone bugs to <etherbone-core@ohwr.org>\n");
+  fprintf(stderr, "Version: %s\n%s\nLicensed under the LGPL v3.\n", eb_source_version(), eb_build_info());
+}
+
+static uint64_t sim_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+}
+
+/* xorshift64*, one generator per thread */
+static uint64_t sim_random(struct sim_thread* thread) {
+  uint64_t x = thread->random;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  thread->random = x;
+  return x * 0x2545F4914F6CDD1DULL;
+}
+
+/* Select the largest width out of possible widths */
+static eb_width_t sim_refine(eb_width_t width) {
+  eb_width_t data = width & 0xf;
+  eb_width_t addr = width >> 4;
+
+  addr |= addr >> 1;
+  addr |= addr >> 2;
+  addr = (addr+1) >> 1;
+
+  data |= data >> 1;
+  data |= data >> 2;
+  data = (data+1) >> 1;
+
+  return (addr << 4) | data;
+}
+
+static eb_data_t EB_LOAD(const uint8_t* rptr, int alignment) {
+  switch (alignment) {
+  case 2: return be16toh(*(const uint16_t*)rptr);
+  case 4: return be32toh(*(const uint32_t*)rptr);
+  case 8: return be64toh(*(const uint64_t*)rptr);
+  }
+  return 0; /* unreachable */
+}
+
+static void EB_sWRITE(uint8_t* wptr, eb_data_t val, int alignment) {
+  switch (alignment) {
+  case 2: *(uint16_t*)wptr = htobe16(val); break;
+  case 4: *(uint32_t*)wptr = htobe32(val); break;
+  case 8: *(uint64_t*)wptr = htobe64(val); break;
+  }
+}
+
+/* Find the offset */
+static uint8_t eb_log2_table[8] = { 0, 1, 2, 4, 7, 3, 6, 5 };
+static uint8_t eb_log2(uint8_t x) { return eb_log2_table[(uint8_t)(x * 0x17) >> 5]; }
+
+/* Memory accesses are aligned to their width by the select lines */
+static eb_data_t sim_load(const uint8_t* p, int width) {
+  uint16_t v16;
+  uint32_t v32;
+  uint64_t v64;
+
+  switch (width) {
+  case 1: return p[0];
+  case 2: memcpy(&v16, p, 2); return (endian == EB_BIG_ENDIAN) ? be16toh(v16) : le16toh(v16);
+  case 4: memcpy(&v32, p, 4); return (endian == EB_BIG_ENDIAN) ? be32toh(v32) : le32toh(v32);
+  case 8: memcpy(&v64, p, 8); return (endian == EB_BIG_ENDIAN) ? be64toh(v64) : le64toh(v64);
+  }
+  return 0; /* unreachable */
+}
+
+static void sim_store(uint8_t* p, int width, eb_data_t value) {
+  uint16_t v16;
+  uint32_t v32;
+  uint64_t v64;
+
+  switch (width) {
+  case 1: p[0] = value; break;
+  case 2: v16 = (endian == EB_BIG_ENDIAN) ? htobe16(value) : htole16(value); memcpy(p, &v16, 2); break;
+  case 4: v32 = (endian == EB_BIG_ENDIAN) ? htobe32(value) : htole32(value); memcpy(p, &v32, 4); break;
+  case 8: v64 = (endian == EB_BIG_ENDIAN) ? htobe64(value) : htole64(value); memcpy(p, &v64, 8); break;
+  }
+}
+
+static eb_data_t sim_read(struct sim_thread* thread, eb_address_t addr_b, eb_address_t addr_l, int width, uint64_t* error) {
+  eb_address_t addr;
+  eb_data_t out;
+  int i;
+
+  /* SDB address? always bigendian */
+  if (addr_b - sdb_address < SIM_SDB_SIZE) {
+    *error <<= 1;
+    addr = addr_b - sdb_address;
+    out = 0;
+    for (i = 0; i < width; ++i) {
+      out <<= 8;
+      if (addr+i < sdb_size) out |= sdb_table[addr+i];
+    }
+    return out;
+  }
+
+  addr = (endian == EB_BIG_ENDIAN) ? addr_b : addr_l;
+  if (addr >= memory_size || memory_size - addr < width) {
+    /* Segfault => shift in an error */
+    *error = (*error << 1) | 1;
+    ++thread->count.misses;
+    return 0;
+  }
+
+  *error <<= 1;
+  return sim_load(memory + addr, width);
+}
+
+static void sim_write(struct sim_thread* thread, eb_address_t addr_b, eb_address_t addr_l, int width, eb_data_t value, uint64_t* error) {
+  eb_address_t addr;
+
+  addr = (endian == EB_BIG_ENDIAN) ? addr_b : addr_l;
+  if (addr >= memory_size || memory_size - addr < width) {
+    *error = (*error << 1) | 1;
+    ++thread->count.misses;
+    return;
+  }
+
+  *error <<= 1;
+  sim_store(memory + addr, width, value);
+}
+
+/* The error shift register and the SDB address, as eb_socket_read_config */
+static eb_data_t sim_read_config(int width, eb_address_t addr, uint64_t error) {
+  uint8_t buf[16];
+  eb_data_t out;
+
+  EB_sWRITE(&buf[0], error, 8);
+  EB_sWRITE(&buf[8], sdb_address, 8);
+
+  /* Read out of bounds */
+  if (addr >= 16 || 16 - addr < width) return 0;
+
+  out = 0;
+  while (width--) {
+    out <<= 8;
+    out |= buf[addr++];
+  }
+
+  return out;
+}
+
+/* Answer one datagram into out, as eb_device_slave does; 0 if no reply */
+static int sim_packet(struct sim_thread* thread, const uint8_t* buffer, int len, uint8_t* out) {
+  eb_width_t width, data, addr, biggest;
+  eb_address_t address_filter_bits;
+  int alignment, record_alignment, stride;
+  int rptr, wptr, reply, cycle_end, cycle_open;
+  uint64_t error;
+
+  if (len < 4 || buffer[0] != 0x4E || buffer[1] != 0x6F) return 0;
+
+  /* Is this a probe? */
+  if ((buffer[2] & EB_HEADER_PF) != 0) {
+    if (len != 8) return 0;
+
+    /* Bytes 4-7 are echoed back */
+    memcpy(out, buffer, 8);
+    out[2] = 0x10 | EB_HEADER_PR | EB_HEADER_NR; /* V1 probe response */
+    out[3] = widths;
+    return 8;
+  }
+
+  /* We never probe, so there are no probe responses for us */
+  if ((buffer[2] & EB_HEADER_PR) != 0) return 0;
+
+  /* Not V1 ? */
+  if ((buffer[2] & 0xf0) != 0x10) return 0;
+
+  /* Unsupported widths? */
+  width = sim_refine(buffer[3] & widths);
+  if ((width & EB_DATAX) == 0 || (width >> 4) == 0) return 0;
+
+  /* Alignment is either 2, 4, or 8. */
+  data = width & EB_DATAX;
+  addr = width >> 4;
+  biggest = addr | data;
+  alignment = 2;
+  alignment += (biggest >= EB_DATA32)*2;
+  alignment += (biggest >= EB_DATA64)*4;
+  record_alignment = 4;
+  record_alignment += (biggest >= EB_DATA64)*4;
+  stride = data;
+
+  /* Only these bits of incoming addresses are processed */
+  address_filter_bits = ~(eb_address_t)0;
+  address_filter_bits >>= (sizeof(eb_address_t) - addr) << 3;
+  address_filter_bits -= (data-1);
+
+  if (len < record_alignment) return 0;
+
+  /* As a reply, this will contain no reads */
+  memcpy(out, buffer, record_alignment);
+  out[2] |= EB_HEADER_NR;
+
+  rptr = wptr = record_alignment;
+
+  /* Session-limited error shift */
+  error = 0;
+  reply = 0;
+  cycle_end = 1;
+  cycle_open = 0;
+
+  while (rptr <= len - record_alignment) {
+    int total, wconfig, wfifo, rconfig, rfifo, bconfig, sel_ok;
+    eb_address_t bwa, bwa_b, bwa_l;
+    eb_address_t ra, ra_b, ra_l;
+    eb_data_t wv, data_mask;
+    eb_width_t op_width, op_widths;
+    uint8_t op_shift, bits, bits1;
+    uint8_t addr_low_big_endian, addr_low_little_endian;
+    uint8_t flags  = buffer[rptr+0];
+    uint8_t select = buffer[rptr+1];
+    uint8_t wcount = buffer[rptr+2];
+    uint8_t rcount = buffer[rptr+3];
+
+    rptr += record_alignment;
+    thread->count.operations += wcount + rcount;
+
+    /* Decode the intended width from the select lines */
+    op_shift = eb_log2(select & -select);
+    bits = select >> op_shift;
+    bits1 = (bits>>1)+1;
+    op_widths = eb_log2(bits1);
+    op_width = op_widths+1;
+
+    sel_ok = select != 0
+          && (bits & (bits+1)) == 0
+          && (op_width & op_widths) == 0
+          && (op_shift & op_widths) == 0
+          && op_width <= data
+          && op_shift < data;
+
+    addr_low_big_endian = data - (op_shift+op_width);
+    addr_low_little_endian = op_shift;
+
+    data_mask = ~(eb_data_t)0;
+    data_mask >>= (sizeof(eb_data_t) - op_width) << 3;
+
+    cycle_end = flags & EB_RECORD_CYC;
+
+    total = wcount;
+    total += rcount;
+    total += (wcount>0);
+    total += (rcount>0);
+
+    /* A record overflowing a datagram kills it */
+    if (total*alignment > len-rptr) return 0;
+
+    if (wcount > 0) {
+      wfifo = flags & EB_RECORD_WFF;
+      wconfig = flags & EB_RECORD_WCA;
+
+      bwa = EB_LOAD(&buffer[rptr], alignment);
+      rptr += alignment;
+
+      bwa &= address_filter_bits;
+      bwa_b = bwa | addr_low_big_endian;
+      bwa_l = bwa | addr_low_little_endian;
+
+      while (wcount--) {
+        wv = EB_LOAD(&buffer[rptr], alignment);
+        rptr += alignment;
+
+        wv >>= (op_shift<<3);
+        wv &= data_mask;
+
+        /* Nothing behind us needs config space writes */
+        if (!wconfig) {
+          if (sel_ok)
+            sim_write(thread, bwa_b, bwa_l, op_width, wv, &error);
+          else {
+            error = (error<<1) | 1;
+            ++thread->count.misses;
+          }
+        }
+
+        if (wfifo == 0) {
+          bwa_l += stride;
+          bwa_b += stride;
+        }
+      }
+    }
+
+    if (rcount > 0) {
+      reply = 1;
+      rfifo = flags & EB_RECORD_RFF;
+      bconfig = flags & EB_RECORD_BCA;
+      rconfig = flags & EB_RECORD_RCA;
+
+      memset(&out[wptr], 0, record_alignment);
+      out[wptr+0] = cycle_end |
+                    (bconfig ? EB_RECORD_WCA : 0) |
+                    (rfifo   ? EB_RECORD_WFF : 0);
+      out[wptr+1] = select;
+      out[wptr+2] = rcount;
+      wptr += record_alignment;
+
+      cycle_open = cycle_end == 0;
+
+      /* Echo back the base return address */
+      memcpy(&out[wptr], &buffer[rptr], alignment);
+      rptr += alignment;
+      wptr += alignment;
+
+      while (rcount--) {
+        ra = EB_LOAD(&buffer[rptr], alignment);
+        rptr += alignment;
+
+        ra &= address_filter_bits;
+        ra_b = ra | addr_low_big_endian;
+        ra_l = ra | addr_low_little_endian;
+
+        if (!sel_ok) {
+          wv = 0;
+          if (!rconfig) {
+            error = (error<<1) | 1;
+            ++thread->count.misses;
+          }
+        } else if (rconfig) {
+          wv = sim_read_config(op_width, ra_b, error);
+        } else {
+          wv = sim_read(thread, ra_b, ra_l, op_width, &error);
+        }
+
+        wv &= data_mask;
+        wv <<= (op_shift<<3);
+
+        EB_sWRITE(&out[wptr], wv, alignment);
+        wptr += alignment;
+      }
+    }
+
+    /* We need to terminate the cycle */
+    if (cycle_open && cycle_end) {
+      memset(&out[wptr], 0, record_alignment);
+      out[wptr] = cycle_end;
+      wptr += record_alignment;
+      cycle_open = 0;
+    }
+  }
+
+  return reply ? wptr : 0;
+}
+
+static void sim_heap_push(struct sim_thread* thread, struct sim_reply* reply) {
+  int i, parent;
+
+  for (i = thread->queued++; i > 0; i = parent) {
+    parent = (i-1)/2;
+    if (thread->heap[parent]->due <= reply->due) break;
+    thread->heap[i] = thread->heap[parent];
+  }
+  thread->heap[i] = reply;
+}
+
+static struct sim_reply* sim_heap_pop(struct sim_thread* thread) {
+  struct sim_reply* top;
+  struct sim_reply* last;
+  int i, child;
+
+  top = thread->heap[0];
+  last = thread->heap[--thread->queued];
+
+  for (i = 0; (child = 2*i+1) < thread->queued; i = child) {
+    if (child+1 < thread->queued && thread->heap[child+1]->due < thread->heap[child]->due) ++child;
+    if (last->due <= thread->heap[child]->due) break;
+    thread->heap[i] = thread->heap[child];
+  }
+  thread->heap[i] = last;
+
+  return top;
+}
+
+/* Send the delayed replies which are due */
+static void sim_flush(struct sim_thread* thread, uint64_t now) {
+  struct sim_reply* reply;
+
+  while (thread->queued > 0 && thread->heap[0]->due <= now) {
+    reply = sim_heap_pop(thread);
+    sendto(reply->sock, reply->data, reply->len, 0, (struct sockaddr*)&reply->sa, reply->sa_len);
+    thread->spare[SIM_QUEUE - thread->queued - 1] = reply;
+  }
+}
+
+/* Block until the earliest delayed reply is sent */
+static void sim_wait(struct sim_thread* thread) {
+  struct timespec ts;
+  uint64_t due;
+
+  due = thread->heap[0]->due;
+  ts.tv_sec  = due / 1000000000;
+  ts.tv_nsec = due % 1000000000;
+  while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, 0) != 0 && !stop) { }
+
+  sim_flush(thread, due);
+}
+
+static int sim_recv(struct sim_thread* thread, int sock) {
+#ifdef SIM_MMSG
+  struct mmsghdr msg[SIM_BATCH];
+  struct iovec iov[SIM_BATCH];
+  int i, n;
+
+  memset(msg, 0, sizeof(msg));
+  for (i = 0; i < SIM_BATCH; ++i) {
+    iov[i].iov_base = &thread->rx[i][0];
+    iov[i].iov_len = SIM_SLOT;
+    msg[i].msg_hdr.msg_iov = &iov[i];
+    msg[i].msg_hdr.msg_iovlen = 1;
+    msg[i].msg_hdr.msg_name = &thread->sa[i];
+    msg[i].msg_hdr.msg_namelen = sizeof(thread->sa[i]);
+  }
+
+  n = recvmmsg(sock, msg, SIM_BATCH, MSG_DONTWAIT, 0);
+  for (i = 0; i < n; ++i) {
+    thread->rx_len[i] = msg[i].msg_len;
+    thread->sa_len[i] = msg[i].msg_hdr.msg_namelen;
+  }
+  return n;
+#else
+  thread->sa_len[0] = sizeof(thread->sa[0]);
+  thread->rx_len[0] = recvfrom(sock, &thread->rx[0][0], SIM_SLOT, MSG_DONTWAIT, (struct sockaddr*)&thread->sa[0], &thread->sa_len[0]);
+  return thread->rx_len[0] < 0 ? -1 : 1;
+#endif
+}
+
+static void sim_send(struct sim_thread* thread, int sock, int n) {
+#ifdef SIM_MMSG
+  struct mmsghdr msg[SIM_BATCH];
+  struct iovec iov[SIM_BATCH];
+  int i, m, sent;
+
+  memset(msg, 0, sizeof(msg));
+  for (i = m = 0; i < n; ++i) {
+    if (thread->tx_len[i] == 0) continue;
+    iov[m].iov_base = &thread->tx[i][0];
+    iov[m].iov_len = thread->tx_len[i];
+    msg[m].msg_hdr.msg_iov = &iov[m];
+    msg[m].msg_hdr.msg_iovlen = 1;
+    msg[m].msg_hdr.msg_name = &thread->sa[i];
+    msg[m].msg_hdr.msg_namelen = thread->sa_len[i];
+    ++m;
+  }
+
+  /* A full send buffer loses replies, as a congested network would */
+  for (i = 0; i < m; i += sent) {
+    sent = sendmmsg(sock, &msg[i], m-i, 0);
+    if (sent <= 0) break;
+  }
+#else
+  int i;
+
+  for (i = 0; i < n; ++i)
+    if (thread->tx_len[i] != 0)
+      sendto(sock, &thread->tx[i][0], thread->tx_len[i], 0, (struct sockaddr*)&thread->sa[i], thread->sa_len[i]);
+#endif
+}
+
+/* Answer one batch of requests from sock */
+static void sim_serve(struct sim_thread* thread, int sock) {
+  struct sim_reply* reply;
+  int i, n;
+
+  if ((n = sim_recv(thread, sock)) <= 0) return;
+
+  for (i = 0; i < n; ++i) {
+    thread->tx_len[i] = 0;
+    ++thread->count.packets;
+
+    if (drop != 0 && (sim_random(thread) >> 32) < drop) {
+      ++thread->count.dropped;
+      continue;
+    }
+
+    if (thread->pool == 0) {
+      thread->tx_len[i] = sim_packet(thread, &thread->rx[i][0], thread->rx_len[i], &thread->tx[i][0]);
+      continue;
+    }
+
+    if (thread->queued == SIM_QUEUE) sim_wait(thread);
+
+    reply = thread->spare[SIM_QUEUE - thread->queued - 1];
+    if ((reply->len = sim_packet(thread, &thread->rx[i][0], thread->rx_len[i], &reply->data[0])) == 0) continue;
+
+    reply->due = sim_now() + latency;
+    if (jitter != 0) reply->due += sim_random(thread) % (2*jitter+1);
+    reply->due -= jitter;
+    reply->sock = sock;
+    reply->sa_len = thread->sa_len[i];
+    memcpy(&reply->sa, &thread->sa[i], thread->sa_len[i]);
+    sim_heap_push(thread, reply);
+  }
+
+  sim_send(thread, sock, n);
+}
+
+static void* sim_run(void* arg) {
+  struct sim_thread* thread = (struct sim_thread*)arg;
+  struct pollfd pfd[2];
+  uint64_t now, wait;
+  int i, timeout;
+
+  for (i = 0; i < thread->socks; ++i) {
+    pfd[i].fd = thread->sock[i];
+    pfd[i].events = POLLIN;
+  }
+
+  while (!stop) {
+    now = sim_now();
+    sim_flush(thread, now);
+
+    /* Wake up for the next delayed reply, and now and then to check stop */
+    timeout = 100;
+    if (thread->queued > 0) {
+      wait = (thread->heap[0]->due - now + 999999) / 1000000;
+      if (wait < (uint64_t)timeout) timeout = wait;
+    }
+
+    if (poll(pfd, thread->socks, timeout) <= 0) continue;
+
+    for (i = 0; i < thread->socks; ++i)
+      if ((pfd[i].revents & POLLIN) != 0)
+        sim_serve(thread, thread->sock[i]);
+
+    __atomic_store_n(&thread->shared.packets,    thread->count.packets,    __ATOMIC_RELAXED);
+    __atomic_store_n(&thread->shared.operations, thread->count.operations, __ATOMIC_RELAXED);
+    __atomic_store_n(&thread->shared.dropped,    thread->count.dropped,    __ATOMIC_RELAXED);
+    __atomic_store_n(&thread->shared.misses,     thread->count.misses,     __ATOMIC_RELAXED);
+  }
+
+  return 0;
+}
+
+/* Bind a socket which shares the port with the other threads; -1 on error */
+static int sim_open(int family, const char* port) {
+  struct addrinfo hints, *match, *i;
+  int sock, optval;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family = family;
+  hints.ai_socktype = SOCK_DGRAM;
+  hints.ai_protocol = IPPROTO_UDP;
+  hints.ai_flags = AI_PASSIVE;
+
+  if (getaddrinfo(0, port, &hints, &match) != 0)
+    return -1;
+
+  sock = -1;
+  for (i = match; i; i = i->ai_next) {
+    if ((sock = socket(i->ai_family, i->ai_socktype, i->ai_protocol)) == -1) continue;
+
+    optval = 1;
+#ifdef IPV6_V6ONLY
+    if (i->ai_family == PF_INET6)
+      setsockopt(sock, IPPROTO_IPV6, IPV6_V6ONLY, &optval, sizeof(optval));
+#endif
+#ifdef SO_REUSEPORT
+    setsockopt(sock, SOL_SOCKET, SO_REUSEPORT, &optval, sizeof(optval));
+#endif
+
+    optval = SIM_BUFFER;
+    setsockopt(sock, SOL_SOCKET, SO_RCVBUF, &optval, sizeof(optval));
+    setsockopt(sock, SOL_SOCKET, SO_SNDBUF, &optval, sizeof(optval));
+
+    if (bind(sock, i->ai_addr, i->ai_addrlen) == 0) break;
+
+    close(sock);
+    sock = -1;
+  }
+
+  freeaddrinfo(match);
+  return sock;
+}
+
+/* The table read by eb_sdb_scan_root: an interconnect record, then the devices */
+static int sim_sdb(int devices, eb_address_t size) {
+  struct sdb_interconnect interconnect;
+  struct sdb_device device;
+  int i;
+
+  sdb_size = (devices+1) * 64;
+  if (sdb_size > SIM_SDB_SIZE || (sdb_table = calloc(sdb_size, 1)) == 0) return 0;
+
+  memset(&interconnect, 0, sizeof(interconnect));
+  interconnect.sdb_magic    = htobe32(0x5344422D);
+  interconnect.sdb_records  = htobe16(devices+1);
+  interconnect.sdb_version  = 1;
+  interconnect.sdb_bus_type = sdb_wishbone;
+
+  interconnect.sdb_component.addr_first = htobe64(0);
+  interconnect.sdb_component.addr_last  = htobe64(~(eb_address_t)0);
+
+  interconnect.sdb_component.product.vendor_id   = htobe64(0x651); /* GSI */
+  interconnect.sdb_component.product.device_id   = htobe32(0x02398114);
+  interconnect.sdb_component.product.version     = htobe32(0x101);
+  interconnect.sdb_component.product.date        = htobe32(0x20151207);
+  interconnect.sdb_component.product.record_type = sdb_record_interconnect;
+  memcpy(interconnect.sdb_component.product.name, "Software-EB-Bus    ", sizeof(interconnect.sdb_component.product.name));
+  memcpy(sdb_table, &interconnect, 64);
+
+  for (i = 0; i < devices; ++i) {
+    memset(&device, 0, sizeof(device));
+    device.abi_class     = htobe16(0x1);
+    device.abi_ver_major = 1;
+    device.bus_specific  = htobe32(((endian == EB_LITTLE_ENDIAN) ? SDB_WISHBONE_LITTLE_ENDIAN : 0) | (widths & EB_DATAX));
+
+    device.sdb_component.addr_first = htobe64(size*i);
+    device.sdb_component.addr_last  = htobe64(size*(i+1) - 1);
+
+    device.sdb_component.product.vendor_id   = htobe64(0x651); /* GSI */
+    device.sdb_component.product.device_id   = htobe32(0xc3c5eefa);
+    device.sdb_component.product.version     = htobe32(0x101);
+    device.sdb_component.product.date        = htobe32(0x20151207);
+    device.sdb_component.product.record_type = sdb_record_device;
+    memcpy(device.sdb_component.product.name, "Software-Memory    ", sizeof(device.sdb_component.product.name));
+    memcpy(sdb_table + 64*(i+1), &device, 64);
+  }
+
+  return 1;
+}
+
+/* Back the devices with a shared file or anonymous memory */
+static int sim_memory(const char* file) {
+  struct stat st;
+  int fd;
+
+  if (file == 0) {
+    memory = mmap(0, memory_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    return memory != MAP_FAILED;
+  }
+
+  if ((fd = open(file, O_RDWR|O_CREAT, 0644)) == -1) return 0;
+
+  /* Grow the file to fit, but never truncate it */
+  if (fstat(fd, &st) != 0 || ((eb_address_t)st.st_size < memory_size && ftruncate(fd, memory_size) != 0)) {
+    close(fd);
+    return 0;
+  }
+
+  memory = mmap(0, memory_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  return memory != MAP_FAILED;
+}
+
+int main(int argc, char** argv) {
+  long value;
+  double fvalue;
+  char* value_end;
+  int opt, error, i, devices, threads, interval;
+  const char* port;
+  const char* file;
+  eb_width_t address_width, data_width;
+  eb_address_t size;
+  struct sim_thread** thread;
+  struct sim_counters total, last;
+  struct timespec ts;
+  sigset_t signals;
+  uint64_t start, now;
+
+  /* Default arguments */
+  program = argv[0];
+  address_width = EB_ADDRX;
+  data_width = EB_DATAX;
+  endian = EB_BIG_ENDIAN;
+  devices = 1;
+  size = 0x100000;
+  file = 0;
+  threads = 1;
+  interval = 0;
+  error = 0;
+
+  /* Process the command-line arguments */
+  while ((opt = getopt(argc, argv, "a:d:bln:s:f:t:L:J:p:i:h")) != -1) {
+    switch (opt) {
+    case 'a':
+      value = eb_width_parse_address(optarg, &address_width);
+      if (value != EB_OK) {
+        fprintf(stderr, "%s: invalid address width -- '%s'\n", program, optarg);
+        error = 1;
+      }
+      break;
+    case 'd':
+      value = eb_width_parse_data(optarg, &data_width);
+      if (value != EB_OK) {
+        fprintf(stderr, "%s: invalid data width -- '%s'\n", program, optarg);
+        error = 1;
+      }
+      break;
+    case 'b':
+      endian = EB_BIG_ENDIAN;
+      break;
+    case 'l':
+      endian = EB_LITTLE_ENDIAN;
+      break;
+    case 'n':
+      devices = strtol(optarg, &value_end, 0);
+      if (*value_end || devices < 1 || devices >= SIM_SDB_SIZE/64) {
+        fprintf(stderr, "%s: invalid number of devices -- '%s'\n", program, optarg);
+        error = 1;
+      }
+      break;
+    case 's':
+      size = strtoull(optarg, &value_end, 0);
+      if (*value_end || size < 8 || (size & 7) != 0) {
+        fprintf(stderr, "%s: invalid device size, need a multiple of 8 -- '%s'\n", program, optarg);
+        error = 1;
+      }
+      break;
+    case 'f':
+      file = optarg;
+      break;
+    case 't':
+      threads = strtol(optarg, &value_end, 0);
+      if (*value_end || threads < 1 || threads > 1024) {
+        fprintf(stderr, "%s: invalid number of threads -- '%s'\n", program, optarg);
+        error = 1;
+      }
+      break;
+    case 'L':
+    case 'J':
+      value = strtol(optarg, &value_end, 0);
+      if (*value_end || value < 0 || value > 10000000) {
+        fprintf(stderr, "%s: invalid delay -- '%s'\n", program, optarg);
+        error = 1;
+      }
+      if (opt == 'L') latency = (uint64_t)value * 1000;
+      else            jitter  = (uint64_t)value * 1000;
+      break;
+    case 'p':
+      fvalue = strtod(optarg, &value_end);
+      if (*value_end || fvalue < 0 || fvalue > 100) {
+        fprintf(stderr, "%s: invalid drop percentage -- '%s'\n", program, optarg);
+        error = 1;
+      }
+      drop = fvalue / 100 * 4294967296.0;
+      break;
+    case 'i':
+      interval = strtol(optarg, &value_end, 0);
+      if (*value_end || interval < 1) {
+        fprintf(stderr, "%s: invalid interval -- '%s'\n", program, optarg);
+        error = 1;
+      }
+      break;
+    case 'h':
+      help();
+      return 1;
+    case ':':
+    case '?':
+      error = 1;
+      break;
+    default:
+      fprintf(stderr, "%s: bad getopt result\n", program);
+      return 1;
+    }
+  }
+
+  if (error) return 1;
+
+  if (optind + 1 != argc) {
+    fprintf(stderr, "%s: expecting one non-optional argument: <port>\n", program);
+    return 1;
+  }
+
+  port = argv[optind];
+  widths = address_width | data_width;
+
+#ifndef SO_REUSEPORT
+  if (threads > 1) {
+    fprintf(stderr, "%s: this system cannot share a port between threads\n", program);
+    return 1;
+  }
+#endif
+
+  if (jitter > latency) {
+    fprintf(stderr, "%s: the jitter may not exceed the latency\n", program);
+    return 1;
+  }
+
+  /* The SDB table follows the memory of the devices */
+  memory_size = size * devices;
+  sdb_address = memory_size;
+
+  if (!sim_memory(file)) {
+    fprintf(stderr, "%s: cannot map 0x%"EB_ADDR_FMT" bytes of memory%s%s\n",
+                    program, memory_size, file?" from ":"", file?file:"");
+    return 1;
+  }
+
+  if (!sim_sdb(devices, size)) {
+    fprintf(stderr, "%s: insufficient memory for the SDB table\n", program);
+    return 1;
+  }
+
+  if ((thread = calloc(threads, sizeof(struct sim_thread*))) == 0) {
+    fprintf(stderr, "%s: insufficient memory for %d threads\n", program, threads);
+    return 1;
+  }
+
+  /* Bind every socket before serving, so a busy port is reported here */
+  for (i = 0; i < threads; ++i) {
+    if ((thread[i] = calloc(1, sizeof(struct sim_thread))) == 0) {
+      fprintf(stderr, "%s: insufficient memory for %d threads\n", program, threads);
+      return 1;
+    }
+
+    thread[i]->random = sim_now() ^ ((uint64_t)(i+1) << 48);
+
+    if ((thread[i]->sock[thread[i]->socks] = sim_open(PF_INET, port)) != -1) ++thread[i]->socks;
+#ifndef EB_DISABLE_IPV6
+    if ((thread[i]->sock[thread[i]->socks] = sim_open(PF_INET6, port)) != -1) ++thread[i]->socks;
+#endif
+
+    if (thread[i]->socks == 0) {
+      fprintf(stderr, "%s: failed to bind UDP port %s\n", program, port);
+      return 1;
+    }
+
+    if (latency != 0) {
+      if ((thread[i]->pool = calloc(SIM_QUEUE, sizeof(struct sim_reply))) == 0) {
+        fprintf(stderr, "%s: insufficient memory to delay replies\n", program);
+        return 1;
+      }
+      for (opt = 0; opt < SIM_QUEUE; ++opt)
+        thread[i]->spare[opt] = &thread[i]->pool[opt];
+    }
+  }
+
+  /* Stop cleanly on a signal, so a file is synced */
+  signal(SIGINT, &on_signal);
+  signal(SIGTERM, &on_signal);
+
+  /* Signals go to this thread, to cut the sleep below short */
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, 0);
+
+  for (i = 0; i < threads; ++i) {
+    if (pthread_create(&thread[i]->id, 0, &sim_run, thread[i]) != 0) {
+      fprintf(stderr, "%s: failed to start thread %d\n", program, i);
+      stop = 1;
+      threads = i;
+      break;
+    }
+  }
+
+  pthread_sigmask(SIG_UNBLOCK, &signals, 0);
+
+  memset(&last, 0, sizeof(last));
+  start = sim_now();
+
+  while (!stop) {
+    ts.tv_sec = interval ? interval : 1;
+    ts.tv_nsec = 0;
+    nanosleep(&ts, 0);
+
+    if (stop || !interval) continue;
+
+    memset(&total, 0, sizeof(total));
+    for (i = 0; i < threads; ++i) {
+      total.packets    += __atomic_load_n(&thread[i]->shared.packets,    __ATOMIC_RELAXED);
+      total.operations += __atomic_load_n(&thread[i]->shared.operations, __ATOMIC_RELAXED);
+      total.dropped    += __atomic_load_n(&thread[i]->shared.dropped,    __ATOMIC_RELAXED);
+      total.misses     += __atomic_load_n(&thread[i]->shared.misses,     __ATOMIC_RELAXED);
+    }
+
+    now = sim_now();
+    fprintf(stdout, "%.0f ops/s, %.0f packets/s, %"PRIu64" dropped, %"PRIu64" misses\n",
+                    (total.operations - last.operations) * 1e9 / (now - start),
+                    (total.packets - last.packets) * 1e9 / (now - start),
+                    total.dropped - last.dropped, total.misses - last.misses);
+    fflush(stdout);
+
+    last = total;
+    start = now;
+  }
+
+  for (i = 0; i < threads; ++i)
+    pthread_join(thread[i]->id, 0);
+
+  if (file != 0 && msync(memory, memory_size, MS_SYNC) != 0) {
+    fprintf(stderr, "%s: failed to write %s\n", program, file);
+    return 1;
+  }
+
+  return 0;
+}
@@ -32,6 +32,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <signal.h>
 
 #include "../etherbone.h"
 #include "../glue/version.h"
@@ -43,6 +44,11 @@ static eb_width_t address_width, data_width;
 static eb_address_t address;
 static eb_format_t endian;
 static int verbose, quiet;
+static volatile sig_atomic_t stop;
+
+static void on_signal(int sig) {
+  stop = 1;
+}
 
 static void help(void) {
   fprintf(stderr, "Usage: %s [OPTION] <port> <address-range> [passive-open-address]\n", program);
@@ -52,6 +58,7 @@ static void help(void) {
   fprintf(stderr, "  -w <width>     SDB device operation widths       (8/16/32/64)\n");
   fprintf(stderr, "  -b             big-endian operation                    (auto)\n");
   fprintf(stderr, "  -l             little-endian operation                 (auto)\n");
+  fprintf(stderr, "  -c <file>      record the traffic into a pcap file\n");
   fprintf(stderr, "  -v             verbose operation\n");
   fprintf(stderr, "  -q             quiet: do not display warnings\n");
   fprintf(stderr, "  -h             display this help and exit\n");
@@ -119,6 +126,7 @@ int main(int argc, char** argv) {
   char* value_end;
   int opt, error;
   const char* passive_address;
+  const char* capture;
   
   struct sdb_device device;
   struct eb_handler handler;
@@ -138,9 +146,10 @@ int main(int argc, char** argv) {
   verbose = 0;
   quiet = 0;
   error = 0;
+  capture = 0;
   
   /* Process the command-line arguments */
-  while ((opt = getopt(argc, argv, "a:d:w:blvqh")) != -1) {
+  while ((opt = getopt(argc, argv, "a:d:w:blc:vqh")) != -1) {
     switch (opt) {
     case 'a':
       value = eb_width_parse_address(optarg, &address_width);
@@ -169,6 +178,9 @@ int main(int argc, char** argv) {
     case 'l':
       endian = EB_LITTLE_ENDIAN;
       break;
+    case 'c':
+      capture = optarg;
+      break;
     case 'v':
       verbose = 1;
       break;
@@ -256,9 +268,23 @@ int main(int argc, char** argv) {
     }
   }
   
-  while (1) {
+  if (capture != 0 && (status = eb_socket_capture(socket, capture)) != EB_OK) {
+    fprintf(stderr, "%s: failed to record into %s: %s\n", program, capture, eb_status(status));
+    return 1;
+  }
+  
+  /* Stop cleanly on a signal, so the capture is complete */
+  signal(SIGINT, &on_signal);
+  signal(SIGTERM, &on_signal);
+  
+  while (!stop) {
     eb_socket_run(socket, -1);
   }
   
+  if (capture != 0 && (status = eb_socket_capture(socket, 0)) != EB_OK) {
+    fprintf(stderr, "%s: failed to write %s: %s\n", program, capture, eb_status(status));
+    return 1;
+  }
+  
   return 0;
 }
@@ -0,0 +1,258 @@
+/** @file eb-trace.c
+ *  @brief A tool for printing the trace ring of a process as a timeline.
+ *
+ *  Copyright (C) 2026 GSI Helmholtz Centre for Heavy Ion Research GmbH
+ *
+ *  Maps the ring written by a library built with EB_TRACE, read-only,
+ *  and prints its events with the time since the first one shown, the
+ *  gap to the previous one and, for cycles, the time since their close.
+ *
+ *  @author Etherbone Core Developers <etherbone-core@ohwr.org>
+ *
+ *  @bug None!
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define _POSIX_C_SOURCE 200112L /* getopt + shm_open + nanosleep */
+
+#include <unistd.h> /* getopt */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "../etherbone.h"
+#include "../glue/trace.h"
+
+#define CYCLES 4096 /* cycles whose close time is remembered */
+
+static const char* program;
+static const char* names[] = {
+  "?", "open", "close", "pack", "send", "recv", "reply", "expire", "callback", "return", "mark"
+};
+
+static struct {
+  uint32_t cycle;
+  uint64_t closed;
+} cycles[CYCLES];
+
+static uint64_t first_time, last_time;
+static uint32_t none;
+
+static void help(void) {
+  fprintf(stderr, "Usage: %s [OPTION] <pid|name>\n", program);
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Prints the events recorded by a process using a library built with\n");
+  fprintf(stderr, "EB_TRACE. The ring is named %s after the process id.\n", EB_TRACE_NAME);
+  fprintf(stderr, "Times are in microseconds.\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "  -n <count>     print only the last count events           (all)\n");
+  fprintf(stderr, "  -f             keep printing new events as they are recorded\n");
+  fprintf(stderr, "  -u             remove the ring after printing it\n");
+  fprintf(stderr, "  -h             display this help and exit\n");
+  fprintf(stderr, "\n");
+  fprintf(stderr, "Report Etherbone bugs to <etherbone-core@ohwr.org>\n");
+  fprintf(stderr, "Version: %s\n%s\nLicensed under the LGPL v3.\n", eb_source_version(), eb_build_info());
+}
+
+static void handle(char* buf, uint32_t x) {
+  if (x == none)
+    strcpy(buf, "-");
+  else
+    sprintf(buf, "%"PRIx32, x);
+}
+
+static void print(const struct eb_trace_event* event) {
+  char device[16], cycle[16], detail[64];
+  int slot;
+  
+  if (first_time == 0) first_time = last_time = event->time;
+  
+  handle(device, event->device);
+  handle(cycle, event->cycle);
+  
+  switch (event->event) {
+  case EB_TRACE_OPEN:   sprintf(detail, "pid %"PRIu32, event->arg); break;
+  case EB_TRACE_PACK:   sprintf(detail, "%"PRIu32" records", event->arg); break;
+  case EB_TRACE_SEND:
+  case EB_TRACE_RECV:   sprintf(detail, "%"PRIu32" bytes", event->arg); break;
+  case EB_TRACE_REPLY:  sprintf(detail, "rtt %"PRIu32, event->arg); break;
+  case EB_TRACE_MARK:   sprintf(detail, "0x%"PRIx32, event->arg); break;
+  case EB_TRACE_CALLBACK:
+  case EB_TRACE_RETURN: sprintf(detail, "%s", eb_status((eb_status_t)(int32_t)event->arg)); break;
+  default:              detail[0] = 0; break;
+  }
+  
+  /* How long has the cycle been closed? */
+  if (event->cycle != none) {
+    slot = event->cycle % CYCLES;
+    if (event->event == EB_TRACE_CLOSE) {
+      cycles[slot].cycle = event->cycle;
+      cycles[slot].closed = event->time;
+    } else if (cycles[slot].cycle == event->cycle && cycles[slot].closed != 0) {
+      sprintf(detail + strlen(detail), "%sclosed %.3f ago", detail[0] ? ", " : "",
+              (event->time - cycles[slot].closed) / 1e3);
+      if (event->event == EB_TRACE_RETURN) cycles[slot].closed = 0;
+    }
+  }
+  
+  printf("%14.3f %+10.3f  %-8s  device %-8s cycle %-8s  %s\n",
+         (event->time - first_time) / 1e3,
+         (event->time - last_time) / 1e3,
+         event->event < sizeof(names)/sizeof(names[0]) ? names[event->event] : names[0],
+         device, cycle, detail);
+  
+  last_time = event->time;
+}
+
+int main(int argc, char** argv) {
+  const struct eb_trace_ring* ring;
+  struct eb_trace_event event;
+  const struct eb_trace_event* slot;
+  struct stat st;
+  struct timespec pause;
+  char name[64];
+  char* value_end;
+  const char* target;
+  uint64_t head, next, count;
+  uint32_t seq;
+  long pid;
+  int opt, fd, follow, unlink_after, waits;
+  
+  program = argv[0];
+  count = 0;
+  follow = 0;
+  unlink_after = 0;
+  
+  while ((opt = getopt(argc, argv, "n:fuh")) != -1) {
+    switch (opt) {
+    case 'n':
+      count = strtoull(optarg, &value_end, 0);
+      if (*value_end || count == 0) {
+        fprintf(stderr, "%s: invalid event count -- '%s'\n", program, optarg);
+        return 1;
+      }
+      break;
+    case 'f':
+      follow = 1;
+      break;
+    case 'u':
+      unlink_after = 1;
+      break;
+    case 'h':
+      help();
+      return 1;
+    case ':':
+    case '?':
+      return 1;
+    default:
+      fprintf(stderr, "%s: bad getopt result\n", program);
+      return 1;
+    }
+  }
+  
+  if (optind + 1 != argc) {
+    fprintf(stderr, "%s: expecting one non-optional argument: <pid|name>\n", program);
+    return 1;
+  }
+  
+  target = argv[optind];
+  pid = strtol(target, &value_end, 0);
+  if (*value_end == 0 && pid > 0) {
+    snprintf(name, sizeof(name), EB_TRACE_NAME, pid);
+  } else {
+    snprintf(name, sizeof(name), "%s%s", target[0] == '/' ? "" : "/", target);
+  }
+  
+  if ((fd = shm_open(name, O_RDONLY, 0)) == -1) {
+    perror(name);
+    return 1;
+  }
+  
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(struct eb_trace_ring)) {
+    fprintf(stderr, "%s: %s is not a trace ring\n", program, name);
+    return 1;
+  }
+  
+  ring = (const struct eb_trace_ring*)mmap(0, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (ring == MAP_FAILED) {
+    perror("mmap");
+    return 1;
+  }
+  
+  if (__atomic_load_n(&ring->magic, __ATOMIC_ACQUIRE) != EB_TRACE_MAGIC ||
+      ring->version != EB_TRACE_VERSION ||
+      ring->size == 0 || (ring->size & (ring->size-1)) != 0 ||
+      st.st_size < (off_t)(sizeof(struct eb_trace_ring) + (ring->size-1)*sizeof(struct eb_trace_event))) {
+    fprintf(stderr, "%s: %s is not a trace ring\n", program, name);
+    return 1;
+  }
+  
+  none = ring->none;
+  
+  head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+  next = (head > ring->size) ? head - ring->size : 0;
+  if (count != 0 && head - next > count) next = head - count;
+  
+  pause.tv_sec = 0;
+  pause.tv_nsec = 10000000; /* 10ms */
+  waits = 0;
+  
+  while (1) {
+    head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    
+    /* Overwritten before we could print them */
+    if (head - next > ring->size) {
+      printf("%14s %10s  lost %"PRIu64" events\n", "", "", head - ring->size - next);
+      next = head - ring->size;
+    }
+    
+    for (; next != head; ++next) {
+      slot = &ring->event[next & (ring->size-1)];
+      
+      seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+      memcpy(&event, slot, sizeof(event));
+      __atomic_thread_fence(__ATOMIC_ACQUIRE);
+      
+      if (seq != (uint32_t)(next+1) || __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq) {
+        /* A writer may still be filling it in; give it a moment */
+        if (follow && ++waits < 100) break;
+        waits = 0;
+        continue;
+      }
+      
+      waits = 0;
+      print(&event);
+    }
+    
+    if (!follow) break;
+    
+    fflush(stdout);
+    nanosleep(&pause, 0);
+  }
+  
+  if (unlink_after && shm_unlink(name) != 0) {
+    perror(name);
+    return 1;
+  }
+  
+  return 0;
+}
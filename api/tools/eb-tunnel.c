@@ -3,7 +3,13 @@
  *
  *  Copyright (C) 2011-2012 GSI Helmholtz Centre for Heavy Ion Research GmbH 
  *
- *  A complete skeleton of an application using the Etherbone library.
+ *  Each client holds one TCP connection carrying length-prefixed datagrams
+ *  for a single UDP target. On Linux the clients are watched with epoll,
+ *  so only the active ones cost anything per wakeup. Datagrams headed for
+ *  TCP are packed into one write; those headed for UDP leave in batches.
+ *
+ *  A client which names EB_TUNNEL_MUX_HELLO instead of a target speaks the
+ *  multiplexed protocol of transport/tunnel-mux.h over its connection.
  *
  *  @author Wesley W. Terpstra <w.terpstra@gsi.de>
  *
@@ -25,10 +31,15 @@
  *******************************************************************************
  */
 
+#ifdef __linux__
+#define EB_TUNNEL_EPOLL
+#endif
+
 #include "../transport/posix-ip.h"
 #include "../transport/posix-udp.h"
 #include "../transport/posix-tcp.h"
 #include "../transport/transport.h"
+#include "../transport/tunnel-mux.h"
 
 #include <string.h>
 #include <stdio.h>
@@ -38,15 +49,50 @@
 #include <winsock2.h>
 #endif
 
+#ifdef EB_TUNNEL_EPOLL
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#define MAX_EVENTS 256
+#endif
+
 #define MAX_MTU 4096
+#define TX_SIZE 65536 /* datagrams packed into one TCP write */
+
+struct eb_channel {
+  int open;
+  struct eb_link udp_slave;
+};
 
 struct eb_client {
   struct eb_transport udp_transport;
   struct eb_link udp_slave;
   struct eb_link tcp_master;
   struct eb_client* next;
+  struct eb_client* prev;
+  int pending;
+  
+  /* Multiplexed clients reach many targets from one UDP socket */
+  int mux;
+  int channels;
+  int last_channel;
+  struct eb_channel* channel;
 };
 
+/* Length-prefixed datagrams waiting for the TCP link */
+static uint8_t tx_buf[TX_SIZE];
+static int tx_len;
+
+/* The TCP stream may split a datagram across reads */
+static int eb_recv_all(struct eb_transport* tcp_transport, struct eb_link* link, uint8_t* buf, int len) {
+  int got, result;
+  
+  for (got = 0; got < len; got += result)
+    if ((result = eb_posix_tcp_recv(tcp_transport, link, buf+got, len-got)) <= 0)
+      return -1;
+  
+  return len;
+}
+
 static struct eb_client* eb_new_client(struct eb_transport* tcp_transport, struct eb_client* next) {
   struct eb_client* first;
   char address[128];
@@ -55,6 +101,12 @@ static struct eb_client* eb_new_client(struct eb_transport* tcp_transport, struc
   /* Allocate a new head pointer */
   if ((first = (struct eb_client*)malloc(sizeof(struct eb_client))) == 0) goto fail_mem;
   first->next = next;
+  first->prev = 0;
+  first->pending = 0;
+  first->mux = 0;
+  first->channels = 0;
+  first->last_channel = 0;
+  first->channel = 0;
   
   /* Extract the target hostname */
   strcpy(address, "udp/"); /* We only tunnel udp */
@@ -68,20 +120,371 @@ static struct eb_client* eb_new_client(struct eb_transport* tcp_transport, struc
   if (address[x] != 0) goto fail_address;
   
   if (eb_posix_udp_open(&next->udp_transport, 0) != EB_OK) goto fail_transport;
+  
+  /* Targets of a multiplexed client are named per channel */
+  if (!strcmp(address+4, EB_TUNNEL_MUX_HELLO)) {
+    next->mux = 1;
+    next->prev = first;
+    return first;
+  }
+  
   if (eb_posix_udp_connect(&next->udp_transport, &next->udp_slave, address, 0) != EB_OK) goto fail_link;
   
+  next->prev = first;
   return first;
 
 fail_link:
   eb_posix_udp_close(&next->udp_transport);
 fail_transport:
-  free(first);
 fail_address:
+  free(first);
 fail_mem:
   eb_posix_tcp_disconnect(tcp_transport, &next->tcp_master);
   return next;
 }  
 
+static void eb_free_client(struct eb_transport* tcp_transport, struct eb_client* client) {
+  int i;
+  
+  eb_posix_tcp_disconnect(tcp_transport, &client->tcp_master);
+  
+  if (client->mux) {
+    for (i = 0; i < client->channels; ++i)
+      if (client->channel[i].open)
+        eb_posix_udp_disconnect(&client->udp_transport, &client->channel[i].udp_slave);
+    free(client->channel);
+  } else {
+    eb_posix_udp_disconnect(&client->udp_transport, &client->udp_slave);
+  }
+  
+  eb_posix_udp_close(&client->udp_transport);
+  
+  client->prev->next = client->next;
+  if (client->next) client->next->prev = client->prev;
+  free(client);
+}
+
+/* Does a received datagram come from the target of this channel? */
+static int eb_same_peer(struct eb_channel* channel, struct sockaddr_storage* peer) {
+  struct eb_posix_udp_link* link;
+  struct sockaddr_in* a4;
+  struct sockaddr_in* b4;
+  struct sockaddr_in6* a6;
+  struct sockaddr_in6* b6;
+  
+  link = (struct eb_posix_udp_link*)&channel->udp_slave;
+  if (!channel->open || link->sa->ss_family != peer->ss_family) return 0;
+  
+  if (peer->ss_family == PF_INET) {
+    a4 = (struct sockaddr_in*)link->sa;
+    b4 = (struct sockaddr_in*)peer;
+    return a4->sin_port == b4->sin_port && a4->sin_addr.s_addr == b4->sin_addr.s_addr;
+#ifndef EB_DISABLE_IPV6
+  } else if (peer->ss_family == PF_INET6) {
+    a6 = (struct sockaddr_in6*)link->sa;
+    b6 = (struct sockaddr_in6*)peer;
+    return a6->sin6_port == b6->sin6_port && !memcmp(&a6->sin6_addr, &b6->sin6_addr, sizeof(a6->sin6_addr));
+#endif
+  } else {
+    return 0;
+  }
+}
+
+static int eb_find_channel(struct eb_client* client, struct sockaddr_storage* peer) {
+  int i;
+  
+  /* Traffic tends to come in bursts from the same target */
+  if (client->last_channel < client->channels && eb_same_peer(&client->channel[client->last_channel], peer))
+    return client->last_channel;
+  
+  for (i = 0; i < client->channels; ++i)
+    if (eb_same_peer(&client->channel[i], peer))
+      return client->last_channel = i;
+  
+  return -1;
+}
+
+static void eb_close_channel(struct eb_transport* tcp_transport, struct eb_client* client, int channel) {
+  uint8_t frame[4];
+  
+  channel |= EB_TUNNEL_MUX_CONTROL;
+  frame[0] = 0;
+  frame[1] = 0;
+  frame[2] = (channel >> 8) & 0xFF;
+  frame[3] = channel & 0xFF;
+  eb_posix_tcp_send(tcp_transport, &client->tcp_master, &frame[0], 4);
+}
+
+/* Open a channel to the target named by the client */
+static int eb_open_channel(struct eb_transport* tcp_transport, struct eb_client* client, int channel, const uint8_t* name, int len) {
+  struct eb_posix_udp_link* link;
+  struct eb_channel* grown;
+  char address[128];
+  int size, i;
+  
+  if (channel >= client->channels) {
+    for (size = client->channels ? client->channels : 16; size <= channel; size *= 2) { }
+    if ((grown = (struct eb_channel*)realloc(client->channel, size * sizeof(struct eb_channel))) == 0) return -1;
+    memset(grown + client->channels, 0, (size - client->channels) * sizeof(struct eb_channel));
+    client->channel = grown;
+    client->channels = size;
+  }
+  
+  if (client->channel[channel].open) return -1; /* protocol violation */
+  
+  strcpy(address, "udp/"); /* We only tunnel udp */
+  if (len > (int)sizeof(address)-5) len = sizeof(address)-5;
+  memcpy(address+4, name, len);
+  address[len+4] = 0;
+  
+  if (eb_posix_udp_connect(&client->udp_transport, &client->channel[channel].udp_slave, address, 0) != EB_OK) {
+    eb_close_channel(tcp_transport, client, channel);
+    return 0;
+  }
+  
+  /* Responses are told apart by their sender, so targets must differ */
+  link = (struct eb_posix_udp_link*)&client->channel[channel].udp_slave;
+  for (i = 0; i < client->channels; ++i) {
+    if (eb_same_peer(&client->channel[i], link->sa)) {
+      eb_posix_udp_disconnect(&client->udp_transport, &client->channel[channel].udp_slave);
+      eb_close_channel(tcp_transport, client, channel);
+      return 0;
+    }
+  }
+  
+  client->channel[channel].open = 1;
+  return 0;
+}
+
+static int eb_serve_mux(struct eb_transport* tcp_transport, struct eb_client* client, eb_user_data_t data, eb_descriptor_callback_t ready) {
+  struct eb_posix_udp_transport* udp;
+  uint8_t buffer[MAX_MTU];
+  uint8_t header[4];
+  int len, got, channel, fail;
+  
+  fail = 0;
+  got = 0;
+  udp = (struct eb_posix_udp_transport*)&client->udp_transport;
+  
+  /* UDP => TCP: tag each datagram with the channel of its sender */
+  tx_len = 0;
+  while ((len = eb_posix_udp_poll(&client->udp_transport, 0, data, ready, &tx_buf[tx_len+4], MAX_MTU)) > 0) {
+    if ((channel = eb_find_channel(client, &udp->batch->peer)) == -1) continue;
+    
+    tx_buf[tx_len+0] = (len >> 8) & 0xFF;
+    tx_buf[tx_len+1] = len & 0xFF;
+    tx_buf[tx_len+2] = (channel >> 8) & 0xFF;
+    tx_buf[tx_len+3] = channel & 0xFF;
+    tx_len += len+4;
+    
+    if (tx_len + MAX_MTU+4 > TX_SIZE) {
+      eb_posix_tcp_send(tcp_transport, &client->tcp_master, &tx_buf[0], tx_len);
+      tx_len = 0;
+    }
+  }
+  if (len < 0) fail = 1;
+  
+  if (tx_len > 0)
+    eb_posix_tcp_send(tcp_transport, &client->tcp_master, &tx_buf[0], tx_len);
+  
+  /* TCP => UDP: route each frame by its channel */
+  eb_posix_udp_send_buffer(&client->udp_transport, 0, 1);
+  while (!fail && (got = eb_posix_tcp_poll(tcp_transport, &client->tcp_master, data, ready, &header[0], 4)) > 0) {
+    if (eb_recv_all(tcp_transport, &client->tcp_master, &header[got], 4-got) < 0) {
+      fail = 1;
+      break;
+    }
+    
+    len = ((unsigned int)header[0]) << 8 | header[1];
+    channel = ((unsigned int)header[2]) << 8 | header[3];
+    
+    if (len > MAX_MTU || eb_recv_all(tcp_transport, &client->tcp_master, &buffer[0], len) != len) {
+      fail = 1;
+      break;
+    }
+    
+    if ((channel & EB_TUNNEL_MUX_CONTROL) != 0) {
+      channel &= ~EB_TUNNEL_MUX_CONTROL;
+      
+      if (len > 0) {
+        if (eb_open_channel(tcp_transport, client, channel, &buffer[0], len) != 0) fail = 1;
+      } else if (channel < client->channels && client->channel[channel].open) {
+        eb_posix_udp_disconnect(&client->udp_transport, &client->channel[channel].udp_slave);
+        client->channel[channel].open = 0;
+      }
+    } else if (channel < client->channels && client->channel[channel].open) {
+      eb_posix_udp_send(&client->udp_transport, &client->channel[channel].udp_slave, &buffer[0], len);
+    }
+  }
+  if (got < 0) fail = 1;
+  eb_posix_udp_send_buffer(&client->udp_transport, 0, 0);
+  
+  return fail ? -1 : 0;
+}
+
+/* Move everything ready in both directions. Returns -1 if the client must go. */
+static int eb_serve_client(struct eb_transport* tcp_transport, struct eb_client* client, eb_user_data_t data, eb_descriptor_callback_t ready) {
+  uint8_t buffer[MAX_MTU];
+  uint8_t len_buf[2];
+  int len, fail;
+  
+  if (client->mux) return eb_serve_mux(tcp_transport, client, data, ready);
+  
+  fail = 0;
+  
+  /* UDP => TCP: pack the datagrams and write them together */
+  tx_len = 0;
+  while ((len = eb_posix_udp_poll(&client->udp_transport, 0, data, ready, &tx_buf[tx_len+2], MAX_MTU)) > 0) {
+    tx_buf[tx_len+0] = (len >> 8) & 0xFF;
+    tx_buf[tx_len+1] = len & 0xFF;
+    tx_len += len+2;
+    
+    if (tx_len + MAX_MTU+2 > TX_SIZE) {
+      eb_posix_tcp_send(tcp_transport, &client->tcp_master, &tx_buf[0], tx_len);
+      tx_len = 0;
+    }
+  }
+  if (len < 0) fail = 1;
+  
+  if (tx_len > 0)
+    eb_posix_tcp_send(tcp_transport, &client->tcp_master, &tx_buf[0], tx_len);
+  
+  /* TCP => UDP: queue the datagrams and send them together */
+  eb_posix_udp_send_buffer(&client->udp_transport, &client->udp_slave, 1);
+  while (!fail && (len = eb_posix_tcp_poll(tcp_transport, &client->tcp_master, data, ready, &len_buf[0], 2)) > 0) {
+    if (len == 1)
+      len += eb_posix_tcp_recv(tcp_transport, &client->tcp_master, &len_buf[1], 1);
+    
+    if (len != 2) {
+      fail = 1;
+      break;
+    }
+    
+    len = ((unsigned int)len_buf[0]) << 8 | len_buf[1];
+    if (len > MAX_MTU) {
+      fail = 1;
+      break;
+    } 
+    
+    if (eb_recv_all(tcp_transport, &client->tcp_master, &buffer[0], len) != len) {
+      fail = 1;
+      break;
+    }
+    
+    eb_posix_udp_send(&client->udp_transport, &client->udp_slave, &buffer[0], len);
+  }
+  if (len < 0) fail = 1;
+  eb_posix_udp_send_buffer(&client->udp_transport, &client->udp_slave, 0);
+  
+  return fail ? -1 : 0;
+}
+
+#ifdef EB_TUNNEL_EPOLL
+
+/* Which client owns a descriptor, and what epoll reported for it */
+static struct eb_client** fd_owner;
+static uint8_t* fd_ready;
+static int fd_size;
+static int epoll_fd;
+
+static int eb_epoll_add(eb_user_data_t data, eb_descriptor_t fd, uint8_t mode) {
+  struct epoll_event ev;
+  int size;
+  
+  if (fd >= fd_size) {
+    for (size = fd_size ? fd_size : 1024; size <= fd; size *= 2) { }
+    fd_owner = (struct eb_client**)realloc(fd_owner, size * sizeof(struct eb_client*));
+    fd_ready = (uint8_t*)realloc(fd_ready, size);
+    if (fd_owner == 0 || fd_ready == 0) return -1;
+    memset(fd_ready + fd_size, 0, size - fd_size);
+    fd_size = size;
+  }
+  
+  fd_owner[fd] = (struct eb_client*)data;
+  
+  memset(&ev, 0, sizeof(ev));
+  ev.events = 0;
+  if ((mode & EB_DESCRIPTOR_IN)  != 0) ev.events |= EPOLLIN;
+  if ((mode & EB_DESCRIPTOR_OUT) != 0) ev.events |= EPOLLOUT;
+  ev.data.fd = fd;
+  
+  return epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static int eb_epoll_check(eb_user_data_t data, eb_descriptor_t fd, uint8_t mode) {
+  return fd < fd_size && (fd_ready[fd] & mode) != 0;
+}
+
+static int eb_tunnel_run(struct eb_transport* tcp_transport, struct eb_client* first) {
+  struct epoll_event events[MAX_EVENTS];
+  struct eb_client* active[MAX_EVENTS];
+  struct eb_client* client;
+  struct eb_client* head;
+  struct rlimit limit;
+  int i, n, nactive, len, fd;
+  
+  /* Hundreds of clients use more than the default descriptor limit */
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0 && limit.rlim_cur < limit.rlim_max) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+  
+  if ((epoll_fd = epoll_create1(0)) == -1) {
+    perror("Cannot create epoll instance");
+    return 1;
+  }
+  
+  eb_posix_tcp_fdes(tcp_transport, 0, 0, &eb_epoll_add);
+  
+  while (1) {
+    if ((n = epoll_wait(epoll_fd, &events[0], MAX_EVENTS, -1)) < 0) continue;
+    
+    /* Record readiness and collect each affected client once */
+    nactive = 0;
+    for (i = 0; i < n; ++i) {
+      fd = events[i].data.fd;
+      if ((events[i].events & (EPOLLIN|EPOLLHUP|EPOLLERR)) != 0) fd_ready[fd] |= EB_DESCRIPTOR_IN;
+      if ((events[i].events & EPOLLOUT) != 0) fd_ready[fd] |= EB_DESCRIPTOR_OUT;
+      
+      client = fd_owner[fd];
+      if (client != 0 && !client->pending) {
+        client->pending = 1;
+        active[nactive++] = client;
+      }
+    }
+    
+    /* TCP accept? */
+    while ((len = eb_posix_tcp_accept(tcp_transport, &first->tcp_master, 0, &eb_epoll_check)) > 0) {
+      head = first;
+      first = eb_new_client(tcp_transport, first);
+      if (first == head) continue;
+      
+      eb_posix_tcp_fdes(tcp_transport, &head->tcp_master, head, &eb_epoll_add);
+      eb_posix_udp_fdes(&head->udp_transport, 0, head, &eb_epoll_add);
+      
+      /* Reading the address may have buffered the first datagrams */
+      if (eb_serve_client(tcp_transport, head, 0, &eb_epoll_check) != 0)
+        eb_free_client(tcp_transport, head);
+    }
+    if (len < 0) {
+      perror("Failed to accept a connection");
+      return 1;
+    }
+    
+    for (i = 0; i < nactive; ++i) {
+      client = active[i];
+      client->pending = 0;
+      if (eb_serve_client(tcp_transport, client, 0, &eb_epoll_check) != 0)
+        eb_free_client(tcp_transport, client);
+    }
+    
+    for (i = 0; i < n; ++i)
+      fd_ready[events[i].data.fd] = 0;
+  }
+}
+
+#else
+
 struct eb_block_sets {
   int nfd;
   fd_set rfds;
@@ -107,17 +510,62 @@ static int eb_check_sets(eb_user_data_t data, eb_descriptor_t fd, uint8_t mode)
     (((mode & EB_DESCRIPTOR_OUT) != 0) && FD_ISSET(fd, &set->wfds));
 }
 
-int main(int argc, const char** argv) {
+static int eb_tunnel_run(struct eb_transport* tcp_transport, struct eb_client* first) {
   struct eb_block_sets sets;
-  struct eb_transport tcp_transport;
-  struct eb_client* first;
   struct eb_client* client;
   struct eb_client* next;
-  struct eb_client* prev;
-  int len, fail;
+  struct eb_client* head;
+  int len;
+  
+  while (1) {
+    /* Block for a link to go active: */
+    FD_ZERO(&sets.rfds);
+    FD_ZERO(&sets.wfds);
+    sets.nfd = 0;
+    
+    /* All all descriptors to blocking list */
+    eb_posix_tcp_fdes(tcp_transport, 0, &sets, &eb_update_sets);
+    
+    for (client = first->next; client != 0; client = client->next) {
+      eb_posix_tcp_fdes(tcp_transport, &client->tcp_master, &sets, &eb_update_sets);
+      eb_posix_udp_fdes(&client->udp_transport, 0, &sets, &eb_update_sets);
+    }
+    
+    /* Wait for one to go active: */
+    select(sets.nfd+1, &sets.rfds, &sets.wfds, 0, 0);
+    
+    /* Now poll all links: */
+    
+    /* TCP accept? */
+    len = 0;
+    while ((len = eb_posix_tcp_accept(tcp_transport, &first->tcp_master, &sets, &eb_check_sets)) > 0) {
+      head = first;
+      first = eb_new_client(tcp_transport, first);
+      if (first == head) continue;
+      
+      /* Reading the address may have buffered the first datagrams */
+      if (eb_serve_client(tcp_transport, head, &sets, &eb_check_sets) != 0)
+        eb_free_client(tcp_transport, head);
+    }
+    if (len < 0) {
+      perror("Failed to accept a connection");
+      return 1;
+    }
+    
+    for (client = first->next; client != 0; client = next) {
+      next = client->next;
+      if (eb_serve_client(tcp_transport, client, &sets, &eb_check_sets) != 0)
+        eb_free_client(tcp_transport, client);
+    }
+  }
+}
+
+#endif
+
+int main(int argc, const char** argv) {
+  struct eb_transport tcp_transport;
+  struct eb_client* first;
   eb_status_t err;
-  uint8_t buffer[MAX_MTU+2];
-  uint8_t len_buf[2];
 #ifdef  __WIN32
   WORD wVersionRequested;
   WSADATA wsaData;
@@ -147,87 +595,12 @@ int main(int argc, const char** argv) {
     return 1;
   }
   first->next = 0;
+  first->prev = 0;
+  first->pending = 0;
+  first->mux = 0;
+  first->channels = 0;
+  first->last_channel = 0;
+  first->channel = 0;
   
-  while (1) {
-    /* Block for a link to go active: */
-    FD_ZERO(&sets.rfds);
-    FD_ZERO(&sets.wfds);
-    sets.nfd = 0;
-    
-    /* All all descriptors to blocking list */
-    eb_posix_tcp_fdes(&tcp_transport, 0, &sets, &eb_update_sets);
-    
-    for (client = first->next; client != 0; client = client->next) {
-      eb_posix_tcp_fdes(&tcp_transport, &client->tcp_master, &sets, &eb_update_sets);
-      eb_posix_udp_fdes(&client->udp_transport, 0, &sets, &eb_update_sets);
-    }
-    
-    /* Wait for one to go active: */
-    select(sets.nfd+1, &sets.rfds, &sets.wfds, 0, 0);
-    
-    /* Now poll all links: */
-    
-    /* TCP accept? */
-    len = 0;
-    while ((len = eb_posix_tcp_accept(&tcp_transport, &first->tcp_master, &sets, &eb_check_sets)) > 0) {
-      first = eb_new_client(&tcp_transport, first);
-    }
-    if (len < 0) {
-      perror("Failed to accept a connection");
-      break;
-    }
-    
-    prev = first;
-    for (client = prev->next; client != 0; client = next) {
-      next = client->next;
-      
-      fail = 0;
-      
-      len = 0;
-      while ((len = eb_posix_udp_poll(&client->udp_transport, 0, &sets, &eb_check_sets, &buffer[2], MAX_MTU)) > 0) {
-        buffer[0] = (len >> 8) & 0xFF;
-        buffer[1] = len & 0xFF;
-      
-        eb_posix_tcp_send(&tcp_transport, &client->tcp_master, &buffer[0], len+2);
-      }
-      if (len < 0) fail = 1;
-      
-      len = 0;
-      while ((len = eb_posix_tcp_poll(&tcp_transport, &client->tcp_master, &sets, &eb_check_sets, &len_buf[0], 2)) > 0) {
-        if (len == 1)
-          len += eb_posix_tcp_recv(&tcp_transport, &client->tcp_master, &len_buf[1], 1);
-        
-        if (len != 2) {
-          fail = 1;
-          break;
-        }
-        
-        len = ((unsigned int)len_buf[0]) << 8 | len_buf[1];
-        if (len > MAX_MTU) {
-          fail = 1;
-          break;
-        } 
-        
-        if (eb_posix_tcp_recv(&tcp_transport, &client->tcp_master, &buffer[0], len) != len) {
-          fail = 1;
-          break;
-        }
-        
-        eb_posix_udp_send(&client->udp_transport, &client->udp_slave, &buffer[0], len);
-      }
-      if (len < 0) fail = 1;
-      
-      if (fail) {
-        eb_posix_tcp_disconnect(&tcp_transport, &client->tcp_master);
-        eb_posix_udp_disconnect(&client->udp_transport, &client->udp_slave);
-        eb_posix_udp_close(&client->udp_transport);
-        prev->next = client->next;
-        free(client);
-      } else {
-        prev = client;
-      }
-    }
-  }
-  
-  return 1;
+  return eb_tunnel_run(&tcp_transport, first);
 }
@@ -35,6 +35,7 @@
 #include "../glue/strncasecmp.h"
 
 #include <fcntl.h>
+#include <stdlib.h>
 #include <unistd.h>
 #include <errno.h>
 #include <string.h>
@@ -47,10 +48,10 @@
 static void eb_dev_set_blocking(struct eb_dev_link* link, int block) {
   int flags;
   
-  flags = (link->flags & ~O_NONBLOCK) | (block?0:O_NONBLOCK);
-  if (flags != link->flags) {
+  flags = (link->state->flags & ~O_NONBLOCK) | (block?0:O_NONBLOCK);
+  if (flags != link->state->flags) {
     fcntl(link->fdes, F_SETFL, flags);
-    link->flags = flags;
+    link->state->flags = flags;
   }
 }
 
@@ -87,12 +88,17 @@ eb_status_t eb_dev_connect(struct eb_transport* transportp, struct eb_link* link
   strcpy(devpath, "/dev/");
   strncat(devpath, devname, sizeof(devpath)-8);
   
+  if ((link->state = (struct eb_dev_state*)malloc(sizeof(struct eb_dev_state))) == 0)
+    return EB_OOM;
+  
   if ((fdes = open(devpath, O_BINARY | O_RDWR)) == -1) {
+    free(link->state);
     return EB_FAIL;
   }
   
   link->fdes = fdes;
-  link->flags = fcntl(fdes, F_GETFL, 0);
+  link->state->flags = fcntl(fdes, F_GETFL, 0);
+  eb_stream_rx_reset(&link->state->rx);
 
   /* If this is a serial device, enter raw mode */
   if (tcgetattr(fdes, &ios) == 0) {
@@ -117,6 +123,7 @@ void eb_dev_disconnect(struct eb_transport* transport, struct eb_link* linkp) {
   
   link = (struct eb_dev_link*)linkp;
   close(link->fdes);
+  free(link->state);
 }
 
 void eb_dev_fdes(struct eb_transport* transportp, struct eb_link* linkp, eb_user_data_t data, eb_descriptor_callback_t cb) {
@@ -135,11 +142,17 @@ int eb_dev_accept(struct eb_transport* transportp, struct eb_link* result_linkp,
 
 int eb_dev_poll(struct eb_transport* transportp, struct eb_link* linkp, eb_user_data_t data, eb_descriptor_callback_t ready, uint8_t* buf, int len) {
   struct eb_dev_link* link;
+  struct eb_stream_rx* rx;
   int result;
   
   if (linkp == 0) return 0;
   
   link = (struct eb_dev_link*)linkp;
+  rx = &link->state->rx;
+  
+  /* Anything left over from the last read? */
+  if ((result = eb_stream_rx_take(rx, buf, len)) != 0)
+    return result;
   
   /* Should we check? */
   if (!(*ready)(data, link->fdes, EB_DESCRIPTOR_IN))
@@ -147,29 +160,43 @@ int eb_dev_poll(struct eb_transport* transportp, struct eb_link* linkp, eb_user_
   
   /* Set non-blocking */
   eb_dev_set_blocking(link, 0);
-  result = read(link->fdes, (char*)buf, len);
+  result = read(link->fdes, (char*)&rx->buf[0], sizeof(rx->buf));
   
   if (result == -1 && eb_dev_ewouldblock()) return 0;
-  if (result == 0) return -1;
-  return result;
+  if (result <= 0) return -1;
+  
+  eb_stream_rx_fill(rx, result);
+  return eb_stream_rx_take(rx, buf, len);
 }
 
 int eb_dev_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8_t* buf, int len) {
   struct eb_dev_link* link;
+  struct eb_stream_rx* rx;
   int result;
   
   if (linkp == 0) return 0;
   
   link = (struct eb_dev_link*)linkp;
+  rx = &link->state->rx;
+  
+  if ((result = eb_stream_rx_take(rx, buf, len)) != 0)
+    return result;
 
   /* Set blocking */
   eb_dev_set_blocking(link, 1);
 
-  result = read(link->fdes, buf, len);
+  result = read(link->fdes, &rx->buf[0], sizeof(rx->buf));
   
   /* EAGAIN impossible on blocking read */
-  if (result == 0) return -1;
-  return result;
+  if (result <= 0) return -1;
+  
+  eb_stream_rx_fill(rx, result);
+  return eb_stream_rx_take(rx, buf, len);
+}
+
+uint64_t eb_dev_stamp(struct eb_transport* transportp, struct eb_link* linkp) {
+  /* Device reads carry no receive time */
+  return 0;
 }
 
 void eb_dev_send(struct eb_transport* transportp, struct eb_link* linkp, const uint8_t* buf, int len) {
@@ -30,6 +30,7 @@
 #define EB_DEV_H
 
 #include "../transport/transport.h"
+#include "stream.h"
 
 #define EB_DEV_MTU 0
 
@@ -41,6 +42,7 @@ EB_PRIVATE void eb_dev_fdes(struct eb_transport*, struct eb_link* link, eb_user_
 EB_PRIVATE int eb_dev_accept(struct eb_transport*, struct eb_link* result_link, eb_user_data_t data, eb_descriptor_callback_t ready);
 EB_PRIVATE int eb_dev_poll(struct eb_transport* transportp, struct eb_link* linkp, eb_user_data_t data, eb_descriptor_callback_t ready, uint8_t* buf, int len);
 EB_PRIVATE int eb_dev_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8_t* buf, int len);
+EB_PRIVATE uint64_t eb_dev_stamp(struct eb_transport* transportp, struct eb_link* linkp);
 EB_PRIVATE void eb_dev_send(struct eb_transport* transportp, struct eb_link* linkp, const uint8_t* buf, int len);
 EB_PRIVATE void eb_dev_send_buffer(struct eb_transport* transportp, struct eb_link* linkp, int on);
 
@@ -49,10 +51,15 @@ struct eb_dev_transport {
   char reserved[9];
 };
 
+struct eb_dev_state {
+  int flags; /* last fcntl F_SETFL */
+  struct eb_stream_rx rx;
+};
+
 struct eb_dev_link {
   /* Contents must fit in 12 bytes */
+  struct eb_dev_state* state;
   int fdes;
-  int flags;
 };
 
 #endif
@@ -34,6 +34,7 @@
 #include "../format/bigendian.h"
 #include "../etherbone.h"
 #include "lm32.h"
+#include "../glue/socket.h"
 
 
 #define IP_START	0
@@ -281,6 +282,14 @@ EB_PRIVATE void eb_lm32_udp_send(struct eb_transport* transportp, struct eb_link
 
 
 int eb_socket_run(eb_socket_t socket, int timeout_us) {return 0;}
+eb_status_t eb_socket_thread(eb_socket_t socket, int cpu) {return EB_FAIL;}
+void eb_transport_prefetch(const char* const* addresses, int count) {}
+void eb_socket_lock(eb_socket_t socket) {}
+void eb_socket_unlock(eb_socket_t socket) {}
+void eb_socket_join(struct eb_queue* queue) {}
+void eb_socket_block(eb_socket_t socket, int* busy, void** cond) { while (*busy > 0) eb_socket_run(socket, -1); }
+void eb_socket_unblock(void* cond) {}
+uint32_t eb_socket_clock(void) {return 0;}
 EB_PRIVATE void eb_lm32_udp_send_buffer(struct eb_transport* transportp, struct eb_link* linkp, int on) {};
 EB_PRIVATE void eb_lm32_udp_fdes(struct eb_transport* transportp, struct eb_link* link, eb_user_data_t data, eb_descriptor_callback_t cb) {};
 EB_PRIVATE int eb_lm32_udp_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8_t* buf, int len) {return 0;}
@@ -5,6 +5,10 @@
  *
  *  Implements common IPv4/6 agnostic socket handling.
  *
+ *  Name lookups are cached for a minute, so opening many devices on the
+ *  same hosts resolves each name once. eb_posix_ip_prefetch fills the
+ *  cache from several threads before a batch of connects.
+ *
  *  @author Wesley W. Terpstra <w.terpstra@gsi.de>
  *
  *  @bug None!
@@ -27,14 +31,69 @@
 
 #define ETHERBONE_IMPL
 
+#ifdef __linux__
+#define _GNU_SOURCE /* SO_TIMESTAMPNS + EAI_NODATA, EAI_ADDRFAMILY */
+#endif
+
 #include "posix-ip.h"
 #include "../glue/strncasecmp.h"
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+
+#ifndef __WIN32
+#include <pthread.h>
+#endif
 
 #define EB_DEFAULT_PORT_STR "60368" /* 0xEBD0 */
 
+#define EB_POSIX_IP_CACHE     64 /* remembered lookups, beyond those of a prefetch */
+#define EB_POSIX_IP_WARMED     2 /* lookups eb_posix_ip_warm remembers per address */
+#define EB_POSIX_IP_TTL       60 /* seconds a lookup stays valid */
+#define EB_POSIX_IP_MISS_TTL   5 /* seconds a name known not to exist stays so */
+#define EB_POSIX_IP_RESOLVERS 16 /* threads used by eb_posix_ip_prefetch */
+
+struct eb_posix_ip_cached {
+  char host[250];
+  char port[32];
+  int family, type;
+  time_t expires;
+  socklen_t len; /* -1 if the lookup failed */
+  struct sockaddr_storage sa;
+};
+
+static struct eb_posix_ip_cached* eb_posix_ip_cache; /* grown, never freed */
+static int eb_posix_ip_cache_size;
+static int eb_posix_ip_cache_next;
+
+#ifndef __WIN32
+static pthread_mutex_t eb_posix_ip_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+#define EB_POSIX_IP_LOCK()   pthread_mutex_lock(&eb_posix_ip_cache_lock)
+#define EB_POSIX_IP_UNLOCK() pthread_mutex_unlock(&eb_posix_ip_cache_lock)
+#else
+#define EB_POSIX_IP_LOCK()
+#define EB_POSIX_IP_UNLOCK()
+#endif
+
+/* Make room for size lookups; call with the lock held. 0 on failure */
+static int eb_posix_ip_reserve(int size) {
+  struct eb_posix_ip_cached* cache;
+  
+  if (size <= eb_posix_ip_cache_size) return 1;
+  
+  cache = (struct eb_posix_ip_cached*)realloc(eb_posix_ip_cache, size * sizeof(struct eb_posix_ip_cached));
+  if (cache == 0) return 0;
+  
+  /* Fill the new slots before overwriting anything remembered */
+  memset(&cache[eb_posix_ip_cache_size], 0, (size - eb_posix_ip_cache_size) * sizeof(struct eb_posix_ip_cached));
+  eb_posix_ip_cache_next = eb_posix_ip_cache_size;
+  eb_posix_ip_cache = cache;
+  eb_posix_ip_cache_size = size;
+  return 1;
+}
+
 void eb_posix_ip_close(eb_posix_sock_t sock) {
   if (sock == -1) return;
 #ifdef __WIN32
@@ -92,6 +151,8 @@ eb_posix_sock_t eb_posix_ip_open(int family, int type, const char* port) {
   freeaddrinfo(match);
   if (!i) return -1;
   
+  eb_posix_ip_stamps(sock);
+  
   /* Etherbone can broadcast over UDP */
   if (sock != -1 && protocol == IPPROTO_UDP) {
     optval = 1;
@@ -101,8 +162,82 @@ eb_posix_sock_t eb_posix_ip_open(int family, int type, const char* port) {
   return sock;
 }
 
-socklen_t eb_posix_ip_resolve(const char* prefix, const char* address, int family, int type, struct sockaddr_storage* out) {
+static socklen_t eb_posix_ip_lookup(const char* host, const char* port, int family, int type, int protocol, struct sockaddr_storage* out) {
+  struct eb_posix_ip_cached* entry;
   struct addrinfo hints, *match;
+  time_t now;
+  socklen_t len;
+  int i, error, ttl;
+  
+  now = time(0);
+  
+  EB_POSIX_IP_LOCK();
+  for (i = 0; i < eb_posix_ip_cache_size; ++i) {
+    entry = &eb_posix_ip_cache[i];
+    if (entry->expires > now && entry->family == family && entry->type == type &&
+        !strcmp(entry->host, host) && !strcmp(entry->port, port)) {
+      len = entry->len;
+      if (len != -1) memcpy(out, &entry->sa, len);
+      EB_POSIX_IP_UNLOCK();
+      return len;
+    }
+  }
+  EB_POSIX_IP_UNLOCK();
+  
+  memset(&hints, 0, sizeof(struct addrinfo));
+  hints.ai_family = family;
+  hints.ai_socktype = type;     /* STREAM/DGRAM as requested */
+  hints.ai_protocol = protocol; /* TCP/UDP over IP to exclude non IPv* protocols */
+  hints.ai_flags = 0;
+  
+  if ((error = getaddrinfo(host, port, &hints, &match)) != 0) {
+    len = -1;
+  } else {
+    memcpy(out, match->ai_addr, match->ai_addrlen);
+    len = match->ai_addrlen;
+    freeaddrinfo(match);
+  }
+  
+  /* Only an answer that the name does not exist is remembered, and briefly;
+   * a missing AAAA record is the common case. Anything else, like a
+   * resolver which did not answer in time, is worth asking again.
+   */
+  if (len != -1) {
+    ttl = EB_POSIX_IP_TTL;
+  } else if (error == EAI_NONAME) {
+    ttl = EB_POSIX_IP_MISS_TTL;
+#ifdef EAI_NODATA
+  } else if (error == EAI_NODATA) {
+    ttl = EB_POSIX_IP_MISS_TTL;
+#endif
+#ifdef EAI_ADDRFAMILY
+  } else if (error == EAI_ADDRFAMILY) {
+    ttl = EB_POSIX_IP_MISS_TTL;
+#endif
+  } else {
+    return -1;
+  }
+  
+  if (strlen(port) < sizeof(entry->port)) {
+    EB_POSIX_IP_LOCK();
+    if (eb_posix_ip_reserve(EB_POSIX_IP_CACHE)) {
+      entry = &eb_posix_ip_cache[eb_posix_ip_cache_next];
+      eb_posix_ip_cache_next = (eb_posix_ip_cache_next + 1) % eb_posix_ip_cache_size;
+      strcpy(entry->host, host);
+      strcpy(entry->port, port);
+      entry->family = family;
+      entry->type = type;
+      entry->expires = now + ttl;
+      entry->len = len;
+      if (len != -1) memcpy(&entry->sa, out, len);
+    }
+    EB_POSIX_IP_UNLOCK();
+  }
+  
+  return len;
+}
+
+socklen_t eb_posix_ip_resolve(const char* prefix, const char* address, int family, int type, struct sockaddr_storage* out) {
   int len, protocol;
   char host[250];
   const char* port, *slash;
@@ -135,20 +270,67 @@ socklen_t eb_posix_ip_resolve(const char* prefix, const char* address, int famil
   default: return -1;
   }
   
-  memset(&hints, 0, sizeof(struct addrinfo));
-  hints.ai_family = family;
-  hints.ai_socktype = type;     /* STREAM/DGRAM as requested */
-  hints.ai_protocol = protocol; /* TCP/UDP over IP to exclude non IPv* protocols */
-  hints.ai_flags = 0;
+  return eb_posix_ip_lookup(host, port, family, type, protocol, out);
+}
+
+/* The lookups eb_posix_{udp,tcp}_connect will make */
+static void eb_posix_ip_warm(const char* address) {
+  struct sockaddr_storage sa;
   
-  if (getaddrinfo(host, port, &hints, &match) != 0)
-    return -1;
+  if (eb_posix_ip_resolve("udp4/", address, PF_INET,  SOCK_DGRAM,  &sa) != -1) return;
+  if (eb_posix_ip_resolve("tcp4/", address, PF_INET,  SOCK_STREAM, &sa) != -1) return;
+#ifndef EB_DISABLE_IPV6
+  if (eb_posix_ip_resolve("udp6/", address, PF_INET6, SOCK_DGRAM,  &sa) != -1) return;
+  if (eb_posix_ip_resolve("tcp6/", address, PF_INET6, SOCK_STREAM, &sa) != -1) return;
+  if (eb_posix_ip_resolve("udp/",  address, PF_INET6, SOCK_DGRAM,  &sa) != -1) return;
+  if (eb_posix_ip_resolve("tcp/",  address, PF_INET6, SOCK_STREAM, &sa) != -1) return;
+#endif
+  if (eb_posix_ip_resolve("udp/",  address, PF_INET,  SOCK_DGRAM,  &sa) != -1) return;
+  if (eb_posix_ip_resolve("tcp/",  address, PF_INET,  SOCK_STREAM, &sa) != -1) return;
+}
+
+#ifndef __WIN32
+struct eb_posix_ip_batch {
+  const char* const* addresses;
+  int count;
+  int next;
+};
+
+static void* eb_posix_ip_resolver(void* arg) {
+  struct eb_posix_ip_batch* batch = (struct eb_posix_ip_batch*)arg;
+  int i;
   
-  memcpy(out, match->ai_addr, match->ai_addrlen);
-  len = match->ai_addrlen;
+  while ((i = __atomic_fetch_add(&batch->next, 1, __ATOMIC_RELAXED)) < batch->count)
+    eb_posix_ip_warm(batch->addresses[i]);
   
-  freeaddrinfo(match);
-  return len;
+  return 0;
+}
+#endif
+
+void eb_posix_ip_prefetch(const char* const* addresses, int count) {
+#ifndef __WIN32
+  struct eb_posix_ip_batch batch;
+  pthread_t threads[EB_POSIX_IP_RESOLVERS];
+  int i, started;
+  
+  batch.addresses = addresses;
+  batch.count = count;
+  batch.next = 0;
+  
+  /* Keep every warmed lookup until the connects which follow can use it */
+  EB_POSIX_IP_LOCK();
+  eb_posix_ip_reserve(EB_POSIX_IP_CACHE + EB_POSIX_IP_WARMED*count);
+  EB_POSIX_IP_UNLOCK();
+  
+  for (started = 0; started < EB_POSIX_IP_RESOLVERS && started < count; ++started)
+    if (pthread_create(&threads[started], 0, &eb_posix_ip_resolver, &batch) != 0) break;
+  
+  /* Help out; this also covers a system which refused us threads */
+  eb_posix_ip_resolver(&batch);
+  
+  for (i = 0; i < started; ++i)
+    pthread_join(threads[i], 0);
+#endif
 }
 
 void eb_posix_ip_force_non_blocking(eb_posix_sock_t sock, unsigned long on) {
@@ -185,3 +367,59 @@ int eb_posix_ip_ewouldblock(void) {
   return errno == EAGAIN || errno == EWOULDBLOCK;
 #endif
 }
+
+void eb_posix_ip_stamps(eb_posix_sock_t sock) {
+#ifdef EB_POSIX_IP_STAMPS
+  int optval;
+  
+  optval = 1;
+  setsockopt(sock, SOL_SOCKET, SO_TIMESTAMPNS, (char*)&optval, sizeof(optval));
+#endif
+}
+
+#ifdef EB_POSIX_IP_STAMPS
+uint64_t eb_posix_ip_stamp(struct msghdr* msg) {
+  struct cmsghdr* cmsg;
+  struct timespec ts;
+  
+  for (cmsg = CMSG_FIRSTHDR(msg); cmsg != 0; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+    if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_TIMESTAMPNS) {
+      memcpy(&ts, CMSG_DATA(cmsg), sizeof(ts));
+      return (uint64_t)ts.tv_sec*1000000000 + ts.tv_nsec;
+    }
+  }
+  
+  return 0;
+}
+#endif
+
+int eb_posix_ip_recv(eb_posix_sock_t sock, uint8_t* buf, int len, int flags, struct sockaddr_storage* sa, socklen_t* sa_len, uint64_t* stamp) {
+#ifdef EB_POSIX_IP_STAMPS
+  struct msghdr msg;
+  struct iovec iov;
+  char control[EB_POSIX_IP_CONTROL];
+  int result;
+  
+  iov.iov_base = buf;
+  iov.iov_len = len;
+  
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_name = sa;
+  msg.msg_namelen = sa ? *sa_len : 0;
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control;
+  msg.msg_controllen = sizeof(control);
+  
+  result = recvmsg(sock, &msg, flags);
+  if (sa) *sa_len = msg.msg_namelen;
+  *stamp = (result > 0) ? eb_posix_ip_stamp(&msg) : 0;
+  return result;
+#else
+  *stamp = 0;
+  if (sa)
+    return recvfrom(sock, (char*)buf, len, flags, (struct sockaddr*)sa, sa_len);
+  else
+    return recv(sock, (char*)buf, len, flags);
+#endif
+}
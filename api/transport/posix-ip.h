@@ -52,6 +52,12 @@ typedef SOCKET eb_posix_sock_t;
 typedef eb_descriptor_t eb_posix_sock_t;
 #endif
 
+/* Linux stamps each received packet with the time it arrived */
+#if defined(SO_TIMESTAMPNS) && defined(SCM_TIMESTAMPNS)
+#define EB_POSIX_IP_STAMPS
+#define EB_POSIX_IP_CONTROL 64 /* control buffer holding one receive stamp */
+#endif
+
 #if defined(MSG_DONTWAIT)
 #define EB_POSIX_IP_NON_BLOCKING_NOOP
 #else
@@ -61,9 +67,20 @@ typedef eb_descriptor_t eb_posix_sock_t;
 EB_PRIVATE void eb_posix_ip_close(eb_posix_sock_t sock);
 EB_PRIVATE eb_posix_sock_t eb_posix_ip_open(int family, int type, const char* port);
 EB_PRIVATE socklen_t eb_posix_ip_resolve(const char* prefix, const char* address, int family, int type, struct sockaddr_storage* out);
+EB_PRIVATE void eb_posix_ip_prefetch(const char* const* addresses, int count);
 EB_PRIVATE void eb_posix_ip_non_blocking(eb_posix_sock_t sock, unsigned long on);
 EB_PRIVATE void eb_posix_ip_force_non_blocking(eb_posix_sock_t sock, unsigned long on);
 EB_PRIVATE void eb_posix_ip_set_buffer(eb_posix_sock_t sock, int on);
 EB_PRIVATE int eb_posix_ip_ewouldblock(void); /* is errno = EAGAIN? */
 
+/* Ask the kernel to stamp the packets received on sock, where supported */
+EB_PRIVATE void eb_posix_ip_stamps(eb_posix_sock_t sock);
+/* recvfrom (sa may be 0), also returning the kernel receive time of the data.
+ * Stamps are nanoseconds since the epoch; 0 if the kernel gave none.
+ */
+EB_PRIVATE int eb_posix_ip_recv(eb_posix_sock_t sock, uint8_t* buf, int len, int flags, struct sockaddr_storage* sa, socklen_t* sa_len, uint64_t* stamp);
+#ifdef EB_POSIX_IP_STAMPS
+EB_PRIVATE uint64_t eb_posix_ip_stamp(struct msghdr* msg);
+#endif
+
 #endif
@@ -32,6 +32,8 @@
 #include "posix-tcp.h"
 #include "transport.h"
 
+#include <stdlib.h>
+
 eb_status_t eb_posix_tcp_open(struct eb_transport* transportp, const char* port) {
   struct eb_posix_tcp_transport* transport;
   eb_posix_sock_t sock4, sock6;
@@ -90,15 +92,24 @@ eb_status_t eb_posix_tcp_connect(struct eb_transport* transportp, struct eb_link
   if (len == -1) len = eb_posix_ip_resolve("tcp/",  address, PF_INET,  SOCK_STREAM, &sa);
   if (len == -1) return EB_ADDRESS;
   
+  if ((link->rx = (struct eb_stream_rx*)malloc(sizeof(struct eb_stream_rx))) == 0)
+    return EB_OOM;
+  
   sock = socket(sa.ss_family, SOCK_STREAM, IPPROTO_TCP);
-  if (sock == -1) return EB_FAIL;
+  if (sock == -1) {
+    free(link->rx);
+    return EB_FAIL;
+  }
   
   if (connect(sock, (struct sockaddr*)&sa, len) != 0) {
     eb_posix_ip_close(sock);
+    free(link->rx);
     return EB_FAIL;
   }
   
   eb_posix_ip_set_buffer(sock, 0); /* Default to off (for fast slave responses) */
+  eb_posix_ip_stamps(sock);
+  eb_stream_rx_reset(link->rx);
   link->socket = sock;
   return EB_OK;
 }
@@ -108,6 +119,7 @@ void eb_posix_tcp_disconnect(struct eb_transport* transport, struct eb_link* lin
   
   link = (struct eb_posix_tcp_link*)linkp;
   eb_posix_ip_close(link->socket);
+  free(link->rx);
 }
 
 void eb_posix_tcp_fdes(struct eb_transport* transportp, struct eb_link* linkp, eb_user_data_t data, eb_descriptor_callback_t cb) {
@@ -146,8 +158,15 @@ int eb_posix_tcp_accept(struct eb_transport* transportp, struct eb_link* result_
     return 0;
   
   if (result_linkp != 0) {
-    eb_posix_ip_set_buffer(sock, 0); /* Default to off (for fast slave responses) */
     result_link = (struct eb_posix_tcp_link*)result_linkp;
+    if ((result_link->rx = (struct eb_stream_rx*)malloc(sizeof(struct eb_stream_rx))) == 0) {
+      eb_posix_ip_close(sock);
+      return 0;
+    }
+    
+    eb_posix_ip_set_buffer(sock, 0); /* Default to off (for fast slave responses) */
+    eb_posix_ip_stamps(sock);
+    eb_stream_rx_reset(result_link->rx);
     result_link->socket = sock;
     return 1;
   } else {
@@ -164,6 +183,10 @@ int eb_posix_tcp_poll(struct eb_transport* transportp, struct eb_link* linkp, eb
   
   link = (struct eb_posix_tcp_link*)linkp;
   
+  /* Anything left over from the last read? */
+  if ((result = eb_stream_rx_take(link->rx, buf, len)) != 0)
+    return result;
+  
   /* Should we check? */
   if (!(*ready)(data, link->socket, EB_DESCRIPTOR_IN))
     return 0;
@@ -171,11 +194,14 @@ int eb_posix_tcp_poll(struct eb_transport* transportp, struct eb_link* linkp, eb
   /* Set non-blocking */
   eb_posix_ip_non_blocking(link->socket, 1);
   
-  result = recv(link->socket, (char*)buf, len, MSG_DONTWAIT);
+  /* Read as much as the kernel has; later polls are served from the buffer */
+  result = eb_posix_ip_recv(link->socket, &link->rx->buf[0], sizeof(link->rx->buf), MSG_DONTWAIT, 0, 0, &link->rx->stamp);
   
   if (result == -1 && eb_posix_ip_ewouldblock()) return 0;
-  if (result == 0) return -1;
-  return result;
+  if (result <= 0) return -1;
+  
+  eb_stream_rx_fill(link->rx, result);
+  return eb_stream_rx_take(link->rx, buf, len);
 }
 
 int eb_posix_tcp_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8_t* buf, int len) {
@@ -185,15 +211,29 @@ int eb_posix_tcp_recv(struct eb_transport* transportp, struct eb_link* linkp, ui
   if (linkp == 0) return 0;
   
   link = (struct eb_posix_tcp_link*)linkp;
+  
+  if ((result = eb_stream_rx_take(link->rx, buf, len)) != 0)
+    return result;
 
   /* Set blocking */
   eb_posix_ip_non_blocking(link->socket, 0);
 
-  result = recv(link->socket, (char*)buf, len, 0);
+  result = eb_posix_ip_recv(link->socket, &link->rx->buf[0], sizeof(link->rx->buf), 0, 0, 0, &link->rx->stamp);
   
   /* EAGAIN impossible on blocking read */
-  if (result == 0) return -1;
-  return result;
+  if (result <= 0) return -1;
+  
+  eb_stream_rx_fill(link->rx, result);
+  return eb_stream_rx_take(link->rx, buf, len);
+}
+
+uint64_t eb_posix_tcp_stamp(struct eb_transport* transportp, struct eb_link* linkp) {
+  struct eb_posix_tcp_link* link;
+  
+  if (linkp == 0) return 0;
+  
+  link = (struct eb_posix_tcp_link*)linkp;
+  return link->rx->stamp;
 }
 
 void eb_posix_tcp_send(struct eb_transport* transportp, struct eb_link* linkp, const uint8_t* buf, int len) {
@@ -30,6 +30,7 @@
 #define EB_POSIX_TCP_H
 
 #include "posix-ip.h"
+#include "stream.h"
 #include "../transport/transport.h"
 
 #define EB_POSIX_TCP_MTU 0
@@ -42,6 +43,7 @@ EB_PRIVATE void eb_posix_tcp_fdes(struct eb_transport*, struct eb_link* link, eb
 EB_PRIVATE int eb_posix_tcp_accept(struct eb_transport*, struct eb_link* result_link, eb_user_data_t data, eb_descriptor_callback_t ready);
 EB_PRIVATE int eb_posix_tcp_poll(struct eb_transport* transportp, struct eb_link* linkp, eb_user_data_t data, eb_descriptor_callback_t ready, uint8_t* buf, int len);
 EB_PRIVATE int eb_posix_tcp_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8_t* buf, int len);
+EB_PRIVATE uint64_t eb_posix_tcp_stamp(struct eb_transport* transportp, struct eb_link* linkp);
 EB_PRIVATE void eb_posix_tcp_send(struct eb_transport* transportp, struct eb_link* linkp, const uint8_t* buf, int len);
 EB_PRIVATE void eb_posix_tcp_send_buffer(struct eb_transport* transportp, struct eb_link* linkp, int on);
 
@@ -55,6 +57,7 @@ struct eb_posix_tcp_transport {
 
 struct eb_posix_tcp_link {
   /* Contents must fit in 12 bytes */
+  struct eb_stream_rx* rx; /* bytes read but not yet polled */
   eb_posix_sock_t socket;
 };
 
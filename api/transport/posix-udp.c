@@ -30,6 +30,11 @@
 
 /* #define PACKET_DEBUG 1 */
 
+#ifdef __linux__
+#define _GNU_SOURCE /* recvmmsg + sendmmsg */
+#define EB_POSIX_UDP_MMSG 1
+#endif
+
 #include "posix-ip.h"
 #include "posix-udp.h"
 #include "transport.h"
@@ -44,6 +49,7 @@
 
 eb_status_t eb_posix_udp_open(struct eb_transport* transportp, const char* port) {
   struct eb_posix_udp_transport* transport;
+  struct eb_posix_udp_batch* batch;
   eb_posix_sock_t sock4, sock6;
   
   sock4 = eb_posix_ip_open(PF_INET, SOCK_DGRAM, port);
@@ -57,7 +63,22 @@ eb_status_t eb_posix_udp_open(struct eb_transport* transportp, const char* port)
   if (sock4 == -1 && sock6 == -1) 
     return EB_BUSY;
   
+  if ((batch = (struct eb_posix_udp_batch*)malloc(sizeof(struct eb_posix_udp_batch))) == 0) {
+    eb_posix_ip_close(sock4);
+    eb_posix_ip_close(sock6);
+    return EB_OOM;
+  }
+  
+  batch->rx_next = 0;
+  batch->rx_count = 0;
+  batch->peer.ss_family = PF_INET;
+  batch->peer_len = 0;
+  batch->stamp = 0;
+  batch->tx_on = 0;
+  batch->tx_count = 0;
+  
   transport = (struct eb_posix_udp_transport*)transportp;
+  transport->batch = batch;
   transport->socket4 = sock4;
   transport->socket6 = sock6;
   
@@ -70,6 +91,7 @@ void eb_posix_udp_close(struct eb_transport* transportp) {
   transport = (struct eb_posix_udp_transport*)transportp;
   eb_posix_ip_close(transport->socket4);
   eb_posix_ip_close(transport->socket6);
+  free(transport->batch);
 }
 
 eb_status_t eb_posix_udp_connect(struct eb_transport* transportp, struct eb_link* linkp, const char* address, int passive) {
@@ -130,37 +152,129 @@ int eb_posix_udp_accept(struct eb_transport* transportp, struct eb_link* result_
   return 0;
 }
 
-/* !!! global is not the best approach. break multi-threading. */
-static struct sockaddr_storage eb_posix_udp_sa;
-static socklen_t eb_posix_udp_sa_len;
+/* Fill the receive batch from one socket. -1 on error, else datagram count. */
+static int eb_posix_udp_fill(struct eb_posix_udp_batch* batch, eb_posix_sock_t sock) {
+#ifdef EB_POSIX_UDP_MMSG
+  struct mmsghdr msg[EB_POSIX_UDP_BATCH];
+  struct iovec iov[EB_POSIX_UDP_BATCH];
+#ifdef EB_POSIX_IP_STAMPS
+  char control[EB_POSIX_UDP_BATCH][EB_POSIX_IP_CONTROL];
+#endif
+  int i, result;
+  
+  memset(&msg[0], 0, sizeof(msg));
+  for (i = 0; i < EB_POSIX_UDP_BATCH; ++i) {
+    iov[i].iov_base = &batch->rx_buf[i][0];
+    iov[i].iov_len = EB_POSIX_UDP_SLOT;
+    msg[i].msg_hdr.msg_name = &batch->rx_sa[i];
+    msg[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_storage);
+    msg[i].msg_hdr.msg_iov = &iov[i];
+    msg[i].msg_hdr.msg_iovlen = 1;
+#ifdef EB_POSIX_IP_STAMPS
+    msg[i].msg_hdr.msg_control = &control[i][0];
+    msg[i].msg_hdr.msg_controllen = EB_POSIX_IP_CONTROL;
+#endif
+  }
+  
+  result = recvmmsg(sock, &msg[0], EB_POSIX_UDP_BATCH, MSG_DONTWAIT, 0);
+  if (result == -1) return eb_posix_ip_ewouldblock() ? 0 : -1;
+  
+  for (i = 0; i < result; ++i) {
+    batch->rx_len[i] = msg[i].msg_len;
+    batch->rx_sa_len[i] = msg[i].msg_hdr.msg_namelen;
+#ifdef EB_POSIX_IP_STAMPS
+    batch->rx_stamp[i] = eb_posix_ip_stamp(&msg[i].msg_hdr);
+#else
+    batch->rx_stamp[i] = 0;
+#endif
+  }
+#else
+  int result;
+  
+  batch->rx_sa_len[0] = sizeof(struct sockaddr_storage);
+  result = eb_posix_ip_recv(sock, &batch->rx_buf[0][0], EB_POSIX_UDP_SLOT, MSG_DONTWAIT, &batch->rx_sa[0], &batch->rx_sa_len[0], &batch->rx_stamp[0]);
+  if (result == -1) return eb_posix_ip_ewouldblock() ? 0 : -1;
+  
+  batch->rx_len[0] = result;
+  result = 1;
+#endif
+  
+  batch->rx_next = 0;
+  batch->rx_count = result;
+  return result;
+}
+
+/* Push out all datagrams held back by send_buffer */
+static void eb_posix_udp_flush(struct eb_posix_udp_batch* batch) {
+#ifdef EB_POSIX_UDP_MMSG
+  struct mmsghdr msg[EB_POSIX_UDP_BATCH];
+  struct iovec iov[EB_POSIX_UDP_BATCH];
+  int done, result;
+#endif
+  int i;
+  
+  if (batch->tx_count == 0) return;
+  
+  eb_posix_ip_non_blocking(batch->tx_socket, 0);
+  
+#ifdef EB_POSIX_UDP_MMSG
+  memset(&msg[0], 0, sizeof(msg));
+  for (i = 0; i < batch->tx_count; ++i) {
+    iov[i].iov_base = &batch->tx_buf[i][0];
+    iov[i].iov_len = batch->tx_len[i];
+    msg[i].msg_hdr.msg_name = batch->tx_sa[i];
+    msg[i].msg_hdr.msg_namelen = batch->tx_sa_len[i];
+    msg[i].msg_hdr.msg_iov = &iov[i];
+    msg[i].msg_hdr.msg_iovlen = 1;
+  }
+  
+  /* A blocking sendmmsg may still stop short */
+  for (done = 0; done < batch->tx_count; done += result)
+    if ((result = sendmmsg(batch->tx_socket, &msg[done], batch->tx_count - done, 0)) <= 0)
+      break;
+#else
+  for (i = 0; i < batch->tx_count; ++i)
+    sendto(batch->tx_socket, (const char*)&batch->tx_buf[i][0], batch->tx_len[i], 0, (struct sockaddr*)batch->tx_sa[i], batch->tx_sa_len[i]);
+#endif
+  
+  batch->tx_count = 0;
+}
 
 int eb_posix_udp_poll(struct eb_transport* transportp, struct eb_link* linkp, eb_user_data_t data, eb_descriptor_callback_t ready, uint8_t* buf, int len) {
   struct eb_posix_udp_transport* transport;
-  int result;
+  struct eb_posix_udp_batch* batch;
+  int i, result;
   
   if (linkp != 0) return 0; /* Only recv top-level */
   
   transport = (struct eb_posix_udp_transport*)transportp;
+  batch = transport->batch;
   
-  /* Set non-blocking */
-  eb_posix_ip_non_blocking(transport->socket4, 1);
-  eb_posix_ip_non_blocking(transport->socket6, 1);
-  
-  if (transport->socket4 != -1 && (*ready)(data, transport->socket4, EB_DESCRIPTOR_IN)) {
-    eb_posix_udp_sa_len = sizeof(eb_posix_udp_sa);
-    result = recvfrom(transport->socket4, (char*)buf, len, MSG_DONTWAIT, (struct sockaddr*)&eb_posix_udp_sa, &eb_posix_udp_sa_len);
-    if (result == -1 && !eb_posix_ip_ewouldblock()) return -1;
-    if (result != -1) return result;
+  /* Refill the batch once all datagrams have been handed out */
+  if (batch->rx_next == batch->rx_count) {
+    /* Set non-blocking */
+    eb_posix_ip_non_blocking(transport->socket4, 1);
+    eb_posix_ip_non_blocking(transport->socket6, 1);
+    
+    result = 0;
+    if (result == 0 && transport->socket4 != -1 && (*ready)(data, transport->socket4, EB_DESCRIPTOR_IN))
+      if ((result = eb_posix_udp_fill(batch, transport->socket4)) == -1) return -1;
+    if (result == 0 && transport->socket6 != -1 && (*ready)(data, transport->socket6, EB_DESCRIPTOR_IN))
+      if ((result = eb_posix_udp_fill(batch, transport->socket6)) == -1) return -1;
+    if (result == 0) return 0;
   }
   
-  if (transport->socket6 != -1 && (*ready)(data, transport->socket6, EB_DESCRIPTOR_IN)) {
-    eb_posix_udp_sa_len = sizeof(eb_posix_udp_sa);
-    result = recvfrom(transport->socket6, (char*)buf, len, MSG_DONTWAIT, (struct sockaddr*)&eb_posix_udp_sa, &eb_posix_udp_sa_len);
-    if (result == -1 && !eb_posix_ip_ewouldblock()) return -1;
-    if (result != -1) return result;
-  }
+  i = batch->rx_next++;
   
-  return 0;
+  batch->peer_len = batch->rx_sa_len[i];
+  memcpy(&batch->peer, &batch->rx_sa[i], batch->peer_len);
+  batch->stamp = batch->rx_stamp[i];
+  
+  result = batch->rx_len[i];
+  if (result > len) result = len;
+  memcpy(buf, &batch->rx_buf[i][0], result);
+  
+  return result;
 }
 
 int eb_posix_udp_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8_t* buf, int len) {
@@ -168,12 +282,23 @@ int eb_posix_udp_recv(struct eb_transport* transportp, struct eb_link* linkp, ui
   return -1;
 }
 
+uint64_t eb_posix_udp_stamp(struct eb_transport* transportp, struct eb_link* linkp) {
+  struct eb_posix_udp_transport* transport;
+  
+  transport = (struct eb_posix_udp_transport*)transportp;
+  return transport->batch->stamp;
+}
+
 void eb_posix_udp_send(struct eb_transport* transportp, struct eb_link* linkp, const uint8_t* buf, int len) {
   struct eb_posix_udp_transport* transport;
+  struct eb_posix_udp_batch* batch;
   struct eb_posix_udp_link* link;
+  struct sockaddr_storage* sa;
+  socklen_t sa_len;
+  eb_posix_sock_t sock;
+  int i;
   
 #ifdef PACKET_DEBUG
-  int i;
   fprintf(stderr, "<---- ");
   for (i = 0; i < len; ++i) fprintf(stderr, "%02x", buf[i]);
   fprintf(stderr, "\n");
@@ -181,27 +306,48 @@ void eb_posix_udp_send(struct eb_transport* transportp, struct eb_link* linkp, c
 
   transport = (struct eb_posix_udp_transport*)transportp;
   link = (struct eb_posix_udp_link*)linkp;
-  
+  batch = transport->batch;
   
   if (link == 0) {
-    if (eb_posix_udp_sa.ss_family == PF_INET6) {
-      eb_posix_ip_non_blocking(transport->socket6, 0);
-      sendto(transport->socket6, (const char*)buf, len, 0, (struct sockaddr*)&eb_posix_udp_sa, eb_posix_udp_sa_len);
-    } else {
-      eb_posix_ip_non_blocking(transport->socket4, 0);
-      sendto(transport->socket4, (const char*)buf, len, 0, (struct sockaddr*)&eb_posix_udp_sa, eb_posix_udp_sa_len);
-    }
+    sa = &batch->peer;
+    sa_len = batch->peer_len;
+  } else {
+    sa = link->sa;
+    sa_len = link->sa_len;
+  }
+  
+  if (sa->ss_family == PF_INET6) {
+    sock = transport->socket6;
   } else {
-    if (link->sa->ss_family == PF_INET6) {
-      eb_posix_ip_non_blocking(transport->socket6, 0);
-      sendto(transport->socket6, (const char*)buf, len, 0, (struct sockaddr*)link->sa, link->sa_len);
-    } else {
-      eb_posix_ip_non_blocking(transport->socket4, 0);
-      sendto(transport->socket4, (const char*)buf, len, 0, (struct sockaddr*)link->sa, link->sa_len);
-    }
+    sock = transport->socket4;
+  }
+  
+  /* Replies to the peer are not held back; batch->peer changes with each poll */
+  if (batch->tx_on && link != 0 && len <= EB_POSIX_UDP_MTU) {
+    if (batch->tx_count == EB_POSIX_UDP_BATCH || 
+        (batch->tx_count > 0 && batch->tx_socket != sock))
+      eb_posix_udp_flush(batch);
+    
+    i = batch->tx_count++;
+    memcpy(&batch->tx_buf[i][0], buf, len);
+    batch->tx_len[i] = len;
+    batch->tx_sa[i] = sa;
+    batch->tx_sa_len[i] = sa_len;
+    batch->tx_socket = sock;
+  } else {
+    /* Preserve the order of datagrams */
+    eb_posix_udp_flush(batch);
+    
+    eb_posix_ip_non_blocking(sock, 0);
+    sendto(sock, (const char*)buf, len, 0, (struct sockaddr*)sa, sa_len);
   }
 }
 
 void eb_posix_udp_send_buffer(struct eb_transport* transportp, struct eb_link* linkp, int on) {
-  /* no-op */
+  struct eb_posix_udp_transport* transport;
+  
+  transport = (struct eb_posix_udp_transport*)transportp;
+  transport->batch->tx_on = on;
+  
+  if (!on) eb_posix_udp_flush(transport->batch);
 }
@@ -33,6 +33,8 @@
 #include "../transport/transport.h"
 
 #define EB_POSIX_UDP_MTU 1472
+#define EB_POSIX_UDP_BATCH 16  /* datagrams moved per system call */
+#define EB_POSIX_UDP_SLOT 4096 /* largest datagram received */
 
 EB_PRIVATE eb_status_t eb_posix_udp_open(struct eb_transport* transport, const char* port);
 EB_PRIVATE void eb_posix_udp_close(struct eb_transport* transport);
@@ -42,11 +44,36 @@ EB_PRIVATE void eb_posix_udp_fdes(struct eb_transport*, struct eb_link* link, eb
 EB_PRIVATE int eb_posix_udp_accept(struct eb_transport*, struct eb_link* result_link, eb_user_data_t data, eb_descriptor_callback_t ready);
 EB_PRIVATE int eb_posix_udp_poll(struct eb_transport* transportp, struct eb_link* linkp, eb_user_data_t data, eb_descriptor_callback_t ready, uint8_t* buf, int len);
 EB_PRIVATE int eb_posix_udp_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8_t* buf, int len);
+EB_PRIVATE uint64_t eb_posix_udp_stamp(struct eb_transport* transportp, struct eb_link* linkp);
 EB_PRIVATE void eb_posix_udp_send(struct eb_transport* transportp, struct eb_link* linkp, const uint8_t* buf, int len);
 EB_PRIVATE void eb_posix_udp_send_buffer(struct eb_transport* transportp, struct eb_link* linkp, int on);
 
+struct eb_posix_udp_batch {
+  /* Datagrams received, but not yet returned by poll */
+  int rx_next, rx_count;
+  int rx_len[EB_POSIX_UDP_BATCH];
+  socklen_t rx_sa_len[EB_POSIX_UDP_BATCH];
+  uint64_t rx_stamp[EB_POSIX_UDP_BATCH]; /* kernel receive times; 0 if unknown */
+  struct sockaddr_storage rx_sa[EB_POSIX_UDP_BATCH];
+  uint8_t rx_buf[EB_POSIX_UDP_BATCH][EB_POSIX_UDP_SLOT];
+  
+  /* Sender and receive time of the datagram last returned by poll; replies go to the sender */
+  struct sockaddr_storage peer;
+  socklen_t peer_len;
+  uint64_t stamp;
+  
+  /* Datagrams held between send_buffer(1) and send_buffer(0) */
+  int tx_on, tx_count;
+  eb_posix_sock_t tx_socket;
+  int tx_len[EB_POSIX_UDP_BATCH];
+  socklen_t tx_sa_len[EB_POSIX_UDP_BATCH];
+  struct sockaddr_storage* tx_sa[EB_POSIX_UDP_BATCH];
+  uint8_t tx_buf[EB_POSIX_UDP_BATCH][EB_POSIX_UDP_MTU];
+};
+
 struct eb_posix_udp_transport {
-  /* Contents must fit in 9 bytes */
+  /* Contents must fit in 21 bytes */
+  struct eb_posix_udp_batch* batch;
   eb_posix_sock_t socket4; /* IPv4 */
   eb_posix_sock_t socket6; /* IPv6 */
 };
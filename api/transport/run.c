@@ -6,6 +6,11 @@
  *  Implement eb_socket_block using select().
  *  This should work on any POSIX operating system.
  *
+ *  eb_socket_thread runs the same loop from a thread of its own (a reactor).
+ *  The library is then shared under one mutex, which the reactor drops only
+ *  while it sleeps in select(). Threads blocked on an eb_block cycle sleep
+ *  on a condition variable of their own, signalled by that cycle's callback.
+ *
  *  @author Wesley W. Terpstra <w.terpstra@gsi.de>
  *
  *  @bug None!
@@ -28,12 +33,24 @@
 
 #define ETHERBONE_IMPL
 
+#ifdef __linux__
+#define _GNU_SOURCE /* pthread_attr_setaffinity_np */
+#endif
+
 #include "posix-ip.h"
 #include "transport.h"
 #include "../glue/socket.h"
 #include "../glue/device.h"
+#include "../glue/queue.h"
 #include "../memory/memory.h"
 
+#include <stdlib.h>
+#include <time.h>
+
+#ifndef __WIN32
+#include <pthread.h>
+#endif
+
 struct eb_block_sets {
   int nfd;
   fd_set rfds;
@@ -59,13 +76,315 @@ static int eb_check_sets(eb_user_data_t data, eb_descriptor_t fd, uint8_t mode)
     (((mode & EB_DESCRIPTOR_OUT) != 0) && FD_ISSET(fd, &set->wfds));
 }
 
+uint32_t eb_socket_clock(void) {
+#if defined(__WIN32)
+  return GetTickCount() * 1000;
+#elif defined(CLOCK_MONOTONIC)
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec*1000000 + now.tv_nsec/1000;
+#else
+  struct timeval now;
+  gettimeofday(&now, 0);
+  return now.tv_sec*1000000 + now.tv_usec;
+#endif
+}
+
+uint64_t eb_socket_realtime(void) {
+#if defined(__WIN32)
+  return 0;
+#elif defined(CLOCK_REALTIME)
+  struct timespec now;
+  clock_gettime(CLOCK_REALTIME, &now);
+  return (uint64_t)now.tv_sec*1000000000 + now.tv_nsec;
+#else
+  struct timeval now;
+  gettimeofday(&now, 0);
+  return (uint64_t)now.tv_sec*1000000000 + (uint64_t)now.tv_usec*1000;
+#endif
+}
+
+/* Fill the sets and shorten the timeout to the next etherbone deadline */
+static void eb_socket_prepare(eb_socket_t socketp, long timeout_us, struct eb_block_sets* sets, struct timeval* timeout) {
+  long eb_timeout_us;
+  
+  eb_timeout_us = eb_socket_timeout_us(socketp);
+  
+  if (timeout_us == -1)
+    timeout_us = 600*1000000; /* 10 minutes */
+  
+  if (eb_timeout_us != -1 && timeout_us > eb_timeout_us)
+    timeout_us = eb_timeout_us;
+  
+  if (timeout_us < 0) timeout_us = 0;
+  
+  /* This use of division is ok, because it will never be done on an LM32 */
+  timeout->tv_sec  = timeout_us / 1000000;
+  timeout->tv_usec = timeout_us % 1000000;
+  
+  eb_socket_descriptors(socketp, sets, &eb_update_sets);
+}
+
+#ifndef __WIN32
+
+struct eb_reactor {
+  pthread_t thread;
+  eb_socket_t socket;
+  int stop;     /* 1 = asked to stop, 2 = stopped */
+  int detached; /* stopped by its own callback; frees itself */
+};
+
+static pthread_mutex_t eb_reactor_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  eb_reactor_pass = PTHREAD_COND_INITIALIZER; /* after every eb_socket_check */
+
+/* The reactor running the socket, unless it is the caller */
+static struct eb_reactor* eb_socket_reactor(eb_socket_t socketp) {
+  struct eb_socket* socket;
+  struct eb_socket_aux* aux;
+  struct eb_reactor* reactor;
+  
+  socket = EB_SOCKET(socketp);
+  aux = EB_SOCKET_AUX(socket->aux);
+  
+  if (aux->queue == 0 || (reactor = aux->queue->reactor) == 0)
+    return 0;
+  
+  return pthread_equal(pthread_self(), reactor->thread) ? 0 : reactor;
+}
+
+/* Kick the reactor out of select() */
+static void eb_reactor_wake(eb_socket_t socketp) {
+  struct eb_socket* socket;
+  struct eb_socket_aux* aux;
+  char byte;
+  
+  socket = EB_SOCKET(socketp);
+  aux = EB_SOCKET_AUX(socket->aux);
+  
+  byte = 0;
+  if (write(aux->queue->wake[1], &byte, 1) < 0) { /* full => awake anyway */ }
+}
+
+static void* eb_reactor_main(void* arg) {
+  struct eb_reactor* reactor = (struct eb_reactor*)arg;
+  struct eb_block_sets sets;
+  struct timeval timeout, start;
+  eb_socket_t socketp;
+  int done;
+  
+  socketp = reactor->socket;
+  
+  pthread_mutex_lock(&eb_reactor_lock);
+  while (!reactor->stop) {
+    FD_ZERO(&sets.rfds);
+    FD_ZERO(&sets.wfds);
+    sets.nfd = 0;
+    
+    gettimeofday(&start, 0);
+    
+    /* Send whatever was closed while we slept (see eb_socket_run) */
+    done = eb_socket_check(socketp, start.tv_sec, &sets, &eb_check_sets);
+    
+    if (done <= 0) {
+      eb_socket_prepare(socketp, -1, &sets, &timeout);
+      
+      pthread_mutex_unlock(&eb_reactor_lock);
+      select(sets.nfd+1, &sets.rfds, &sets.wfds, 0, &timeout);
+      pthread_mutex_lock(&eb_reactor_lock);
+      
+      if (reactor->stop) break;
+      
+      gettimeofday(&start, 0);
+      eb_socket_check(socketp, start.tv_sec, &sets, &eb_check_sets);
+    }
+    
+    pthread_cond_broadcast(&eb_reactor_pass);
+  }
+  
+  reactor->stop = 2;
+  pthread_cond_broadcast(&eb_reactor_pass);
+  pthread_mutex_unlock(&eb_reactor_lock);
+  
+  if (reactor->detached) free(reactor);
+  return 0;
+}
+
+eb_status_t eb_socket_thread(eb_socket_t socketp, int cpu) {
+  struct eb_reactor* reactor;
+  struct eb_queue* queue;
+  pthread_attr_t attr;
+  eb_status_t status;
+  int err;
+#ifdef __linux__
+  cpu_set_t cpus;
+#endif
+  
+  /* The reactor sleeps on the submission pipe, too */
+  if ((status = eb_socket_queue(socketp, &queue)) != EB_OK)
+    return status;
+  
+  if (queue->reactor != 0)
+    return EB_OK;
+  
+  if ((reactor = (struct eb_reactor*)malloc(sizeof(struct eb_reactor))) == 0)
+    return EB_OOM;
+  
+  reactor->socket = socketp;
+  reactor->stop = 0;
+  reactor->detached = 0;
+  
+  pthread_attr_init(&attr);
+#ifdef __linux__
+  if (cpu >= 0) {
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    pthread_attr_setaffinity_np(&attr, sizeof(cpus), &cpus);
+  }
+#endif
+  
+  /* Hold the reactor back until reactor->thread is valid */
+  pthread_mutex_lock(&eb_reactor_lock);
+  err = pthread_create(&reactor->thread, &attr, &eb_reactor_main, reactor);
+  if (err == 0) queue->reactor = reactor;
+  pthread_mutex_unlock(&eb_reactor_lock);
+  
+  pthread_attr_destroy(&attr);
+  
+  if (err != 0) {
+    free(reactor);
+    return EB_FAIL;
+  }
+  
+  return EB_OK;
+}
+
+void eb_socket_join(struct eb_queue* queue) {
+  struct eb_reactor* reactor;
+  
+  if ((reactor = queue->reactor) == 0) return;
+  queue->reactor = 0;
+  
+  reactor->stop = 1;
+  
+  if (pthread_equal(pthread_self(), reactor->thread)) {
+    reactor->detached = 1;
+    pthread_detach(reactor->thread);
+  } else {
+    char byte = 0;
+    if (write(queue->wake[1], &byte, 1) < 0) { /* full => awake anyway */ }
+    
+    while (reactor->stop != 2)
+      pthread_cond_wait(&eb_reactor_pass, &eb_reactor_lock);
+    
+    pthread_join(reactor->thread, 0);
+    free(reactor);
+  }
+}
+
+void eb_socket_lock(eb_socket_t socketp) {
+  pthread_mutex_lock(&eb_reactor_lock);
+}
+
+void eb_socket_unlock(eb_socket_t socketp) {
+  struct eb_socket* socket;
+  struct eb_device* device;
+  eb_device_t devicep;
+  
+  if (eb_socket_reactor(socketp) != 0) {
+    /* Only wake the reactor if there are cycles to send */
+    socket = EB_SOCKET(socketp);
+    for (devicep = socket->first_device; devicep != EB_NULL; devicep = device->next) {
+      device = EB_DEVICE(devicep);
+      if (device->un_link.passive != devicep &&
+          (device->un_link.ready != EB_NULL || device->urgent != EB_NULL)) {
+        eb_reactor_wake(socketp);
+        break;
+      }
+    }
+  }
+  
+  pthread_mutex_unlock(&eb_reactor_lock);
+}
+
+void eb_socket_block(eb_socket_t socketp, int* busy, void** cond) {
+  pthread_cond_t wake;
+  
+  if (eb_socket_reactor(socketp) == 0) {
+    while (__atomic_load_n(busy, __ATOMIC_ACQUIRE) > 0) eb_socket_run(socketp, -1);
+    return;
+  }
+  
+  pthread_cond_init(&wake, 0);
+  *cond = &wake;
+  
+  eb_reactor_wake(socketp);
+  while (__atomic_load_n(busy, __ATOMIC_ACQUIRE) > 0)
+    pthread_cond_wait(&wake, &eb_reactor_lock);
+  
+  *cond = 0;
+  pthread_cond_destroy(&wake);
+}
+
+void eb_socket_unblock(void* cond) {
+  if (cond != 0)
+    pthread_cond_signal((pthread_cond_t*)cond);
+}
+
+/* Another thread runs the socket: sleep until it has checked the socket */
+static long eb_reactor_run(eb_socket_t socketp, long timeout_us) {
+  struct timeval start, stop;
+  struct timespec deadline;
+  
+  gettimeofday(&start, 0);
+  eb_reactor_wake(socketp);
+  
+  if (timeout_us == -1) {
+    pthread_cond_wait(&eb_reactor_pass, &eb_reactor_lock);
+  } else if (timeout_us > 0) {
+    timeout_us += start.tv_usec;
+    deadline.tv_sec  = start.tv_sec + timeout_us / 1000000;
+    deadline.tv_nsec = (timeout_us % 1000000) * 1000;
+    pthread_cond_timedwait(&eb_reactor_pass, &eb_reactor_lock, &deadline);
+  }
+  
+  gettimeofday(&stop, 0);
+  return (stop.tv_sec - start.tv_sec)*1000000 + (stop.tv_usec - start.tv_usec);
+}
+
+#else
+
+eb_status_t eb_socket_thread(eb_socket_t socketp, int cpu) {
+  return EB_FAIL;
+}
+
+void eb_socket_join(struct eb_queue* queue) {
+}
+
+void eb_socket_lock(eb_socket_t socketp) {
+}
+
+void eb_socket_unlock(eb_socket_t socketp) {
+}
+
+void eb_socket_block(eb_socket_t socketp, int* busy, void** cond) {
+  while (*busy > 0) eb_socket_run(socketp, -1);
+}
+
+void eb_socket_unblock(void* cond) {
+}
+
+#endif
+
 long eb_socket_run(eb_socket_t socketp, long timeout_us) {
   struct eb_block_sets sets;
   struct timeval timeout, start, stop;
-  long eb_deadline;
-  long eb_timeout_us;
   int done;
   
+#ifndef __WIN32
+  if (eb_socket_reactor(socketp) != 0)
+    return eb_reactor_run(socketp, timeout_us);
+#endif
+  
   /* Find all descriptors */
   FD_ZERO(&sets.rfds);
   FD_ZERO(&sets.wfds);
@@ -79,24 +398,7 @@ long eb_socket_run(eb_socket_t socketp, long timeout_us) {
   if (done > 0) return 0;
   /* !!! hack ends */
   
-  eb_deadline = eb_socket_timeout(socketp);
-  
-  if (timeout_us == -1)
-    timeout_us = 600*1000000; /* 10 minutes */
-  
-  if (eb_deadline != 0) {
-    eb_timeout_us = (eb_deadline - start.tv_sec)*1000000;
-    if (timeout_us > eb_timeout_us)
-      timeout_us = eb_timeout_us;
-  }
-  
-  if (timeout_us < 0) timeout_us = 0;
-  
-  /* This use of division is ok, because it will never be done on an LM32 */
-  timeout.tv_sec  = timeout_us / 1000000;
-  timeout.tv_usec = timeout_us % 1000000;
-  
-  eb_socket_descriptors(socketp, &sets, &eb_update_sets);
+  eb_socket_prepare(socketp, timeout_us, &sets, &timeout);
   
   select(sets.nfd+1, &sets.rfds, &sets.wfds, 0, &timeout);
   gettimeofday(&stop, 0);
@@ -0,0 +1,657 @@
+/** @file shm.c
+ *  @brief This implements a shared-memory binding for peers on the same host.
+ *
+ *  Copyright (C) 2026 GSI Helmholtz Centre for Heavy Ion Research GmbH 
+ *
+ *  The transport carries a port for accepting inbound connections.
+ *  Passive devices are created for inbound connections.
+ *
+ *  Each link is a pair of single-producer single-consumer byte rings in
+ *  a memfd segment. The segment and an eventfd doorbell per direction are
+ *  handed over a unix socket, which stays open to detect a departed peer.
+ *
+ *  @author Etherbone Core Developers <etherbone-core@ohwr.org>
+ *
+ *  @bug None!
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define ETHERBONE_IMPL
+
+#ifdef __linux__
+
+#define _GNU_SOURCE /* memfd_create + accept4 */
+
+#include "shm.h"
+#include "transport.h"
+#include "../glue/strncasecmp.h"
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/eventfd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define EB_SHM_PREFIX "etherbone/shm/"
+
+/* Abstract socket names vanish with the process; no stale files */
+static socklen_t eb_shm_name(struct sockaddr_un* sa, const char* name) {
+  int len;
+  
+  len = strlen(name);
+  if (len == 0 || len + sizeof(EB_SHM_PREFIX) > sizeof(sa->sun_path)) return 0;
+  
+  memset(sa, 0, sizeof(*sa));
+  sa->sun_family = AF_UNIX;
+  memcpy(&sa->sun_path[1], EB_SHM_PREFIX, sizeof(EB_SHM_PREFIX)-1);
+  memcpy(&sa->sun_path[sizeof(EB_SHM_PREFIX)], name, len);
+  
+  return offsetof(struct sockaddr_un, sun_path) + sizeof(EB_SHM_PREFIX) + len;
+}
+
+static void eb_shm_ring_bell(int fdes) {
+  uint64_t one = 1;
+  /* Wrap this in an if(); to silence warning about ignored result */
+  if (write(fdes, &one, sizeof(one)));
+}
+
+static void eb_shm_drain_bell(int fdes) {
+  uint64_t count;
+  /* Non-blocking: fails harmlessly if nobody rang */
+  if (read(fdes, &count, sizeof(count)));
+}
+
+/* Copy out up to len bytes. Only the reader modifies head. */
+static int eb_shm_ring_read(struct eb_shm_ring* ring, uint8_t* buf, int len) {
+  uint32_t head, tail, offset, chunk;
+  
+  head = ring->head;
+  tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+  
+  if (tail - head < (uint32_t)len) len = tail - head;
+  if (len == 0) return 0;
+  
+  offset = head & (EB_SHM_RING_SIZE-1);
+  chunk = EB_SHM_RING_SIZE - offset;
+  if (chunk > (uint32_t)len) chunk = len;
+  
+  memcpy(buf, &ring->data[offset], chunk);
+  memcpy(buf+chunk, &ring->data[0], len-chunk);
+  
+  /* Ordered against the load of waiting in eb_shm_take */
+  __atomic_store_n(&ring->head, head + len, __ATOMIC_SEQ_CST);
+  return len;
+}
+
+/* Copy in up to len bytes. Only the writer modifies tail. */
+static int eb_shm_ring_write(struct eb_shm_ring* ring, const uint8_t* buf, int len) {
+  uint32_t head, tail, offset, chunk, space;
+  
+  tail = ring->tail;
+  head = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+  
+  space = EB_SHM_RING_SIZE - (tail - head);
+  if (space < (uint32_t)len) len = space;
+  if (len == 0) return 0;
+  
+  offset = tail & (EB_SHM_RING_SIZE-1);
+  chunk = EB_SHM_RING_SIZE - offset;
+  if (chunk > (uint32_t)len) chunk = len;
+  
+  memcpy(&ring->data[offset], buf, chunk);
+  memcpy(&ring->data[0], buf+chunk, len-chunk);
+  
+  __atomic_store_n(&ring->tail, tail + len, __ATOMIC_RELEASE);
+  return len;
+}
+
+/* Read from the link, waking the peer if it waits for space */
+static int eb_shm_take(struct eb_shm_state* state, uint8_t* buf, int len) {
+  int result;
+  
+  result = eb_shm_ring_read(state->rx, buf, len);
+  if (result > 0 && __atomic_load_n(&state->rx->waiting, __ATOMIC_SEQ_CST)) {
+    __atomic_store_n(&state->rx->waiting, 0, __ATOMIC_RELAXED);
+    eb_shm_ring_bell(state->peer_bell);
+  }
+  
+  return result;
+}
+
+/* Has the peer closed its end? */
+static int eb_shm_hungup(struct eb_shm_state* state) {
+  char junk;
+  return recv(state->control, &junk, 1, MSG_DONTWAIT) == 0;
+}
+
+/* Ring the peer now, or once the flush is over */
+static void eb_shm_notify(struct eb_shm_state* state) {
+  if (state->buffering) {
+    state->unsent = 1;
+  } else {
+    eb_shm_ring_bell(state->peer_bell);
+    state->unsent = 0;
+  }
+}
+
+/* Move as much of the backlog into the ring as fits */
+static void eb_shm_push(struct eb_shm_state* state) {
+  int result;
+  
+  if (state->backlog_len == 0) return;
+  
+  result = eb_shm_ring_write(state->tx, state->backlog, state->backlog_len);
+  if (result != state->backlog_len) {
+    /* Ring is full; have the reader ring us once it frees space */
+    __atomic_store_n(&state->tx->waiting, 1, __ATOMIC_SEQ_CST);
+    result += eb_shm_ring_write(state->tx, state->backlog+result, state->backlog_len-result);
+  }
+  
+  if (result == 0) return;
+  
+  state->backlog_len -= result;
+  memmove(state->backlog, state->backlog+result, state->backlog_len);
+  eb_shm_notify(state);
+}
+
+/* Queue len bytes behind the backlog. -1 if out of memory. */
+static int eb_shm_append(struct eb_shm_state* state, const uint8_t* buf, int len) {
+  uint8_t* backlog;
+  int size;
+  
+  if (state->backlog_len + len > state->backlog_size) {
+    size = state->backlog_size ? state->backlog_size : EB_SHM_RING_SIZE;
+    while (size < state->backlog_len + len) size *= 2;
+    
+    if ((backlog = (uint8_t*)realloc(state->backlog, size)) == 0) return -1;
+    state->backlog = backlog;
+    state->backlog_size = size;
+  }
+  
+  memcpy(state->backlog + state->backlog_len, buf, len);
+  state->backlog_len += len;
+  return 0;
+}
+
+/* Block until the peer rings or leaves. -1 if it left. */
+static int eb_shm_wait(struct eb_shm_transport* transport, struct eb_shm_state* state) {
+  struct eb_shm_state* link;
+  struct pollfd pfd[2];
+  
+  /* The peer may be another link of this socket, whose backlog only we can move */
+  for (link = transport->links; link != 0; link = link->next)
+    eb_shm_push(link);
+  
+  if (state->rx->tail != state->rx->head) return 0;
+  
+  pfd[0].fd = state->bell;
+  pfd[0].events = POLLIN;
+  pfd[1].fd = state->control;
+  pfd[1].events = POLLIN;
+  
+  if (poll(&pfd[0], 2, -1) == -1) return errno == EINTR ? 0 : -1;
+  if (pfd[1].revents != 0 && eb_shm_hungup(state)) return -1;
+  if (pfd[0].revents != 0) eb_shm_drain_bell(state->bell);
+  
+  /* The ring we swallowed may have been for free space */
+  eb_shm_push(state);
+  return 0;
+}
+
+static int eb_shm_send_fds(int sock, int* fds, int nfds) {
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(3*sizeof(int))];
+  } control;
+  struct msghdr msg;
+  struct cmsghdr* cmsg;
+  struct iovec iov;
+  char byte;
+  
+  byte = 0;
+  iov.iov_base = &byte;
+  iov.iov_len = 1;
+  
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = CMSG_SPACE(nfds*sizeof(int));
+  
+  cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(nfds*sizeof(int));
+  memcpy(CMSG_DATA(cmsg), fds, nfds*sizeof(int));
+  
+  return sendmsg(sock, &msg, MSG_NOSIGNAL) == 1 ? 0 : -1;
+}
+
+/* 0 on success, 1 if nothing arrived yet, -1 on error */
+static int eb_shm_recv_fds(int sock, int* fds, int nfds) {
+  union {
+    struct cmsghdr align;
+    char buf[CMSG_SPACE(3*sizeof(int))];
+  } control;
+  struct msghdr msg;
+  struct cmsghdr* cmsg;
+  struct iovec iov;
+  ssize_t result;
+  char byte;
+  
+  iov.iov_base = &byte;
+  iov.iov_len = 1;
+  
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = control.buf;
+  msg.msg_controllen = CMSG_SPACE(nfds*sizeof(int));
+  
+  if ((result = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC | MSG_DONTWAIT)) != 1)
+    return (result == -1 && (errno == EAGAIN || errno == EWOULDBLOCK)) ? 1 : -1;
+  
+  cmsg = CMSG_FIRSTHDR(&msg);
+  if (cmsg == 0 || 
+      cmsg->cmsg_level != SOL_SOCKET || 
+      cmsg->cmsg_type != SCM_RIGHTS ||
+      cmsg->cmsg_len != CMSG_LEN(nfds*sizeof(int)))
+    return -1;
+  
+  memcpy(fds, CMSG_DATA(cmsg), nfds*sizeof(int));
+  return 0;
+}
+
+static struct eb_shm_segment* eb_shm_map(int memfd) {
+  struct stat st;
+  void* segment;
+  int seals;
+  
+  /* The memfd comes from the peer; touching past its end raises SIGBUS */
+  if (fstat(memfd, &st) != 0 || st.st_size < (off_t)sizeof(struct eb_shm_segment))
+    return 0;
+  
+  /* ... so it must also be sealed against shrinking later */
+  if ((seals = fcntl(memfd, F_GET_SEALS)) == -1 || (seals & F_SEAL_SHRINK) == 0)
+    return 0;
+  
+  segment = mmap(0, sizeof(struct eb_shm_segment), PROT_READ|PROT_WRITE, MAP_SHARED, memfd, 0);
+  if (segment == MAP_FAILED) return 0;
+  
+  return (struct eb_shm_segment*)segment;
+}
+
+eb_status_t eb_shm_open(struct eb_transport* transportp, const char* port) {
+  struct eb_shm_transport* transport;
+  struct sockaddr_un sa;
+  socklen_t len;
+  int sock;
+  
+  transport = (struct eb_shm_transport*)transportp;
+  transport->listen = -1;
+  transport->links = 0;
+  
+  /* No port? no listener */
+  if (!port) return EB_OK;
+  
+  if ((len = eb_shm_name(&sa, port)) == 0) return EB_OK;
+  
+  sock = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (sock == -1) return EB_ADDRESS;
+  
+  if (bind(sock, (struct sockaddr*)&sa, len) != 0) {
+    close(sock);
+    return EB_BUSY;
+  }
+  
+  if (listen(sock, 5) != 0) {
+    close(sock);
+    return EB_ADDRESS;
+  }
+  
+  transport->listen = sock;
+  return EB_OK;
+}
+
+/* Forget a link which never completed its handshake */
+static void eb_shm_drop(struct eb_shm_state** statep) {
+  struct eb_shm_state* state;
+  
+  state = *statep;
+  *statep = state->next;
+  
+  close(state->control);
+  free(state);
+}
+
+void eb_shm_close(struct eb_transport* transportp) {
+  struct eb_shm_transport* transport;
+  
+  transport = (struct eb_shm_transport*)transportp;
+  if (transport->listen != -1) close(transport->listen);
+  
+  /* Connected links were disconnected already */
+  while (transport->links != 0)
+    eb_shm_drop(&transport->links);
+}
+
+/* Settings common to both ends of a fresh link */
+static void eb_shm_setup(struct eb_shm_state* state) {
+  state->buffering = 0;
+  state->unsent = 0;
+  state->backlog = 0;
+  state->backlog_len = 0;
+  state->backlog_size = 0;
+}
+
+eb_status_t eb_shm_connect(struct eb_transport* transportp, struct eb_link* linkp, const char* address, int passive) {
+  struct eb_shm_transport* transport;
+  struct eb_shm_link* link;
+  struct eb_shm_state* state;
+  struct sockaddr_un sa;
+  socklen_t len;
+  int fds[3];
+  
+  transport = (struct eb_shm_transport*)transportp;
+  link = (struct eb_shm_link*)linkp;
+  
+  if (eb_strncasecmp(address, "shm/", 4))
+    return EB_ADDRESS;
+  
+  if ((len = eb_shm_name(&sa, address+4)) == 0)
+    return EB_ADDRESS;
+  
+  if ((state = (struct eb_shm_state*)malloc(sizeof(struct eb_shm_state))) == 0)
+    return EB_OOM;
+  
+  if ((state->control = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) == -1) goto fail_state;
+  if (connect(state->control, (struct sockaddr*)&sa, len) != 0) goto fail_control;
+  
+  /* Zero-filled by the kernel, so both rings start out empty */
+  if ((fds[0] = memfd_create("etherbone-shm", MFD_CLOEXEC | MFD_ALLOW_SEALING)) == -1) goto fail_control;
+  if (ftruncate(fds[0], sizeof(struct eb_shm_segment)) != 0) goto fail_memfd;
+  if (fcntl(fds[0], F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_SEAL) != 0) goto fail_memfd;
+  if ((state->segment = eb_shm_map(fds[0])) == 0) goto fail_memfd;
+  
+  if ((fds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) goto fail_map;
+  if ((fds[2] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) goto fail_bell;
+  
+  if (eb_shm_send_fds(state->control, &fds[0], 3) != 0) goto fail_peer_bell;
+  close(fds[0]);
+  
+  state->bell = fds[1];
+  state->peer_bell = fds[2];
+  state->tx = &state->segment->ring[0];
+  state->rx = &state->segment->ring[1];
+  eb_shm_setup(state);
+  
+  state->next = transport->links;
+  transport->links = state;
+  
+  link->state = state;
+  return EB_OK;
+
+fail_peer_bell:
+  close(fds[2]);
+fail_bell:
+  close(fds[1]);
+fail_map:
+  munmap(state->segment, sizeof(struct eb_shm_segment));
+fail_memfd:
+  close(fds[0]);
+fail_control:
+  close(state->control);
+fail_state:
+  free(state);
+  return EB_FAIL;
+}
+
+void eb_shm_disconnect(struct eb_transport* transportp, struct eb_link* linkp) {
+  struct eb_shm_transport* transport;
+  struct eb_shm_link* link;
+  struct eb_shm_state* state;
+  struct eb_shm_state** prev;
+  
+  transport = (struct eb_shm_transport*)transportp;
+  link = (struct eb_shm_link*)linkp;
+  state = link->state;
+  
+  for (prev = &transport->links; *prev != state; prev = &(*prev)->next) { }
+  *prev = state->next;
+  
+  munmap(state->segment, sizeof(struct eb_shm_segment));
+  close(state->control);
+  close(state->bell);
+  close(state->peer_bell);
+  free(state->backlog);
+  free(state);
+}
+
+void eb_shm_fdes(struct eb_transport* transportp, struct eb_link* linkp, eb_user_data_t data, eb_descriptor_callback_t cb) {
+  struct eb_shm_transport* transport;
+  struct eb_shm_link* link;
+  struct eb_shm_state* state;
+  
+  if (linkp) {
+    link = (struct eb_shm_link*)linkp;
+    (*cb)(data, link->state->bell, EB_DESCRIPTOR_IN);
+    (*cb)(data, link->state->control, EB_DESCRIPTOR_IN);
+  } else {
+    transport = (struct eb_shm_transport*)transportp;
+    if (transport->listen != -1) (*cb)(data, transport->listen, EB_DESCRIPTOR_IN);
+    
+    /* Accepted links still waiting for their descriptors */
+    for (state = transport->links; state != 0; state = state->next)
+      if (state->segment == 0) (*cb)(data, state->control, EB_DESCRIPTOR_IN);
+  }
+}
+
+/* Take the descriptors the client sends after connecting.
+ * 1 once the link is ready, 0 if they have not arrived, -1 on failure.
+ */
+static int eb_shm_handshake(struct eb_shm_state* state) {
+  int result, fds[3];
+  
+  if ((result = eb_shm_recv_fds(state->control, &fds[0], 3)) != 0)
+    return (result == 1) ? 0 : -1;
+  
+  state->segment = eb_shm_map(fds[0]);
+  close(fds[0]);
+  if (state->segment == 0) {
+    close(fds[1]);
+    close(fds[2]);
+    return -1;
+  }
+  
+  state->bell = fds[2];
+  state->peer_bell = fds[1];
+  state->tx = &state->segment->ring[1];
+  state->rx = &state->segment->ring[0];
+  return 1;
+}
+
+int eb_shm_accept(struct eb_transport* transportp, struct eb_link* result_linkp, eb_user_data_t data, eb_descriptor_callback_t ready) {
+  struct eb_shm_transport* transport;
+  struct eb_shm_link* result_link;
+  struct eb_shm_state* state;
+  struct eb_shm_state** prev;
+  int sock, result, pending;
+  time_t now;
+  
+  transport = (struct eb_shm_transport*)transportp;
+  
+  if (transport->listen == -1) return 0;
+  
+  /* Take in new connections; their handshakes complete below, without blocking */
+  now = time(0);
+  if ((*ready)(data, transport->listen, EB_DESCRIPTOR_IN)) {
+    pending = 0;
+    for (state = transport->links; state != 0; state = state->next)
+      if (state->segment == 0) ++pending;
+    
+    while ((sock = accept4(transport->listen, 0, 0, SOCK_NONBLOCK | SOCK_CLOEXEC)) != -1) {
+      /* Refuse connections beyond what may be mid-handshake at once */
+      if (pending == EB_SHM_PENDING ||
+          (state = (struct eb_shm_state*)malloc(sizeof(struct eb_shm_state))) == 0) {
+        close(sock);
+        continue;
+      }
+      ++pending;
+      
+      state->control = sock;
+      state->segment = 0;
+      state->accepted = now;
+      eb_shm_setup(state);
+      state->next = transport->links;
+      transport->links = state;
+    }
+  }
+  
+  prev = &transport->links;
+  while ((state = *prev) != 0) {
+    if (state->segment != 0) {
+      prev = &state->next;
+      continue;
+    }
+    
+    /* The client sends its descriptors right after connecting; drop a stray one */
+    result = eb_shm_handshake(state);
+    if (result == 0 && now - state->accepted > 1) result = -1;
+    
+    if (result == 0) {
+      prev = &state->next;
+      continue;
+    }
+    
+    if (result == 1 && result_linkp != 0) {
+      result_link = (struct eb_shm_link*)result_linkp;
+      result_link->state = state;
+      return 1;
+    }
+    
+    if (result == 1) {
+      munmap(state->segment, sizeof(struct eb_shm_segment));
+      close(state->bell);
+      close(state->peer_bell);
+    }
+    eb_shm_drop(prev);
+  }
+  
+  return 0;
+}
+
+int eb_shm_poll(struct eb_transport* transportp, struct eb_link* linkp, eb_user_data_t data, eb_descriptor_callback_t ready, uint8_t* buf, int len) {
+  struct eb_shm_link* link;
+  struct eb_shm_state* state;
+  int result;
+  
+  if (linkp == 0) return 0;
+  
+  link = (struct eb_shm_link*)linkp;
+  state = link->state;
+  
+  /* Quiet the bell before looking, so a later ring is never lost */
+  if ((*ready)(data, state->bell, EB_DESCRIPTOR_IN))
+    eb_shm_drain_bell(state->bell);
+  
+  /* The bell also rings when the peer frees space for our backlog */
+  eb_shm_push(state);
+  
+  if ((result = eb_shm_take(state, buf, len)) != 0)
+    return result;
+  
+  /* Only report a departed peer once its data is consumed */
+  if ((*ready)(data, state->control, EB_DESCRIPTOR_IN) && eb_shm_hungup(state))
+    return -1;
+  
+  return 0;
+}
+
+int eb_shm_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8_t* buf, int len) {
+  struct eb_shm_transport* transport;
+  struct eb_shm_link* link;
+  struct eb_shm_state* state;
+  int result;
+  
+  if (linkp == 0) return 0;
+  
+  transport = (struct eb_shm_transport*)transportp;
+  link = (struct eb_shm_link*)linkp;
+  state = link->state;
+  
+  while ((result = eb_shm_take(state, buf, len)) == 0) {
+    if (eb_shm_hungup(state)) return -1;
+    if (eb_shm_wait(transport, state) != 0) return -1;
+  }
+  
+  return result;
+}
+
+uint64_t eb_shm_stamp(struct eb_transport* transportp, struct eb_link* linkp) {
+  /* Shared memory carries no receive time */
+  return 0;
+}
+
+void eb_shm_send(struct eb_transport* transportp, struct eb_link* linkp, const uint8_t* buf, int len) {
+  struct eb_shm_link* link;
+  struct eb_shm_state* state;
+  int result;
+  
+  /* linkp == 0 impossible if poll == 0 returns 0 */
+  
+  link = (struct eb_shm_link*)linkp;
+  state = link->state;
+  
+  /* Never wait for the reader: it may be this very thread */
+  if (state->backlog_len == 0) {
+    result = eb_shm_ring_write(state->tx, buf, len);
+    buf += result;
+    len -= result;
+  }
+  
+  if (len != 0) {
+    /* Out of memory: the data is lost, like on a reset TCP link */
+    if (eb_shm_append(state, buf, len) != 0) return;
+    eb_shm_push(state);
+  }
+  
+  eb_shm_notify(state);
+}
+
+void eb_shm_send_buffer(struct eb_transport* transportp, struct eb_link* linkp, int on) {
+  struct eb_shm_link* link;
+  struct eb_shm_state* state;
+  
+  link = (struct eb_shm_link*)linkp;
+  state = link->state;
+  
+  state->buffering = on;
+  if (!on && state->unsent) {
+    eb_shm_ring_bell(state->peer_bell);
+    state->unsent = 0;
+  }
+}
+
+#endif
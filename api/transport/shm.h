@@ -0,0 +1,98 @@
+/** @file shm.h
+ *  @brief This implements a shared-memory binding for peers on the same host.
+ *
+ *  Copyright (C) 2026 GSI Helmholtz Centre for Heavy Ion Research GmbH 
+ *
+ *  The transport carries a port for accepting inbound connections.
+ *  Passive devices are created for inbound connections.
+ *
+ *  Each link is a pair of single-producer single-consumer byte rings in
+ *  a memfd segment. The segment and an eventfd doorbell per direction are
+ *  handed over a unix socket, which stays open to detect a departed peer.
+ *
+ *  @author Etherbone Core Developers <etherbone-core@ohwr.org>
+ *
+ *  @bug None!
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#ifndef EB_SHM_H
+#define EB_SHM_H
+
+#include "../transport/transport.h"
+
+#include <time.h>
+
+#define EB_SHM_MTU 0
+#define EB_SHM_RING_SIZE 65536 /* must be a power of two */
+#define EB_SHM_CACHE_LINE 64
+#define EB_SHM_PENDING 16 /* accepted links still waiting for their descriptors */
+
+EB_PRIVATE eb_status_t eb_shm_open(struct eb_transport* transport, const char* port);
+EB_PRIVATE void eb_shm_close(struct eb_transport* transport);
+EB_PRIVATE eb_status_t eb_shm_connect(struct eb_transport* transport, struct eb_link* link, const char* address, int passive);
+EB_PRIVATE void eb_shm_disconnect(struct eb_transport* transport, struct eb_link* link);
+EB_PRIVATE void eb_shm_fdes(struct eb_transport*, struct eb_link* link, eb_user_data_t data, eb_descriptor_callback_t cb);
+EB_PRIVATE int eb_shm_accept(struct eb_transport*, struct eb_link* result_link, eb_user_data_t data, eb_descriptor_callback_t ready);
+EB_PRIVATE int eb_shm_poll(struct eb_transport* transportp, struct eb_link* linkp, eb_user_data_t data, eb_descriptor_callback_t ready, uint8_t* buf, int len);
+EB_PRIVATE int eb_shm_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8_t* buf, int len);
+EB_PRIVATE uint64_t eb_shm_stamp(struct eb_transport* transportp, struct eb_link* linkp);
+EB_PRIVATE void eb_shm_send(struct eb_transport* transportp, struct eb_link* linkp, const uint8_t* buf, int len);
+EB_PRIVATE void eb_shm_send_buffer(struct eb_transport* transportp, struct eb_link* linkp, int on);
+
+/* Lives in shared memory. Counters run freely; fill = tail - head. */
+struct eb_shm_ring {
+  uint32_t head;    /* written by the reader */
+  uint8_t pad0[EB_SHM_CACHE_LINE-4];
+  uint32_t tail;    /* written by the writer */
+  uint32_t waiting; /* writer sleeps until the reader frees space */
+  uint8_t pad1[EB_SHM_CACHE_LINE-8];
+  uint8_t data[EB_SHM_RING_SIZE];
+};
+
+struct eb_shm_segment {
+  struct eb_shm_ring ring[2]; /* [0] is written by the connecting side */
+};
+
+struct eb_shm_state {
+  int control;   /* unix socket; hangs up when the peer leaves */
+  int bell;      /* eventfd the peer rings */
+  int peer_bell; /* eventfd we ring */
+  int buffering; /* inside send_buffer(1) */
+  int unsent;    /* written, but the peer has not been rung */
+  struct eb_shm_segment* segment; /* 0 until the handshake of an accepted link completes */
+  struct eb_shm_ring* rx;
+  struct eb_shm_ring* tx;
+  uint8_t* backlog; /* sent while the ring was full; moved over as the peer reads */
+  int backlog_len;
+  int backlog_size;
+  time_t accepted; /* when the handshake began; only while segment == 0 */
+  struct eb_shm_state* next; /* all links of the transport */
+};
+
+struct eb_shm_transport {
+  /* Contents must fit in 21 bytes */
+  int listen;
+  struct eb_shm_state* links;
+};
+
+struct eb_shm_link {
+  /* Contents must fit in 12 bytes */
+  struct eb_shm_state* state;
+};
+
+#endif
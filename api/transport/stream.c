@@ -0,0 +1,58 @@
+/** @file stream.c
+ *  @brief Receive buffering shared by the streaming transports.
+ *
+ *  Copyright (C) 2026 GSI Helmholtz Centre for Heavy Ion Research GmbH 
+ *
+ *  Streaming links fill this buffer with one large read and then hand
+ *  out the bytes to eb_device_slave, which may ask for a record at a time.
+ *
+ *  @author Etherbone Core Developers <etherbone-core@ohwr.org>
+ *
+ *  @bug None!
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#define ETHERBONE_IMPL
+
+#include <string.h>
+
+#include "stream.h"
+
+void eb_stream_rx_reset(struct eb_stream_rx* rx) {
+  rx->head = 0;
+  rx->tail = 0;
+}
+
+int eb_stream_rx_take(struct eb_stream_rx* rx, uint8_t* buf, int len) {
+  int avail;
+  
+  avail = rx->tail - rx->head;
+  if (avail > len) avail = len;
+  
+  memcpy(buf, &rx->buf[rx->head], avail);
+  rx->head += avail;
+  
+  /* Once drained, the next read can use the whole buffer */
+  if (rx->head == rx->tail) eb_stream_rx_reset(rx);
+  
+  return avail;
+}
+
+void eb_stream_rx_fill(struct eb_stream_rx* rx, int len) {
+  /* assert (rx->head == 0 && rx->tail == 0); */
+  rx->tail = len;
+}
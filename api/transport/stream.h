@@ -0,0 +1,52 @@
+/** @file stream.h
+ *  @brief Receive buffering shared by the streaming transports.
+ *
+ *  Copyright (C) 2026 GSI Helmholtz Centre for Heavy Ion Research GmbH 
+ *
+ *  Streaming links fill this buffer with one large read and then hand
+ *  out the bytes to eb_device_slave, which may ask for a record at a time.
+ *
+ *  @author Etherbone Core Developers <etherbone-core@ohwr.org>
+ *
+ *  @bug None!
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+#ifndef EB_STREAM_H
+#define EB_STREAM_H
+
+#include "../etherbone.h"
+
+#define EB_STREAM_RX_SIZE 65536
+
+struct eb_stream_rx {
+  int head; /* next byte to hand out */
+  int tail; /* end of valid data */
+  uint64_t stamp; /* kernel receive time of the last read; 0 if unknown */
+  uint8_t buf[EB_STREAM_RX_SIZE];
+};
+
+/* Empty the buffer */
+EB_PRIVATE void eb_stream_rx_reset(struct eb_stream_rx* rx);
+
+/* Copy up to len buffered bytes into buf. Returns 0 if the buffer is empty. */
+EB_PRIVATE int eb_stream_rx_take(struct eb_stream_rx* rx, uint8_t* buf, int len);
+
+/* Record that a read of len bytes was made into the (empty) buffer */
+EB_PRIVATE void eb_stream_rx_fill(struct eb_stream_rx* rx, int len);
+
+#endif
@@ -37,10 +37,10 @@ struct eb_link {
   uint8_t raw[12];
 };
 
-/* The exact use of these 8-bytes is specific to the transport */
+/* The exact use of these 21-bytes is specific to the transport */
 typedef EB_POINTER(eb_transport) eb_transport_t;
 struct eb_transport {
-  uint8_t raw[9];
+  uint8_t raw[21];
   uint8_t link_type;
   eb_transport_t next;
 };
@@ -65,6 +65,9 @@ struct eb_transport_ops {
    int  (*poll)  (struct eb_transport*, struct eb_link* link, eb_user_data_t data, eb_descriptor_callback_t ready, uint8_t* buf, int len);
    int  (*recv)  (struct eb_transport*, struct eb_link* link,                                                      uint8_t* buf, int len);
    
+   /* Kernel receive time of the data last returned by poll/recv; ns since the epoch, 0 if unknown */
+   uint64_t (*stamp)(struct eb_transport*, struct eb_link* link);
+   
    /* We flushing a device, we do: send_buffer(1) send() send() send() send_buffer(0) */
    /* This allows for a clear demarkation of where the socket should enable/disable buffering */
    void (*send)(struct eb_transport*, struct eb_link* link, const uint8_t* buf, int len);
@@ -75,4 +78,7 @@ struct eb_transport_ops {
 EB_PRIVATE extern struct eb_transport_ops eb_transports[];
 EB_PRIVATE extern const unsigned int eb_transport_size;
 
+/* Resolve the addresses ahead of a batch of connects */
+EB_PRIVATE void eb_transport_prefetch(const char* const* addresses, int count);
+
 #endif
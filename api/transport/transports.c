@@ -32,7 +32,9 @@
 #include "posix-udp.h"
 #include "posix-tcp.h"
 #include "tunnel.h"
+#include "tunnel-mux.h"
 #include "dev.h"
+#include "shm.h"
 
 struct eb_transport_ops eb_transports[] = {
 #ifndef __WIN32
@@ -46,6 +48,7 @@ struct eb_transport_ops eb_transports[] = {
     eb_dev_accept,
     eb_dev_poll,
     eb_dev_recv,
+    eb_dev_stamp,
     eb_dev_send,
     eb_dev_send_buffer
   },
@@ -60,6 +63,7 @@ struct eb_transport_ops eb_transports[] = {
     eb_posix_udp_accept,
     eb_posix_udp_poll,
     eb_posix_udp_recv,
+    eb_posix_udp_stamp,
     eb_posix_udp_send,
     eb_posix_udp_send_buffer
   },
@@ -73,6 +77,7 @@ struct eb_transport_ops eb_transports[] = {
     eb_posix_tcp_accept,
     eb_posix_tcp_poll,
     eb_posix_tcp_recv,
+    eb_posix_tcp_stamp,
     eb_posix_tcp_send,
     eb_posix_tcp_send_buffer
   },
@@ -86,9 +91,44 @@ struct eb_transport_ops eb_transports[] = {
     eb_tunnel_accept,
     eb_tunnel_poll,
     eb_tunnel_recv,
+    eb_tunnel_stamp,
     eb_tunnel_send,
     eb_tunnel_send_buffer
-  }
+  },
+  {
+    EB_TUNNEL_MUX_MTU,
+    eb_tunnel_mux_open,
+    eb_tunnel_mux_close,
+    eb_tunnel_mux_connect,
+    eb_tunnel_mux_disconnect,
+    eb_tunnel_mux_fdes,
+    eb_tunnel_mux_accept,
+    eb_tunnel_mux_poll,
+    eb_tunnel_mux_recv,
+    eb_tunnel_mux_stamp,
+    eb_tunnel_mux_send,
+    eb_tunnel_mux_send_buffer
+  },
+#ifdef __linux__
+  {
+    EB_SHM_MTU,
+    eb_shm_open,
+    eb_shm_close,
+    eb_shm_connect,
+    eb_shm_disconnect,
+    eb_shm_fdes,
+    eb_shm_accept,
+    eb_shm_poll,
+    eb_shm_recv,
+    eb_shm_stamp,
+    eb_shm_send,
+    eb_shm_send_buffer
+  },
+#endif
 };
 
 const unsigned int eb_transport_size = sizeof(eb_transports) / sizeof(struct eb_transport_ops);
+
+void eb_transport_prefetch(const char* const* addresses, int count) {
+  eb_posix_ip_prefetch(addresses, count);
+}
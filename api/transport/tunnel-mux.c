@@ -0,0 +1,387 @@
+/** @file tunnel-mux.c
+ *  @brief Many tunnelled devices sharing one TCP connection per proxy.
+ *
+ *  Copyright (C) 2026 GSI Helmholtz Centre for Heavy Ion Research GmbH 
+ *
+ *  Devices behind the same proxy share one TCP connection, and devices
+ *  addressing the same target share one channel. Like UDP, all traffic
+ *  is received at the transport level; replies follow the last frame.
+ *
+ *  @author Etherbone Core Developers <etherbone-core@ohwr.org>
+ *
+ *  @bug None!
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+
+#define ETHERBONE_IMPL
+
+#include "posix-ip.h"
+#include "transport.h"
+#include "posix-tcp.h"
+#include "tunnel-mux.h"
+#include "../glue/strncasecmp.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* The TCP stream may split a frame across reads */
+static int eb_tunnel_mux_recv_all(struct eb_tunnel_mux_conn* conn, uint8_t* buf, int len) {
+  int got, result;
+  
+  for (got = 0; got < len; got += result)
+    if ((result = eb_posix_tcp_recv(0, &conn->tcp, buf+got, len-got)) <= 0)
+      return -1;
+  
+  return len;
+}
+
+static void eb_tunnel_mux_flush(struct eb_tunnel_mux_conn* conn) {
+  if (conn->tx_len == 0) return;
+  
+  eb_posix_tcp_send(0, &conn->tcp, &conn->tx_buf[0], conn->tx_len);
+  conn->tx_len = 0;
+}
+
+static void eb_tunnel_mux_frame(struct eb_tunnel_mux_state* state, struct eb_tunnel_mux_conn* conn, uint16_t channel, const uint8_t* buf, int len) {
+  uint8_t* frame;
+  
+  if (conn->dead) return;
+  
+  if (conn->tx_len + 4 + len > (int)sizeof(conn->tx_buf))
+    eb_tunnel_mux_flush(conn);
+  
+  frame = &conn->tx_buf[conn->tx_len];
+  frame[0] = (len >> 8) & 0xFF;
+  frame[1] = len & 0xFF;
+  frame[2] = (channel >> 8) & 0xFF;
+  frame[3] = channel & 0xFF;
+  memcpy(frame+4, buf, len);
+  conn->tx_len += 4 + len;
+  
+  if (!state->tx_on) eb_tunnel_mux_flush(conn);
+}
+
+static void eb_tunnel_mux_kill(struct eb_tunnel_mux_conn* conn) {
+  eb_posix_tcp_disconnect(0, &conn->tcp);
+  conn->dead = 1;
+  conn->tx_len = 0;
+}
+
+/* Close a connection no device uses any more */
+static void eb_tunnel_mux_release(struct eb_tunnel_mux_state* state, struct eb_tunnel_mux_conn* conn) {
+  struct eb_tunnel_mux_conn** prev;
+  
+  if (!conn->dead) {
+    eb_tunnel_mux_flush(conn);
+    eb_posix_tcp_disconnect(0, &conn->tcp);
+  }
+  
+  for (prev = &state->first; *prev != conn; prev = &(*prev)->next) { }
+  *prev = conn->next;
+  
+  if (state->peer == conn) state->peer = 0;
+  
+  free(conn->channel);
+  free(conn);
+}
+
+eb_status_t eb_tunnel_mux_open(struct eb_transport* transportp, const char* port) {
+  struct eb_tunnel_mux_transport* transport;
+  struct eb_tunnel_mux_state* state;
+  
+  if ((state = (struct eb_tunnel_mux_state*)malloc(sizeof(struct eb_tunnel_mux_state))) == 0)
+    return EB_OOM;
+  
+  state->first = 0;
+  state->peer = 0;
+  state->peer_channel = 0;
+  state->tx_on = 0;
+  
+  transport = (struct eb_tunnel_mux_transport*)transportp;
+  transport->state = state;
+  return EB_OK;
+}
+
+void eb_tunnel_mux_close(struct eb_transport* transportp) {
+  struct eb_tunnel_mux_transport* transport;
+  struct eb_tunnel_mux_conn* conn;
+  struct eb_tunnel_mux_conn* next;
+  int i;
+  
+  transport = (struct eb_tunnel_mux_transport*)transportp;
+  
+  /* Devices are closed before their socket, so this is only a safety net */
+  for (conn = transport->state->first; conn != 0; conn = next) {
+    next = conn->next;
+    if (!conn->dead) eb_posix_tcp_disconnect(0, &conn->tcp);
+    for (i = 0; i < conn->channels; ++i) free(conn->channel[i].target);
+    free(conn->channel);
+    free(conn);
+  }
+  
+  free(transport->state);
+}
+
+eb_status_t eb_tunnel_mux_connect(struct eb_transport* transportp, struct eb_link* linkp, const char* address, int passive) {
+  struct eb_tunnel_mux_transport* transport;
+  struct eb_tunnel_mux_link* link;
+  struct eb_tunnel_mux_state* state;
+  struct eb_tunnel_mux_conn* conn;
+  struct eb_tunnel_mux_channel* grown;
+  const char* slash;
+  const char* host;
+  const char* service;
+  char tcpname[250];
+  eb_status_t err;
+  int len, i;
+  
+  if      (!eb_strncasecmp(address, "tunnelmux/",  10)) host = address + 10;
+  else if (!eb_strncasecmp(address, "tunnelmux6/", 11)) host = address + 11;
+  else if (!eb_strncasecmp(address, "tunnelmux4/", 11)) host = address + 11;
+  else return EB_ADDRESS;
+  
+  if ((slash = strchr(host, '/')) == 0)
+    return EB_ADDRESS;
+  
+  if ((slash = strchr(slash+1, '/')) == 0)
+    return EB_ADDRESS;
+  service = slash + 1;
+  
+  len = slash - host;
+  if (len + 7 >= sizeof(tcpname) || strlen(service) > EB_TUNNEL_MUX_MTU)
+    return EB_ADDRESS;
+  
+  strcpy(tcpname, "tcp");
+  strncat(tcpname, address + 9, host-(address+9));
+  strncat(tcpname, host, slash-host);
+  
+  transport = (struct eb_tunnel_mux_transport*)transportp;
+  link = (struct eb_tunnel_mux_link*)linkp;
+  state = transport->state;
+  
+  /* Reuse the connection to this proxy */
+  for (conn = state->first; conn != 0; conn = conn->next)
+    if (!conn->dead && !strcmp(conn->proxy, tcpname)) break;
+  
+  if (conn == 0) {
+    if ((conn = (struct eb_tunnel_mux_conn*)malloc(sizeof(struct eb_tunnel_mux_conn))) == 0)
+      return EB_OOM;
+    
+    if ((err = eb_posix_tcp_connect(0, &conn->tcp, tcpname, passive)) != EB_OK) {
+      free(conn);
+      return err;
+    }
+    
+    strcpy(conn->proxy, tcpname);
+    conn->dead = 0;
+    conn->refs = 0;
+    conn->channels = 0;
+    conn->channel = 0;
+    conn->tx_len = 0;
+    
+    eb_posix_tcp_send(0, &conn->tcp, (const uint8_t*)EB_TUNNEL_MUX_HELLO, sizeof(EB_TUNNEL_MUX_HELLO));
+    
+    conn->next = state->first;
+    state->first = conn;
+  }
+  
+  /* Devices for the same target share its channel */
+  for (i = 0; i < conn->channels; ++i)
+    if (conn->channel[i].target && !conn->channel[i].closed && !strcmp(conn->channel[i].target, service)) break;
+  
+  if (i == conn->channels) {
+    for (i = 0; i < conn->channels; ++i)
+      if (conn->channel[i].target == 0) break;
+    
+    if (i == conn->channels) {
+      if (conn->channels == EB_TUNNEL_MUX_CHANNELS) {
+        err = EB_FAIL;
+        goto fail;
+      }
+      
+      len = conn->channels ? conn->channels*2 : 16;
+      if ((grown = (struct eb_tunnel_mux_channel*)realloc(conn->channel, len * sizeof(struct eb_tunnel_mux_channel))) == 0) {
+        err = EB_OOM;
+        goto fail;
+      }
+      
+      memset(grown + conn->channels, 0, (len - conn->channels) * sizeof(struct eb_tunnel_mux_channel));
+      conn->channel = grown;
+      conn->channels = len;
+    }
+    
+    if ((conn->channel[i].target = (char*)malloc(strlen(service)+1)) == 0) {
+      err = EB_OOM;
+      goto fail;
+    }
+    
+    strcpy(conn->channel[i].target, service);
+    conn->channel[i].refs = 0;
+    conn->channel[i].closed = 0;
+    
+    eb_tunnel_mux_frame(state, conn, i | EB_TUNNEL_MUX_CONTROL, (const uint8_t*)service, strlen(service));
+    eb_tunnel_mux_flush(conn);
+  }
+  
+  ++conn->channel[i].refs;
+  ++conn->refs;
+  
+  link->conn = conn;
+  link->channel = i;
+  return EB_OK;
+
+fail:
+  /* Do not keep a connection opened just for this device */
+  if (conn->refs == 0) eb_tunnel_mux_release(state, conn);
+  return err;
+}
+
+void eb_tunnel_mux_disconnect(struct eb_transport* transportp, struct eb_link* linkp) {
+  struct eb_tunnel_mux_transport* transport;
+  struct eb_tunnel_mux_link* link;
+  struct eb_tunnel_mux_state* state;
+  struct eb_tunnel_mux_conn* conn;
+  struct eb_tunnel_mux_channel* channel;
+  
+  transport = (struct eb_tunnel_mux_transport*)transportp;
+  link = (struct eb_tunnel_mux_link*)linkp;
+  state = transport->state;
+  conn = link->conn;
+  channel = &conn->channel[link->channel];
+  
+  if (--channel->refs == 0) {
+    if (!channel->closed)
+      eb_tunnel_mux_frame(state, conn, link->channel | EB_TUNNEL_MUX_CONTROL, 0, 0);
+    
+    free(channel->target);
+    channel->target = 0;
+  }
+  
+  if (--conn->refs == 0)
+    eb_tunnel_mux_release(state, conn);
+}
+
+void eb_tunnel_mux_fdes(struct eb_transport* transportp, struct eb_link* linkp, eb_user_data_t data, eb_descriptor_callback_t cb) {
+  struct eb_tunnel_mux_transport* transport;
+  struct eb_tunnel_mux_conn* conn;
+  
+  if (linkp != 0) return; /* no per-link socket */
+  
+  transport = (struct eb_tunnel_mux_transport*)transportp;
+  for (conn = transport->state->first; conn != 0; conn = conn->next)
+    if (!conn->dead) eb_posix_tcp_fdes(0, &conn->tcp, data, cb);
+}
+
+int eb_tunnel_mux_accept(struct eb_transport* transportp, struct eb_link* result_linkp, eb_user_data_t data, eb_descriptor_callback_t ready) {
+  /* Tunnel does not make child connections */
+  return 0;
+}
+
+int eb_tunnel_mux_poll(struct eb_transport* transportp, struct eb_link* linkp, eb_user_data_t data, eb_descriptor_callback_t ready, uint8_t* buf, int maxlen) {
+  struct eb_tunnel_mux_transport* transport;
+  struct eb_tunnel_mux_link* link;
+  struct eb_tunnel_mux_state* state;
+  struct eb_tunnel_mux_conn* conn;
+  uint8_t header[4];
+  int len, got, channel;
+  
+  /* Datagrams arrive at the transport; links only learn of their demise */
+  if (linkp != 0) {
+    link = (struct eb_tunnel_mux_link*)linkp;
+    conn = link->conn;
+    return (conn->dead || conn->channel[link->channel].closed) ? -1 : 0;
+  }
+  
+  transport = (struct eb_tunnel_mux_transport*)transportp;
+  state = transport->state;
+  
+  for (conn = state->first; conn != 0; conn = conn->next) {
+    while (!conn->dead) {
+      if ((got = eb_posix_tcp_poll(0, &conn->tcp, data, ready, &header[0], 4)) == 0)
+        break;
+      
+      if (got < 0 || eb_tunnel_mux_recv_all(conn, &header[got], 4-got) < 0) {
+        eb_tunnel_mux_kill(conn);
+        break;
+      }
+      
+      len = ((unsigned int)header[0]) << 8 | header[1];
+      channel = ((unsigned int)header[2]) << 8 | header[3];
+      
+      if (len > maxlen || eb_tunnel_mux_recv_all(conn, buf, len) != len) {
+        eb_tunnel_mux_kill(conn);
+        break;
+      }
+      
+      if ((channel & EB_TUNNEL_MUX_CONTROL) != 0) {
+        /* The proxy gave up on this target */
+        channel &= ~EB_TUNNEL_MUX_CONTROL;
+        if (len == 0 && channel < conn->channels && conn->channel[channel].target != 0)
+          conn->channel[channel].closed = 1;
+        continue;
+      }
+      
+      if (len == 0) continue;
+      
+      state->peer = conn;
+      state->peer_channel = channel;
+      return len;
+    }
+  }
+  
+  return 0;
+}
+
+int eb_tunnel_mux_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8_t* buf, int len) {
+  /* Should never happen on a non-stream socket */
+  return -1;
+}
+
+uint64_t eb_tunnel_mux_stamp(struct eb_transport* transportp, struct eb_link* linkp) {
+  /* The tunnel does not forward receive times */
+  return 0;
+}
+
+void eb_tunnel_mux_send(struct eb_transport* transportp, struct eb_link* linkp, const uint8_t* buf, int len) {
+  struct eb_tunnel_mux_transport* transport;
+  struct eb_tunnel_mux_link* link;
+  struct eb_tunnel_mux_state* state;
+  
+  transport = (struct eb_tunnel_mux_transport*)transportp;
+  link = (struct eb_tunnel_mux_link*)linkp;
+  state = transport->state;
+  
+  if (link != 0) {
+    eb_tunnel_mux_frame(state, link->conn, link->channel, buf, len);
+  } else if (state->peer != 0) {
+    eb_tunnel_mux_frame(state, state->peer, state->peer_channel, buf, len);
+  }
+}
+
+void eb_tunnel_mux_send_buffer(struct eb_transport* transportp, struct eb_link* linkp, int on) {
+  struct eb_tunnel_mux_transport* transport;
+  struct eb_tunnel_mux_conn* conn;
+  
+  transport = (struct eb_tunnel_mux_transport*)transportp;
+  transport->state->tx_on = on;
+  
+  /* Frames for all devices behind a proxy leave in one write */
+  if (!on)
+    for (conn = transport->state->first; conn != 0; conn = conn->next)
+      if (!conn->dead) eb_tunnel_mux_flush(conn);
+}
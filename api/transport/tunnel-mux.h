@@ -0,0 +1,96 @@
+/** @file tunnel-mux.h
+ *  @brief Many tunnelled devices sharing one TCP connection per proxy.
+ *
+ *  Copyright (C) 2026 GSI Helmholtz Centre for Heavy Ion Research GmbH 
+ *
+ *  A tunnelmux/<proxy-host>/<proxy-port>/<host>/<port> device shares the
+ *  TCP connection to eb-tunnel with every other device behind that proxy.
+ *  Each frame on the connection is a 16-bit length, a 16-bit channel and
+ *  the datagram. Channels with the high bit set carry control messages:
+ *  a target address opens the channel, an empty payload closes it.
+ *
+ *  @author Etherbone Core Developers <etherbone-core@ohwr.org>
+ *
+ *  @bug None!
+ *
+ *******************************************************************************
+ *  This library is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU Lesser General Public
+ *  License as published by the Free Software Foundation; either
+ *  version 3 of the License, or (at your option) any later version.
+ *
+ *  This library is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ *  Lesser General Public License for more details.
+ *  
+ *  You should have received a copy of the GNU Lesser General Public
+ *  License along with this library. If not, see <http://www.gnu.org/licenses/>.
+ *******************************************************************************
+ */
+
+
+#ifndef EB_TUNNEL_MUX_H
+#define EB_TUNNEL_MUX_H
+
+#include "transport.h"
+#include "posix-udp.h"
+
+#define EB_TUNNEL_MUX_MTU EB_POSIX_UDP_MTU
+#define EB_TUNNEL_MUX_HELLO "*mux"    /* sent instead of a target address */
+#define EB_TUNNEL_MUX_CONTROL 0x8000  /* channel bit marking control frames */
+#define EB_TUNNEL_MUX_CHANNELS 0x8000 /* channels per connection */
+#define EB_TUNNEL_MUX_TX 65536        /* frames held back by send_buffer */
+
+EB_PRIVATE eb_status_t eb_tunnel_mux_open(struct eb_transport* transport, const char* port);
+EB_PRIVATE void eb_tunnel_mux_close(struct eb_transport* transport);
+EB_PRIVATE eb_status_t eb_tunnel_mux_connect(struct eb_transport* transport, struct eb_link* link, const char* address, int passive);
+EB_PRIVATE void eb_tunnel_mux_disconnect(struct eb_transport* transport, struct eb_link* link);
+EB_PRIVATE void eb_tunnel_mux_fdes(struct eb_transport*, struct eb_link* link, eb_user_data_t data, eb_descriptor_callback_t cb);
+EB_PRIVATE int eb_tunnel_mux_accept(struct eb_transport*, struct eb_link* result_link, eb_user_data_t data, eb_descriptor_callback_t ready);
+EB_PRIVATE int eb_tunnel_mux_poll(struct eb_transport* transportp, struct eb_link* linkp, eb_user_data_t data, eb_descriptor_callback_t ready, uint8_t* buf, int len);
+EB_PRIVATE int eb_tunnel_mux_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8_t* buf, int len);
+EB_PRIVATE uint64_t eb_tunnel_mux_stamp(struct eb_transport* transportp, struct eb_link* linkp);
+EB_PRIVATE void eb_tunnel_mux_send(struct eb_transport* transportp, struct eb_link* linkp, const uint8_t* buf, int len);
+EB_PRIVATE void eb_tunnel_mux_send_buffer(struct eb_transport* transportp, struct eb_link* linkp, int on);
+
+struct eb_tunnel_mux_channel {
+  char* target; /* 0 if the channel is free */
+  int refs;     /* devices using the channel */
+  int closed;   /* the proxy could not reach the target */
+};
+
+struct eb_tunnel_mux_conn {
+  struct eb_tunnel_mux_conn* next;
+  struct eb_link tcp;
+  char proxy[250]; /* tcp/<host>/<port> */
+  int dead;
+  int refs;
+  int channels;
+  struct eb_tunnel_mux_channel* channel;
+  int tx_len;
+  uint8_t tx_buf[EB_TUNNEL_MUX_TX];
+};
+
+struct eb_tunnel_mux_state {
+  struct eb_tunnel_mux_conn* first;
+  
+  /* Origin of the frame last returned by poll; replies go here */
+  struct eb_tunnel_mux_conn* peer;
+  uint16_t peer_channel;
+  
+  int tx_on;
+};
+
+struct eb_tunnel_mux_transport {
+  /* Contents must fit in 21 bytes */
+  struct eb_tunnel_mux_state* state;
+};
+
+struct eb_tunnel_mux_link {
+  /* Contents must fit in 12 bytes */
+  struct eb_tunnel_mux_conn* conn;
+  uint16_t channel;
+};
+
+#endif
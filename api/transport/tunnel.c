@@ -35,6 +35,17 @@
 
 #include <string.h>
 
+/* The TCP stream may split a datagram across reads */
+static int eb_tunnel_recv_all(struct eb_link* linkp, uint8_t* buf, int len) {
+  int got, result;
+  
+  for (got = 0; got < len; got += result)
+    if ((result = eb_posix_tcp_recv(0, linkp, buf+got, len-got)) <= 0)
+      return -1;
+  
+  return len;
+}
+
 eb_status_t eb_tunnel_open(struct eb_transport* transportp, const char* port) {
   /* noop */
   return EB_OK;
@@ -110,7 +121,7 @@ int eb_tunnel_poll(struct eb_transport* transportp, struct eb_link* linkp, eb_us
   len = ((unsigned int)len_buf[0]) << 8 | len_buf[1];
   if (len > maxlen) return -1;
   
-  if (eb_posix_tcp_recv(0, linkp, buf, len) != len)
+  if (eb_tunnel_recv_all(linkp, buf, len) != len)
     return -1;
   
   return len;
@@ -121,6 +132,11 @@ int eb_tunnel_recv(struct eb_transport* transportp, struct eb_link* linkp, uint8
   return -1;
 }
 
+uint64_t eb_tunnel_stamp(struct eb_transport* transportp, struct eb_link* linkp) {
+  /* The tunnel does not forward receive times */
+  return 0;
+}
+
 void eb_tunnel_send(struct eb_transport* transportp, struct eb_link* linkp, const uint8_t* buf, int len) {
   uint8_t len_buf[2];
   len_buf[0] = (len >> 8) & 0xFF;